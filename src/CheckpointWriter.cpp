@@ -0,0 +1,60 @@
+#include "CheckpointWriter.hpp"
+#include "DGP/BinaryOutputStream.hpp"
+#include <cstdio>
+
+void
+CheckpointWriter::write(SnapshotPtr snapshot, std::string const & path)
+{
+  alwaysAssertM(snapshot, "CheckpointWriter: Snapshot must be non-null");
+
+  wait();
+
+  busy = true;
+  thread = std::thread([this, snapshot, path]()
+  {
+    if (writeFile(*snapshot, path))
+      ++num_written;
+    else
+      ++num_failed;
+
+    busy = false;
+  });
+}
+
+void
+CheckpointWriter::wait()
+{
+  if (thread.joinable())
+    thread.join();
+}
+
+bool
+CheckpointWriter::writeFile(Mesh::Snapshot const & snapshot, std::string const & path)
+{
+  std::string tmp_path = path + ".tmp";
+
+  bool ok = false;
+  try
+  {
+    BinaryOutputStream out(tmp_path, Endianness::LITTLE);
+    snapshot.serialize(out);
+    ok = out.commit();
+  }
+  DGP_STANDARD_CATCH_BLOCKS(ok = false;, ERROR, "Could not write checkpoint to '%s'", tmp_path.c_str())
+
+  if (!ok)
+  {
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+
+  // Renaming within a directory replaces the destination atomically, so it never holds a partial checkpoint
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0)
+  {
+    DGP_ERROR << "Could not move checkpoint from '" << tmp_path << "' to '" << path << '\'';
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+
+  return true;
+}
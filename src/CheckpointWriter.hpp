@@ -0,0 +1,58 @@
+#ifndef __A2_CheckpointWriter_hpp__
+#define __A2_CheckpointWriter_hpp__
+
+#include "Common.hpp"
+#include "Mesh.hpp"
+#include "DGP/Noncopyable.hpp"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+/**
+ * Writes snapshots of a mesh to checkpoint files on a background thread, so that checkpointing a long decimation does not hold
+ * it up. One snapshot is written at a time. Each is first written to a temporary file next to the destination, which then
+ * replaces the destination, so the destination always holds a complete checkpoint even if the process is killed mid-write.
+ */
+class CheckpointWriter : private Noncopyable
+{
+  public:
+    /** Shared, read-only handle to a snapshot. */
+    typedef std::shared_ptr<Mesh::Snapshot const> SnapshotPtr;
+
+    /** Constructor. */
+    CheckpointWriter() : busy(false), num_written(0), num_failed(0) {}
+
+    /** Destructor. Waits for any write in progress to finish. */
+    ~CheckpointWriter() { wait(); }
+
+    /**
+     * Start writing a snapshot to a file on a background thread. If a previous write is still in progress, waits for it to
+     * finish first. The snapshot must not be modified until the write has finished.
+     */
+    void write(SnapshotPtr snapshot, std::string const & path);
+
+    /** Check if a write is in progress. */
+    bool isBusy() const { return busy; }
+
+    /** Wait for any write in progress to finish. */
+    void wait();
+
+    /** Get the number of checkpoints successfully written so far. */
+    long numWritten() const { return num_written; }
+
+    /** Get the number of checkpoints that could not be written. */
+    long numFailed() const { return num_failed; }
+
+    /** Write a snapshot to a file on the calling thread, via a temporary file as above. Returns true on success. */
+    static bool writeFile(Mesh::Snapshot const & snapshot, std::string const & path);
+
+  private:
+    std::thread thread;              ///< The thread writing the current checkpoint.
+    std::atomic<bool> busy;          ///< Is a checkpoint being written?
+    std::atomic<long> num_written;   ///< Number of checkpoints written.
+    std::atomic<long> num_failed;    ///< Number of checkpoints that could not be written.
+
+}; // class CheckpointWriter
+
+#endif
@@ -8,4 +8,56 @@ using namespace DGP;
 
 typedef MatrixMN<4, 4, double> DMat4;
 
+/**
+ * Scalar type in which vertex quadrics are stored, chosen at compile time by defining A2_QUADRIC_FLOAT (e.g. 'make
+ * QUADRIC_PRECISION=float'). Double by default. Single precision halves the memory taken by quadrics, and stays accurate
+ * because quadrics are then computed in coordinates centered on the mesh and scaled to unit size (see QuadricFrame). Quadrics
+ * are always summed and solved in double precision.
+ */
+#ifdef A2_QUADRIC_FLOAT
+  typedef float QuadricReal;
+#else
+  typedef double QuadricReal;
+#endif
+
+/** Matrix in which vertex quadrics are stored. */
+typedef MatrixMN<4, 4, QuadricReal> QuadricMatrix;
+
+/** Convert a quadric matrix to another precision. */
+template <typename T, typename S>
+MatrixMN<4, 4, T>
+quadricCast(MatrixMN<4, 4, S> const & m)
+{
+  MatrixMN<4, 4, T> result;
+  for (long i = 0; i < 4; ++i)
+    for (long j = 0; j < 4; ++j)
+      result(i, j) = static_cast<T>(m(i, j));
+
+  return result;
+}
+
+/**
+ * Attribute policies for mesh elements, chosen at compile time by defining A2_MESH_ATTRIBUTES (e.g. 'make
+ * MESH_ATTRIBUTES=geometry').
+ *
+ * - A2_MESH_ATTRIBUTES_FULL (default): vertices and faces carry colors and cache their normals, which are kept up to date as
+ *   the mesh is edited. Needed for display and for meshes with precomputed normals.
+ * - A2_MESH_ATTRIBUTES_GEOMETRY: vertices and faces carry only positions, connectivity and quadrics. Normals are computed from
+ *   the geometry each time they are requested and colors are always white. Smaller elements and no normal upkeep, for batch
+ *   decimation.
+ */
+#define A2_MESH_ATTRIBUTES_FULL      0
+#define A2_MESH_ATTRIBUTES_GEOMETRY  1
+
+#ifndef A2_MESH_ATTRIBUTES
+#  define A2_MESH_ATTRIBUTES A2_MESH_ATTRIBUTES_FULL
+#endif
+
+/** The attributes stored with mesh elements, as compile-time constants for code that does not need the preprocessor. */
+struct MeshAttributes
+{
+  static bool const NORMALS = (A2_MESH_ATTRIBUTES == A2_MESH_ATTRIBUTES_FULL);  ///< Are normals stored (else computed)?
+  static bool const COLORS  = (A2_MESH_ATTRIBUTES == A2_MESH_ATTRIBUTES_FULL);  ///< Are colors stored (else white)?
+};
+
 #endif
@@ -0,0 +1,740 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+#ifndef __DGP_BVH3_hpp__
+#define __DGP_BVH3_hpp__
+
+#include "Common.hpp"
+#include "AxisAlignedBox3.hpp"
+#include "Noncopyable.hpp"
+#include "Parallel.hpp"
+#include "Ray3.hpp"
+#include "Vector3.hpp"
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <thread>
+#include <vector>
+
+namespace DGP {
+
+/** Default functor to get the bounding box of an element of a BVH3, by calling its <code>getBounds()</code> function. */
+template <typename T>
+struct /* DGP_API */ BVH3DefaultBounds
+{
+  AxisAlignedBox3 operator()(T const & t) const { return t.getBounds(); }
+};
+
+// Pointer specialization
+template <typename T>
+struct /* DGP_API */ BVH3DefaultBounds<T *>
+{
+  AxisAlignedBox3 operator()(T const * t) const { return t->getBounds(); }
+};
+
+namespace BVH3Internal {
+
+// Get the point on an element closest to a query point, by calling its closestPoint() function.
+template <typename T> Vector3 closestPoint(T const & t, Vector3 const & p) { return t.closestPoint(p); }
+template <typename T> Vector3 closestPoint(T const * t, Vector3 const & p) { return t->closestPoint(p); }
+
+// Get the time taken by a ray to hit an element, by calling its rayIntersectionTime() function.
+template <typename T> Real rayIntersectionTime(T const & t, Ray3 const & ray, Real max_time)
+{ return t.rayIntersectionTime(ray, max_time); }
+template <typename T> Real rayIntersectionTime(T const * t, Ray3 const & ray, Real max_time)
+{ return t->rayIntersectionTime(ray, max_time); }
+
+} // namespace BVH3Internal
+
+/**
+ * A bounding volume hierarchy of objects in 3-space, for fast proximity, ray and overlap queries. The hierarchy is a binary tree
+ * of axis-aligned boxes, built top-down by minimizing the surface area heuristic (SAH) over a fixed set of bins per axis. It is
+ * stored as a flat array of nodes in depth-first order so that traversal touches contiguous memory. Large subtrees are built in
+ * parallel.
+ *
+ * <code>T</code> may be an object or a pointer to an object, e.g. <code>LocalTriangle3</code> or
+ * <code>RayIntersectable3 const *</code>. <code>BoundsFunctorT</code> must map an element to its bounding box (the default calls
+ * <code>getBounds()</code>). The queries place further requirements on the element, which need only be met if the query is
+ * used:
+ *   - closestElement() requires <code>Vector3 closestPoint(Vector3 const & p) const</code>, as Triangle3 provides.
+ *   - rayIntersection() and rayIntersects() require <code>Real rayIntersectionTime(Ray3 const & ray, Real max_time) const</code>,
+ *     as every RayIntersectable3 provides.
+ *
+ * Elements are added with add(), after which the hierarchy must be built with init() before it can be queried. If the elements
+ * move without being added or removed (e.g. a deforming mesh), refit() updates the boxes of the existing tree, which is much
+ * cheaper than a rebuild. If only a few elements move, refit() can be restricted to them and the nodes above them.
+ */
+template < typename T, typename BoundsFunctorT = BVH3DefaultBounds<T> >
+class /* DGP_API */ BVH3 : private Noncopyable
+{
+  public:
+    typedef T Element;  ///< Type of elements in the hierarchy.
+
+    /** Constructor. */
+    BVH3(BoundsFunctorT const & bounds_functor_ = BoundsFunctorT(), int max_elems_per_leaf_ = 4)
+    : bounds_functor(bounds_functor_), max_elems_per_leaf(std::max(max_elems_per_leaf_, 1)), valid(true)
+    {}
+
+    /** Remove all elements from the hierarchy. */
+    void clear()
+    {
+      elems.clear();
+      elem_bounds.clear();
+      order.clear();
+      nodes.clear();
+      node_parents.clear();
+      elem_leaves.clear();
+      valid = true;
+    }
+
+    /** Get the number of elements in the hierarchy. */
+    long numElements() const { return (long)elems.size(); }
+
+    /** Get the element with a given index (in order of addition). */
+    T const & getElement(long i) const { return elems[(size_t)i]; }
+
+    /**
+     * Replace the element with a given index. The hierarchy must be updated with refit() (or rebuilt with init()) before it is
+     * queried again.
+     */
+    void setElement(long i, T const & elem) { elems[(size_t)i] = elem; }
+
+    /** Add an element to the hierarchy. The hierarchy must be rebuilt with init() before it is queried. */
+    void add(T const & elem)
+    {
+      elems.push_back(elem);
+      valid = false;
+    }
+
+    /** Add a sequence of elements to the hierarchy. The hierarchy must be rebuilt with init() before it is queried. */
+    template <typename InputIterator> void add(InputIterator begin, InputIterator end)
+    {
+      elems.insert(elems.end(), begin, end);
+      valid = false;
+    }
+
+    /**
+     * Build the hierarchy over all the elements added so far.
+     *
+     * @param num_threads The number of threads to use. If non-positive, all available hardware threads are used.
+     */
+    void init(long num_threads = -1)
+    {
+      long n = numElements();
+      num_threads = Parallel::numThreads(n, num_threads, MIN_PARALLEL_ELEMS);
+
+      elem_bounds.resize((size_t)n);
+      centroids.resize((size_t)n);
+      order.resize((size_t)n);
+      Parallel::forEach(0, n, [&](long i)
+      {
+        AxisAlignedBox3 b = bounds_functor(elems[(size_t)i]);
+        elem_bounds[(size_t)i] = Box(b.getLow(), b.getHigh());
+        centroids[(size_t)i] = b.getCenter();
+        order[(size_t)i] = (uint32)i;
+      }, num_threads);
+
+      nodes.clear();
+      if (n > 0)
+      {
+        nodes.reserve((size_t)(2 * (n / max_elems_per_leaf) + 1));
+        build(0, n, 0, nodes, num_threads);
+      }
+
+      std::vector<Vector3>().swap(centroids);
+
+      // Links from elements up to the root, for refitting the hierarchy above a few elements
+      node_parents.assign(nodes.size(), NONE);
+      elem_leaves.resize((size_t)n);
+      for (size_t i = 0; i < nodes.size(); ++i)
+      {
+        Node const & node = nodes[i];
+        if (node.isLeaf())
+        {
+          for (uint32 j = node.first, end = node.first + node.count; j < end; ++j)
+            elem_leaves[order[j]] = (uint32)i;
+        }
+        else
+        {
+          node_parents[i + 1] = (uint32)i;
+          node_parents[node.first] = (uint32)i;
+        }
+      }
+
+      valid = true;
+    }
+
+    /**
+     * Update the bounding boxes of the hierarchy after elements have moved, without changing its structure. This is much faster
+     * than rebuilding with init(), but queries slow down if the elements move far from where they were when the hierarchy was
+     * built.
+     *
+     * @param num_threads The number of threads to use for recomputing element bounds. If non-positive, all available hardware
+     *   threads are used.
+     */
+    void refit(long num_threads = -1)
+    {
+      alwaysAssertM(valid, "BVH3: Cannot refit a hierarchy to which elements have been added since it was built");
+
+      long n = numElements();
+      Parallel::forEach(0, n, [&](long i)
+      {
+        AxisAlignedBox3 b = bounds_functor(elems[(size_t)i]);
+        elem_bounds[(size_t)i] = Box(b.getLow(), b.getHigh());
+      }, Parallel::numThreads(n, num_threads, MIN_PARALLEL_ELEMS));
+
+      // Children always follow their parent in the node array, so a reverse sweep updates every node after its children
+      for (size_t i = nodes.size(); i-- > 0; )
+        updateNodeBounds(i);
+    }
+
+    /**
+     * Update the bounding boxes of the hierarchy after some elements have moved, without changing its structure. Only the boxes
+     * of these elements and of the nodes above them are recomputed, so the cost is proportional to the number of elements times
+     * the depth of the hierarchy.
+     *
+     * @param begin Start of a sequence of indices of elements that have moved (or been replaced with setElement()).
+     * @param end One past the end of the sequence.
+     */
+    template <typename IndexIterator> void refit(IndexIterator begin, IndexIterator end)
+    {
+      alwaysAssertM(valid, "BVH3: Cannot refit a hierarchy to which elements have been added since it was built");
+
+      // Collect the nodes above the moved elements, stopping at nodes already collected from another element
+      std::vector<uint32> dirty;
+      for (IndexIterator ii = begin; ii != end; ++ii)
+      {
+        size_t e = (size_t)*ii;
+        AxisAlignedBox3 b = bounds_functor(elems[e]);
+        elem_bounds[e] = Box(b.getLow(), b.getHigh());
+
+        for (uint32 n = elem_leaves[e]; n != NONE && !nodes[n].dirty; n = node_parents[n])
+        {
+          nodes[n].dirty = true;
+          dirty.push_back(n);
+        }
+      }
+
+      // Children follow their parents, so updating in decreasing order of index updates every node after its children
+      std::sort(dirty.begin(), dirty.end(), std::greater<uint32>());
+      for (size_t i = 0; i < dirty.size(); ++i)
+      {
+        updateNodeBounds(dirty[i]);
+        nodes[dirty[i]].dirty = false;
+      }
+    }
+
+    /** Check if the hierarchy is up to date, i.e. no elements have been added since the last call to init(). */
+    bool isValid() const { return valid; }
+
+    /** Get the bounding box of all the elements. */
+    AxisAlignedBox3 getBounds() const
+    {
+      return nodes.empty() ? AxisAlignedBox3() : AxisAlignedBox3(nodes[0].bounds.lo, nodes[0].bounds.hi);
+    }
+
+    /**
+     * Find the element closest to a query point.
+     *
+     * @param p The query point.
+     * @param max_dist Elements farther than this are ignored. If negative, there is no limit.
+     * @param closest_pt If non-null, used to return the closest point on the returned element.
+     * @param sqdist If non-null, used to return the squared distance of the closest point from \a p.
+     *
+     * @return The index of the closest element, or a negative value if the hierarchy is empty or there is no element within
+     *   \a max_dist.
+     */
+    long closestElement(Vector3 const & p, Real max_dist = -1, Vector3 * closest_pt = NULL, Real * sqdist = NULL) const
+    {
+      alwaysAssertM(valid, "BVH3: Hierarchy must be rebuilt with init() before it is queried");
+
+      if (nodes.empty())
+        return -1;
+
+      Real best_sqdist = (max_dist >= 0 ? max_dist * max_dist : std::numeric_limits<Real>::max());
+      long best = -1;
+      Vector3 best_pt;
+
+      // Depth-first traversal, visiting the nearer child first and skipping subtrees that cannot contain a better answer
+      uint32 stack[MAX_DEPTH];
+      int top = 0;
+      stack[top++] = 0;
+      while (top > 0)
+      {
+        Node const & node = nodes[stack[--top]];
+        if (node.bounds.squaredDistance(p) > best_sqdist)
+          continue;
+
+        if (node.isLeaf())
+        {
+          for (uint32 i = node.first, end = node.first + node.count; i < end; ++i)
+          {
+            uint32 e = order[i];
+            if (elem_bounds[e].squaredDistance(p) > best_sqdist)
+              continue;
+
+            Vector3 q = BVH3Internal::closestPoint(elems[e], p);
+            Real d = (q - p).squaredLength();
+            if (d <= best_sqdist)
+            {
+              best_sqdist = d;
+              best = (long)e;
+              best_pt = q;
+            }
+          }
+        }
+        else
+        {
+          uint32 left = (uint32)(&node - &nodes[0]) + 1, right = node.first;
+          Real dl = nodes[left].bounds.squaredDistance(p), dr = nodes[right].bounds.squaredDistance(p);
+          if (dl <= dr)
+          {
+            if (dr <= best_sqdist) stack[top++] = right;
+            if (dl <= best_sqdist) stack[top++] = left;
+          }
+          else
+          {
+            if (dl <= best_sqdist) stack[top++] = left;
+            if (dr <= best_sqdist) stack[top++] = right;
+          }
+        }
+      }
+
+      if (best >= 0)
+      {
+        if (closest_pt) *closest_pt = best_pt;
+        if (sqdist) *sqdist = best_sqdist;
+      }
+
+      return best;
+    }
+
+    /**
+     * Find the first element hit by a ray.
+     *
+     * @param ray The ray.
+     * @param max_time Hits later than this are ignored. If negative, there is no limit.
+     * @param hit_time If non-null, used to return the time at which the ray hits the returned element.
+     *
+     * @return The index of the first element hit by the ray, or a negative value if there is no hit within \a max_time.
+     */
+    long rayIntersection(Ray3 const & ray, Real max_time = -1, Real * hit_time = NULL) const
+    {
+      return rayQuery(ray, max_time, false, hit_time);
+    }
+
+    /**
+     * Check if a ray hits any element. This is faster than rayIntersection() since the search stops at the first hit found,
+     * which need not be the nearest.
+     *
+     * @param ray The ray.
+     * @param max_time Hits later than this are ignored. If negative, there is no limit.
+     */
+    bool rayIntersects(Ray3 const & ray, Real max_time = -1) const
+    {
+      return rayQuery(ray, max_time, true, NULL) >= 0;
+    }
+
+    /**
+     * Call <code>func(index)</code> for every element whose bounding box overlaps a query box. If the function returns false,
+     * the search is stopped. Any exact test of the element against the box is left to the function.
+     *
+     * @return False if the search was stopped by \a func, else true.
+     */
+    template <typename FuncT> bool processOverlaps(AxisAlignedBox3 const & box, FuncT func) const
+    {
+      alwaysAssertM(valid, "BVH3: Hierarchy must be rebuilt with init() before it is queried");
+
+      if (nodes.empty() || box.isNull())
+        return true;
+
+      Box query(box.getLow(), box.getHigh());
+
+      uint32 stack[MAX_DEPTH];
+      int top = 0;
+      stack[top++] = 0;
+      while (top > 0)
+      {
+        uint32 index = stack[--top];
+        Node const & node = nodes[index];
+        if (!node.bounds.overlaps(query))
+          continue;
+
+        if (node.isLeaf())
+        {
+          for (uint32 i = node.first, end = node.first + node.count; i < end; ++i)
+          {
+            uint32 e = order[i];
+            if (elem_bounds[e].overlaps(query) && !func((long)e))
+              return false;
+          }
+        }
+        else
+        {
+          stack[top++] = node.first;
+          stack[top++] = index + 1;
+        }
+      }
+
+      return true;
+    }
+
+    /**
+     * Get the indices of all elements whose bounding boxes overlap a query box. The indices are appended to \a indices.
+     *
+     * @return The number of indices appended.
+     */
+    long overlappingElements(AxisAlignedBox3 const & box, std::vector<long> & indices) const
+    {
+      size_t old_size = indices.size();
+      processOverlaps(box, [&indices](long e) { indices.push_back(e); return true; });
+      return (long)(indices.size() - old_size);
+    }
+
+  private:
+    /** Size of the traversal stack. Building switches to median splits at half this depth to stay well within it. */
+    static int const MAX_DEPTH = 128;
+
+    /** Number of bins per axis for evaluating the surface area heuristic. */
+    static int const NUM_SAH_BINS = 16;
+
+    /** Minimum number of elements for which it is worth starting a thread. */
+    static long const MIN_PARALLEL_ELEMS = 4096;
+
+    /** Marks a missing node index. */
+    static uint32 const NONE = 0xFFFFFFFF;
+
+    /** A compact axis-aligned box (without the bookkeeping of AxisAlignedBox3). */
+    struct Box
+    {
+      Box() {}
+      Box(Vector3 const & lo_, Vector3 const & hi_) : lo(lo_), hi(hi_) {}
+
+      /** A box that contains nothing, to which other boxes can be merged. */
+      static Box empty()
+      {
+        Real m = std::numeric_limits<Real>::max();
+        return Box(Vector3(m, m, m), Vector3(-m, -m, -m));
+      }
+
+      void merge(Box const & b) { lo = lo.min(b.lo); hi = hi.max(b.hi); }
+      void merge(Vector3 const & p) { lo = lo.min(p); hi = hi.max(p); }
+
+      /** Half the surface area, which is all that is needed to compare SAH costs. */
+      Real halfArea() const { Vector3 e = hi - lo; return e.x() * e.y() + e.y() * e.z() + e.z() * e.x(); }
+
+      bool overlaps(Box const & b) const
+      {
+        return lo.x() <= b.hi.x() && b.lo.x() <= hi.x()
+            && lo.y() <= b.hi.y() && b.lo.y() <= hi.y()
+            && lo.z() <= b.hi.z() && b.lo.z() <= hi.z();
+      }
+
+      Real squaredDistance(Vector3 const & p) const { return (p.max(lo) - p.min(hi)).squaredLength(); }
+
+      /**
+       * Get the time at which a ray, given by its origin and the reciprocal of its direction, enters the box, or a negative value
+       * if it misses the box or enters it after \a max_time.
+       */
+      Real rayEntryTime(Vector3 const & origin, Vector3 const & inv_dir, Real max_time) const
+      {
+        Real t0 = 0, t1 = max_time;
+        for (int i = 0; i < 3; ++i)
+        {
+          Real ta = (lo[i] - origin[i]) * inv_dir[i], tb = (hi[i] - origin[i]) * inv_dir[i];
+          if (ta > tb) std::swap(ta, tb);
+          if (ta > t0) t0 = ta;
+          if (tb < t1) t1 = tb;
+          if (t0 > t1) return -1;
+        }
+
+        return t0;
+      }
+
+      Vector3 lo, hi;
+    };
+
+    /**
+     * Node of the hierarchy. For a leaf, \a first and \a count specify a range of the element order array. For an internal
+     * node, \a count is zero, the left child immediately follows the node in the node array and \a first is the index of the
+     * right child.
+     */
+    struct Node
+    {
+      Node() : dirty(false) {}
+
+      bool isLeaf() const { return count > 0; }
+
+      Box bounds;
+      uint32 first;
+      uint32 count;
+      bool dirty;  ///< Used by refit() to mark nodes to be updated.
+    };
+
+    /** Recompute the bounding box of a node from its elements or children, which must be up to date. */
+    void updateNodeBounds(size_t i)
+    {
+      Node & node = nodes[i];
+      if (node.isLeaf())
+      {
+        node.bounds = elem_bounds[order[node.first]];
+        for (uint32 j = node.first + 1, end = node.first + node.count; j < end; ++j)
+          node.bounds.merge(elem_bounds[order[j]]);
+      }
+      else
+      {
+        node.bounds = nodes[i + 1].bounds;
+        node.bounds.merge(nodes[node.first].bounds);
+      }
+    }
+
+    /** Shared implementation of rayIntersection() and rayIntersects(). */
+    long rayQuery(Ray3 const & ray, Real max_time, bool any_hit, Real * hit_time) const
+    {
+      alwaysAssertM(valid, "BVH3: Hierarchy must be rebuilt with init() before it is queried");
+
+      if (nodes.empty())
+        return -1;
+
+      // A zero direction component gives an infinite reciprocal, which the slab test handles correctly
+      Vector3 const & origin = ray.getOrigin();
+      Vector3 const & dir = ray.getDirection();
+      Vector3 inv_dir(1 / dir.x(), 1 / dir.y(), 1 / dir.z());
+
+      Real best_time = (max_time >= 0 ? max_time : std::numeric_limits<Real>::max());
+      long best = -1;
+
+      uint32 stack[MAX_DEPTH];
+      int top = 0;
+      if (nodes[0].bounds.rayEntryTime(origin, inv_dir, best_time) >= 0)
+        stack[top++] = 0;
+
+      while (top > 0)
+      {
+        uint32 index = stack[--top];
+        Node const & node = nodes[index];
+
+        if (node.isLeaf())
+        {
+          for (uint32 i = node.first, end = node.first + node.count; i < end; ++i)
+          {
+            uint32 e = order[i];
+            if (elem_bounds[e].rayEntryTime(origin, inv_dir, best_time) < 0)
+              continue;
+
+            Real t = BVH3Internal::rayIntersectionTime(elems[e], ray, best_time);
+            if (t >= 0 && t <= best_time)
+            {
+              best_time = t;
+              best = (long)e;
+
+              if (any_hit)
+              {
+                top = 0;
+                break;
+              }
+            }
+          }
+        }
+        else
+        {
+          // Visit the child the ray enters first, so that a hit there can prune the other one
+          uint32 left = index + 1, right = node.first;
+          Real tl = nodes[left].bounds.rayEntryTime(origin, inv_dir, best_time);
+          Real tr = nodes[right].bounds.rayEntryTime(origin, inv_dir, best_time);
+          if (tl >= 0 && tr >= 0)
+          {
+            if (tl <= tr) { stack[top++] = right; stack[top++] = left;  }
+            else          { stack[top++] = left;  stack[top++] = right; }
+          }
+          else if (tl >= 0) stack[top++] = left;
+          else if (tr >= 0) stack[top++] = right;
+        }
+      }
+
+      if (best >= 0 && hit_time)
+        *hit_time = best_time;
+
+      return best;
+    }
+
+    /** Get the SAH bin containing a centroid coordinate. */
+    static int binIndex(Real x, Real lo, Real scale)
+    {
+      int b = (int)((x - lo) * scale);
+      return b < 0 ? 0 : (b >= NUM_SAH_BINS ? NUM_SAH_BINS - 1 : b);
+    }
+
+    /**
+     * Partition the elements order[begin..end) into two children, returning the start of the second one. The partition
+     * minimizes the surface area heuristic over bins along each axis of the centroid bounds. If there is no such partition, or
+     * the tree is getting too deep, the elements are split at the median along the longest axis instead.
+     */
+    long split(long begin, long end, Box const & centroid_bounds, int depth)
+    {
+      std::vector<Vector3> const & c = centroids;
+      Vector3 extent = centroid_bounds.hi - centroid_bounds.lo;
+
+      if (depth < MAX_DEPTH / 2)
+      {
+        int best_axis = -1, best_bin = -1;
+        Real best_cost = std::numeric_limits<Real>::max();
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+          if (extent[axis] <= 0)
+            continue;
+
+          Box bin_bounds[NUM_SAH_BINS];
+          long bin_counts[NUM_SAH_BINS];
+          for (int b = 0; b < NUM_SAH_BINS; ++b)
+          {
+            bin_bounds[b] = Box::empty();
+            bin_counts[b] = 0;
+          }
+
+          Real scale = NUM_SAH_BINS / extent[axis];
+          for (long i = begin; i < end; ++i)
+          {
+            uint32 e = order[(size_t)i];
+            int b = binIndex(c[e][axis], centroid_bounds.lo[axis], scale);
+            bin_bounds[b].merge(elem_bounds[e]);
+            bin_counts[b]++;
+          }
+
+          // Sweep from the right to get the cost of each suffix of bins, then from the left to add the cost of each prefix
+          Real right_cost[NUM_SAH_BINS];
+          Box acc = Box::empty();
+          long count = 0;
+          for (int b = NUM_SAH_BINS - 1; b > 0; --b)
+          {
+            acc.merge(bin_bounds[b]);
+            count += bin_counts[b];
+            right_cost[b] = (count > 0 ? count * acc.halfArea() : 0);
+          }
+
+          acc = Box::empty();
+          count = 0;
+          for (int b = 0; b < NUM_SAH_BINS - 1; ++b)
+          {
+            acc.merge(bin_bounds[b]);
+            count += bin_counts[b];
+            if (count <= 0 || count >= end - begin)
+              continue;
+
+            Real cost = count * acc.halfArea() + right_cost[b + 1];
+            if (cost < best_cost)
+            {
+              best_cost = cost;
+              best_axis = axis;
+              best_bin = b;
+            }
+          }
+        }
+
+        if (best_axis >= 0)
+        {
+          Real lo = centroid_bounds.lo[best_axis], scale = NUM_SAH_BINS / extent[best_axis];
+          long mid = (long)(std::partition(order.begin() + begin, order.begin() + end,
+                                           [&](uint32 e) { return binIndex(c[e][best_axis], lo, scale) <= best_bin; })
+                          - order.begin());
+          if (mid > begin && mid < end)
+            return mid;
+        }
+      }
+
+      long axis = extent.maxAxis();
+      long mid = (begin + end) / 2;
+      std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                       [&c, axis](uint32 a, uint32 b) { return c[a][axis] < c[b][axis]; });
+      return mid;
+    }
+
+    /**
+     * Recursively build the subtree over the elements order[begin..end), appending its nodes to \a out in depth-first order and
+     * returning the index of its root in \a out. If more than one thread is available, the right subtree is built into a
+     * separate array on a new thread, and appended once both subtrees are done.
+     */
+    uint32 build(long begin, long end, int depth, std::vector<Node> & out, long num_threads)
+    {
+      uint32 index = (uint32)out.size();
+      out.push_back(Node());
+
+      Box bounds = elem_bounds[order[(size_t)begin]];
+      Box centroid_bounds(centroids[order[(size_t)begin]], centroids[order[(size_t)begin]]);
+      for (long i = begin + 1; i < end; ++i)
+      {
+        bounds.merge(elem_bounds[order[(size_t)i]]);
+        centroid_bounds.merge(centroids[order[(size_t)i]]);
+      }
+
+      out[index].bounds = bounds;
+
+      Vector3 extent = centroid_bounds.hi - centroid_bounds.lo;
+      if (end - begin <= max_elems_per_leaf || extent.squaredLength() <= 0)
+      {
+        out[index].first = (uint32)begin;
+        out[index].count = (uint32)(end - begin);
+        return index;
+      }
+
+      long mid = split(begin, end, centroid_bounds, depth);
+
+      uint32 right;
+      if (num_threads > 1 && end - begin >= 2 * MIN_PARALLEL_ELEMS)
+      {
+        // The subtrees permute disjoint ranges of the order array, so they can be built concurrently
+        std::vector<Node> right_nodes;
+        long right_threads = num_threads / 2;
+        std::thread right_thread([&]() { build(mid, end, depth + 1, right_nodes, right_threads); });
+        build(begin, mid, depth + 1, out, num_threads - right_threads);
+        right_thread.join();
+
+        right = (uint32)out.size();
+        for (size_t i = 0; i < right_nodes.size(); ++i)
+        {
+          if (!right_nodes[i].isLeaf())
+            right_nodes[i].first += right;
+
+          out.push_back(right_nodes[i]);
+        }
+      }
+      else
+      {
+        build(begin, mid, depth + 1, out, 1);
+        right = build(mid, end, depth + 1, out, 1);
+      }
+
+      out[index].first = right;
+      out[index].count = 0;
+
+      return index;
+    }
+
+    BoundsFunctorT bounds_functor;  ///< Gets the bounding box of an element.
+    int max_elems_per_leaf;         ///< Maximum number of elements in a leaf.
+    std::vector<T> elems;           ///< Elements, in order of addition.
+    std::vector<Box> elem_bounds;   ///< Bounding box of each element.
+    std::vector<Vector3> centroids; ///< Centroids of element bounding boxes (only used while building).
+    std::vector<uint32> order;      ///< Element indices, permuted so that each leaf refers to a contiguous range.
+    std::vector<Node> nodes;        ///< Nodes of the hierarchy, in depth-first order. The first node is the root.
+    std::vector<uint32> node_parents; ///< Parent of each node, or NONE for the root.
+    std::vector<uint32> elem_leaves;  ///< Leaf containing each element.
+    bool valid;                     ///< True if the hierarchy is up to date.
+
+}; // class BVH3
+
+// Out-of-class definition, needed if the constant is bound to a reference
+template <typename T, typename BoundsFunctorT> uint32 const BVH3<T, BoundsFunctorT>::NONE;
+
+} // namespace DGP
+
+#endif
@@ -11,6 +11,8 @@
 
 #include "Log.hpp"
 #include "Common.hpp"
+#include "System.hpp"
+#include <algorithm>
 #include <ctime>
 #include <iomanip>
 #include <sstream>
@@ -19,6 +21,7 @@ namespace DGP {
 namespace LogInternal {
 
 Spinlock lock;
+std::atomic<AsyncLogSink *> async_sink(NULL);
 
 std::string
 stripPathFromFilename(std::string const & full_path)
@@ -46,5 +49,149 @@ currentDateTimeToString()
   return os.str();
 }
 
+// Get the smallest power of two not less than a number.
+static uint64
+ceilPowerOf2(uint64 n)
+{
+  uint64 p = 1;
+  while (p < n) p <<= 1;
+  return p;
+}
+
 } // namespace LogInternal
+
+AsyncLogSink::AsyncLogSink(long capacity, bool block_when_full_)
+: slots((size_t)LogInternal::ceilPowerOf2((uint64)std::max(capacity, 2L))),
+  mask((uint64)slots.size() - 1),
+  block_when_full(block_when_full_),
+  enqueue_pos(0),
+  dequeue_pos(0),
+  num_dropped(0),
+  running(true)
+{
+  for (size_t i = 0; i < slots.size(); ++i)
+  {
+    slots[i].sequence.store((uint64)i, std::memory_order_relaxed);
+    slots[i].stream = NULL;
+  }
+
+  thread = std::thread(&AsyncLogSink::run, this);
+}
+
+AsyncLogSink::~AsyncLogSink()
+{
+  AsyncLogSink * self = this;
+  LogInternal::async_sink.compare_exchange_strong(self, NULL);
+
+  running.store(false);
+  thread.join();
+}
+
+bool
+AsyncLogSink::push(std::ostream & stream, std::string & message)
+{
+  // Bounded multi-producer queue of D. Vyukov: each slot's sequence number says whether it is free for the producer that
+  // claims a given position, or holds a message for the consumer at that position
+  uint64 pos = enqueue_pos.load(std::memory_order_relaxed);
+  Slot * slot;
+  while (true)
+  {
+    slot = &slots[(size_t)(pos & mask)];
+    uint64 seq = slot->sequence.load(std::memory_order_acquire);
+    int64 diff = (int64)seq - (int64)pos;
+    if (diff == 0)
+    {
+      if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        break;
+    }
+    else if (diff < 0)  // full
+    {
+      if (!block_when_full)
+      {
+        num_dropped++;
+        return false;
+      }
+
+      std::this_thread::yield();
+      pos = enqueue_pos.load(std::memory_order_relaxed);
+    }
+    else
+      pos = enqueue_pos.load(std::memory_order_relaxed);
+  }
+
+  slot->stream = &stream;
+  slot->message.swap(message);
+  slot->sequence.store(pos + 1, std::memory_order_release);
+
+  return true;
+}
+
+long
+AsyncLogSink::drain()
+{
+  // Only the background thread consumes, so the dequeue position can be updated without contention
+  uint64 pos = dequeue_pos.load(std::memory_order_relaxed);
+  std::ostream * last_stream = NULL;
+  long count = 0;
+
+  LogInternal::lock.lock();  // don't interleave with direct writes through LockedOutputStream
+
+    while (true)
+    {
+      Slot & slot = slots[(size_t)(pos & mask)];
+      if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+        break;
+
+      if (last_stream && slot.stream != last_stream)
+        last_stream->flush();
+
+      *slot.stream << slot.message << '\n';
+      last_stream = slot.stream;
+      slot.message.clear();
+
+      slot.sequence.store(pos + mask + 1, std::memory_order_release);
+      ++pos;
+      ++count;
+    }
+
+    if (last_stream)
+      last_stream->flush();
+
+  LogInternal::lock.unlock();
+
+  dequeue_pos.store(pos, std::memory_order_release);
+  return count;
+}
+
+void
+AsyncLogSink::run()
+{
+  while (running.load())
+  {
+    if (drain() <= 0)
+      System::sleep(1);
+  }
+
+  drain();
+}
+
+void
+AsyncLogSink::flush()
+{
+  uint64 target = enqueue_pos.load();
+  while (dequeue_pos.load(std::memory_order_acquire) < target)
+    System::sleep(1);
+}
+
+LogMessage::~LogMessage()
+{
+  std::string message = buffer.str();
+
+  AsyncLogSink * sink = LogInternal::async_sink.load();
+  if (sink)
+    sink->push(*stream, message);
+  else
+    LockedOutputStream<>(*stream).getStream() << message << std::endl;
+}
+
 } // namespace DGP
@@ -15,16 +15,46 @@
 #include "Platform.hpp"
 #include "BasicStringAlg.hpp"
 #include "Noncopyable.hpp"
+#include "NumericTypes.hpp"
 #include "Spinlock.hpp"
+#include <atomic>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Log levels, for compile-time filtering of log messages. Messages of a level higher than DGP_LOG_LEVEL are compiled out, and
+ * their arguments are not evaluated. DGP_LOG_LEVEL may be defined on the compiler command line, else it defaults to
+ * DGP_LOG_LEVEL_DEBUG in debug builds and DGP_LOG_LEVEL_INFO otherwise.
+ */
+#define DGP_LOG_LEVEL_OFF      0
+#define DGP_LOG_LEVEL_ERROR    1  ///< DGP_ERROR
+#define DGP_LOG_LEVEL_WARNING  2  ///< DGP_WARNING
+#define DGP_LOG_LEVEL_INFO     3  ///< DGP_CONSOLE and DGP_LOG
+#define DGP_LOG_LEVEL_DEBUG    4  ///< DGP_DEBUG
+#define DGP_LOG_LEVEL_TRACE    5  ///< DGP_TRACE, for messages from inner loops
+
+#ifndef DGP_LOG_LEVEL
+#  ifdef DGP_DEBUG_BUILD
+#    define DGP_LOG_LEVEL DGP_LOG_LEVEL_DEBUG
+#  else
+#    define DGP_LOG_LEVEL DGP_LOG_LEVEL_INFO
+#  endif
+#endif
 
 namespace DGP {
 
+class AsyncLogSink;
+
 namespace LogInternal {
 
 extern Spinlock lock;
 
+// The sink to which log messages are currently routed, if any.
+extern std::atomic<AsyncLogSink *> async_sink;
+
 // Extract the filename from a full path.
 DGP_API std::string stripPathFromFilename(std::string const & full_path);
 
@@ -93,6 +123,106 @@ class /* DGP_API */ LockedOutputStream : public Noncopyable
 
 }; // class LockedOutputStream
 
+/**
+ * A queue of log messages that are written to their output streams by a background thread, so that the threads generating the
+ * messages do not wait for I/O. The queue is a fixed-size ring buffer that multiple threads can add messages to without taking
+ * a lock. The background thread writes queued messages in batches, flushing each stream only when the queue runs empty.
+ *
+ * The logging macros (DGP_CONSOLE, DGP_LOG, DGP_ERROR etc) send their messages to the sink installed with setGlobal(), and
+ * write directly to their streams if no sink is installed.
+ *
+ * Example:
+ * \code
+ *   AsyncLogSink sink;
+ *   AsyncLogSink::setGlobal(&sink);
+ *   DGP_CONSOLE << "This line will be written by a background thread";
+ * \endcode
+ */
+class DGP_API AsyncLogSink : private Noncopyable
+{
+  public:
+    /**
+     * Constructor. Starts the background thread.
+     *
+     * @param capacity The maximum number of messages that can be queued. Rounded up to a power of two.
+     * @param block_when_full If true, a thread adding a message to a full queue waits for space. If false, the message is
+     *   dropped and counted by numDropped().
+     */
+    AsyncLogSink(long capacity = 4096, bool block_when_full = true);
+
+    /** Destructor. Uninstalls the sink if it is the global sink, then writes all queued messages and stops the thread. */
+    ~AsyncLogSink();
+
+    /**
+     * Queue a message to be written, followed by a newline, to an output stream. Threadsafe and lock-free.
+     *
+     * @return True if the message was queued, false if it was dropped because the queue was full.
+     */
+    bool push(std::ostream & stream, std::string & message);
+
+    /** Wait until all messages queued so far have been written and their streams flushed. */
+    void flush();
+
+    /** Get the number of messages dropped because the queue was full. */
+    long numDropped() const { return (long)num_dropped.load(); }
+
+    /** Get the sink to which log messages are currently routed, or null if there is none. */
+    static AsyncLogSink * getGlobal() { return LogInternal::async_sink.load(); }
+
+    /** Route log messages to a sink, or write them directly to their streams if \a sink is null. */
+    static void setGlobal(AsyncLogSink * sink) { LogInternal::async_sink.store(sink); }
+
+  private:
+    /** A slot in the ring buffer. */
+    struct Slot
+    {
+      std::atomic<uint64> sequence;  ///< Position of the message in the slot, with the usual bounded queue sequencing.
+      std::ostream * stream;         ///< Stream to write the message to.
+      std::string message;           ///< The message.
+    };
+
+    /** Write queued messages until the sink is stopped. Runs on the background thread. */
+    void run();
+
+    /** Write all currently queued messages, returning the number written. */
+    long drain();
+
+    std::vector<Slot> slots;                   ///< The ring buffer.
+    uint64 mask;                               ///< Number of slots minus one.
+    bool block_when_full;                      ///< Wait for space instead of dropping messages?
+    std::atomic<uint64> enqueue_pos;           ///< Position of the next message to be queued.
+    std::atomic<uint64> dequeue_pos;           ///< Position of the next message to be written (only read by other threads).
+    std::atomic<uint64> num_dropped;           ///< Number of messages dropped because the queue was full.
+    std::atomic<bool> running;                 ///< Cleared to stop the background thread.
+    std::thread thread;                        ///< The background thread.
+
+}; // class AsyncLogSink
+
+/**
+ * A temporary object that collects a single log message and, on destruction, sends it to the global AsyncLogSink if one is
+ * installed, or else writes it atomically (followed by a newline) to an output stream. Used by the logging macros.
+ */
+class DGP_API LogMessage : private Noncopyable
+{
+  public:
+    /** Constructor. */
+    LogMessage(std::ostream & stream_) : stream(&stream_) {}
+
+    /** Constructor. Starts the message with a prefix. */
+    LogMessage(std::ostream & stream_, std::string const & prefix) : stream(&stream_) { buffer << prefix; }
+
+    /** Destructor. Sends or writes the message. */
+    ~LogMessage();
+
+    /** Get the stream to which the message should be written. */
+    std::ostream & getStream() { return buffer; }
+
+  private:
+    std::ostream * stream;      ///< The destination stream.
+    std::ostringstream buffer;  ///< Accumulates the message.
+
+}; // class LogMessage
+
 } // namespace DGP
 
 // Fully qualify references in #defines so they can be used in client programs in non-DGP namespaces without namespace errors.
@@ -102,46 +232,70 @@ class /* DGP_API */ LockedOutputStream : public Noncopyable
                                               DGP::LogInternal::stripPathFromFilename(__FILE__).c_str(), \
                                               (long)__LINE__)
 
+// Replaces a disabled logging macro. The compiler removes the dead statement, and the streamed arguments are never evaluated.
+#define DGP_LOG_DISABLED while (false) std::cout
+
+#if DGP_LOG_LEVEL >= DGP_LOG_LEVEL_INFO
+
 /**
  * Synchronized console output stream, with no line prefix. Outputs a newline at the end of every sequence of stream operations
  * (i.e. after every stack such as <code>DGP_CONSOLE << a << b << c;</code>).
  */
-#define DGP_CONSOLE DGP::LockedOutputStream<>(std::cout, true).getStream()
+#  define DGP_CONSOLE DGP::LogMessage(std::cout).getStream()
 
 /**
  * Synchronized logging stream, with a prefix indicating the time, source file and line number. Outputs a newline at the end of
  * every sequence of stream operations (i.e. after every stack such as <code>DGP_LOG << a << b << c;</code>).
  */
-#define DGP_LOG DGP::LockedOutputStream<>(std::cout, DGP_LOG_STANDARD_PREFIX, true).getStream()
+#  define DGP_LOG DGP::LogMessage(std::cout, DGP_LOG_STANDARD_PREFIX).getStream()
 
-#ifdef DGP_DEBUG_BUILD
+#else
+#  define DGP_CONSOLE DGP_LOG_DISABLED
+#  define DGP_LOG DGP_LOG_DISABLED
+#endif
+
+#if DGP_LOG_LEVEL >= DGP_LOG_LEVEL_DEBUG
 /**
  * Synchronized stream for debug messages, with a prefix indicating the time, source file and line number. Outputs a newline at
  * the end of every sequence of stream operations (i.e. after every stack such as <code>DGP_DEBUG << a << b << c;</code>).
  *
- * Deactivated in release mode.
+ * Deactivated unless DGP_LOG_LEVEL is at least DGP_LOG_LEVEL_DEBUG, which is the default only in debug builds.
  */
-#  define DGP_DEBUG DGP::LockedOutputStream<>(std::cout, DGP_LOG_STANDARD_PREFIX, true).getStream()
+#  define DGP_DEBUG DGP::LogMessage(std::cout, DGP_LOG_STANDARD_PREFIX).getStream()
 #else
+#  define DGP_DEBUG DGP_LOG_DISABLED
+#endif
+
+#if DGP_LOG_LEVEL >= DGP_LOG_LEVEL_TRACE
 /**
- * Synchronized stream for debug messages, with a prefix indicating the time, source file and line number. Outputs a newline at
- * the end of every sequence of stream operations (i.e. after every stack such as <code>DGP_DEBUG << a << b << c;</code>).
+ * Synchronized stream for very frequent messages, e.g. from inside inner loops, with a prefix indicating the time, source file
+ * and line number. Outputs a newline at the end of every sequence of stream operations.
  *
- * Deactivated in release mode.
+ * Deactivated unless DGP_LOG_LEVEL is explicitly set to DGP_LOG_LEVEL_TRACE.
  */
-#  define DGP_DEBUG while (false) std::cout
+#  define DGP_TRACE DGP::LogMessage(std::cout, DGP_LOG_STANDARD_PREFIX).getStream()
+#else
+#  define DGP_TRACE DGP_LOG_DISABLED
 #endif
 
+#if DGP_LOG_LEVEL >= DGP_LOG_LEVEL_ERROR
 /**
  * Synchronized stream for error messages, with a prefix indicating the time, source file and line number. Outputs a newline at
  * the end of every sequence of stream operations (i.e. after every stack such as <code>DGP_ERROR << a << b << c;</code>).
  */
-#define DGP_ERROR DGP::LockedOutputStream<>(std::cerr, DGP_LOG_STANDARD_PREFIX + "ERROR: ", true).getStream()
+#  define DGP_ERROR DGP::LogMessage(std::cerr, DGP_LOG_STANDARD_PREFIX + "ERROR: ").getStream()
+#else
+#  define DGP_ERROR DGP_LOG_DISABLED
+#endif
 
+#if DGP_LOG_LEVEL >= DGP_LOG_LEVEL_WARNING
 /**
  * Synchronized stream for warning messages, with a prefix indicating the time, source file and line number. Outputs a newline
  * at the end of every sequence of stream operations (i.e. after every stack such as <code>DGP_WARNING << a << b << c;</code>).
  */
-#define DGP_WARNING DGP::LockedOutputStream<>(std::cerr, DGP_LOG_STANDARD_PREFIX + "WARNING: ", true).getStream()
+#  define DGP_WARNING DGP::LogMessage(std::cerr, DGP_LOG_STANDARD_PREFIX + "WARNING: ").getStream()
+#else
+#  define DGP_WARNING DGP_LOG_DISABLED
+#endif
 
 #endif
@@ -0,0 +1,85 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+#ifndef __DGP_Parallel_hpp__
+#define __DGP_Parallel_hpp__
+
+#include "Common.hpp"
+#include "System.hpp"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace DGP {
+
+/** Simple data-parallel loops over index ranges, built on std::thread. */
+namespace Parallel {
+
+/**
+ * Get the number of threads to use for processing \a num_items items, given a requested number of threads (non-positive to use
+ * all available hardware threads) and a minimum number of items that makes a thread worth starting.
+ */
+inline long
+numThreads(long num_items, long requested = -1, long min_items_per_thread = 1)
+{
+  long n = (requested > 0 ? requested : System::concurrency());
+  n = std::min(n, num_items / std::max(min_items_per_thread, 1L));
+  return std::max(n, 1L);
+}
+
+/**
+ * Split the range [\a begin, \a end) into \a num_chunks contiguous chunks of nearly equal size, and call
+ * <code>func(chunk_begin, chunk_end, chunk_index)</code> for each chunk on a separate thread. The calling thread processes the
+ * last chunk. Returns when all chunks have been processed. If \a num_chunks is non-positive, one chunk is created per hardware
+ * thread.
+ */
+template <typename FuncT>
+void
+forChunks(long begin, long end, FuncT func, long num_chunks = -1)
+{
+  long n = end - begin;
+  if (n <= 0)
+    return;
+
+  num_chunks = numThreads(n, num_chunks);
+  if (num_chunks == 1)
+  {
+    func(begin, end, 0L);
+    return;
+  }
+
+  std::vector<std::thread> threads;
+  threads.reserve((size_t)(num_chunks - 1));
+  for (long i = 0; i < num_chunks - 1; ++i)
+    threads.push_back(std::thread(func, begin + (n * i) / num_chunks, begin + (n * (i + 1)) / num_chunks, i));
+
+  func(begin + (n * (num_chunks - 1)) / num_chunks, end, num_chunks - 1);
+
+  for (size_t i = 0; i < threads.size(); ++i)
+    threads[i].join();
+}
+
+/**
+ * Call <code>func(i)</code> for every index i in [\a begin, \a end), splitting the range into contiguous chunks that are
+ * processed in parallel. See forChunks() for the meaning of \a num_chunks.
+ */
+template <typename FuncT>
+void
+forEach(long begin, long end, FuncT func, long num_chunks = -1)
+{
+  forChunks(begin, end, [&func](long b, long e, long) { for (long i = b; i < e; ++i) func(i); }, num_chunks);
+}
+
+} // namespace Parallel
+
+} // namespace DGP
+
+#endif
@@ -0,0 +1,75 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+
+#include "ProgressReporter.hpp"
+#include "System.hpp"
+#include <limits>
+
+namespace DGP {
+
+ProgressReporter::ProgressReporter(std::string const & task_name_, long report_every_steps_, long report_every_ms_)
+: task_name(task_name_),
+  report_every_steps(report_every_steps_),
+  report_every_ms(report_every_ms_),
+  total_steps(-1),
+  next_report_step(std::numeric_limits<long>::max()),
+  last_steps_done(0),
+  start_time(0),
+  last_report_time(0)
+{}
+
+void
+ProgressReporter::begin(long total_steps_)
+{
+  total_steps = total_steps_;
+  next_report_step = (report_every_steps > 0 ? report_every_steps : std::numeric_limits<long>::max());
+  last_steps_done = 0;
+  start_time = last_report_time = System::time();
+}
+
+bool
+ProgressReporter::timeForReport() const
+{
+  return 1000 * (System::time() - last_report_time) >= report_every_ms;
+}
+
+void
+ProgressReporter::report(long steps_done)
+{
+  last_report_time = System::time();
+  if (report_every_steps > 0)
+    next_report_step = steps_done + report_every_steps;
+
+  double elapsed = last_report_time - start_time;
+  double rate = (elapsed > 0 ? steps_done / elapsed : 0);
+
+  if (total_steps > 0)
+  {
+    double remaining = (rate > 0 ? (total_steps - steps_done) / rate : 0);
+    DGP_CONSOLE << format("%s: %ld/%ld (%.1f%%), %.0f/s, %.1fs elapsed, %.1fs remaining", task_name.c_str(), steps_done,
+                          total_steps, (100.0 * steps_done) / total_steps, rate, elapsed, remaining);
+  }
+  else
+    DGP_CONSOLE << format("%s: %ld, %.0f/s, %.1fs elapsed", task_name.c_str(), steps_done, rate, elapsed);
+}
+
+void
+ProgressReporter::end(long steps_done)
+{
+  last_steps_done = steps_done;
+
+  double elapsed = System::time() - start_time;
+  double rate = (elapsed > 0 ? steps_done / elapsed : 0);
+  DGP_CONSOLE << format("%s: done, %ld in %.2fs (%.0f/s)", task_name.c_str(), steps_done, elapsed, rate);
+}
+
+} // namespace DGP
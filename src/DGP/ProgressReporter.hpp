@@ -0,0 +1,86 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+
+#ifndef __DGP_ProgressReporter_hpp__
+#define __DGP_ProgressReporter_hpp__
+
+#include "Common.hpp"
+#include <string>
+
+namespace DGP {
+
+/**
+ * Reports the progress of a long-running loop to the console, at a limited rate so that reporting does not slow the loop down.
+ * A line is written at most once every given number of steps, or once every given interval of time, whichever comes first.
+ *
+ * Example:
+ * \code
+ *   ProgressReporter progress("Decimating", 0, 500);  // report every half second
+ *   progress.begin(num_steps);
+ *   for (long i = 0; i < num_steps; ++i)
+ *   {
+ *     ...
+ *     progress.update(i + 1);
+ *   }
+ *   progress.end();
+ * \endcode
+ */
+class DGP_API ProgressReporter
+{
+  public:
+    /**
+     * Constructor.
+     *
+     * @param task_name Description of the task, used as a prefix for each line of output.
+     * @param report_every_steps If positive, report after at least this many steps since the last report.
+     * @param report_every_ms If positive, report after at least this many milliseconds since the last report.
+     */
+    ProgressReporter(std::string const & task_name_, long report_every_steps_ = 0, long report_every_ms_ = 1000);
+
+    /** Start measuring progress towards a given total number of steps (or an unknown total, if non-positive). */
+    void begin(long total_steps_ = -1);
+
+    /** Record that a given number of steps (in total, not since the last call) has been completed, and report if it is time. */
+    void update(long steps_done)
+    {
+      last_steps_done = steps_done;
+      if (steps_done >= next_report_step || (report_every_ms > 0 && timeForReport()))
+        report(steps_done);
+    }
+
+    /** Report the final number of steps completed, and the total time taken. */
+    void end(long steps_done);
+
+    /** Report the final number of steps completed, as passed to the last call to update(), and the total time taken. */
+    void end() { end(last_steps_done); }
+
+  private:
+    /** Check if the time interval since the last report has elapsed. */
+    bool timeForReport() const;
+
+    /** Write a line reporting progress. */
+    void report(long steps_done);
+
+    std::string task_name;     ///< Description of the task.
+    long report_every_steps;   ///< Minimum number of steps between reports (no limit if non-positive).
+    long report_every_ms;      ///< Minimum time between reports (no limit if non-positive).
+    long total_steps;          ///< Total number of steps, or non-positive if unknown.
+    long next_report_step;     ///< Report when this number of steps has been reached.
+    long last_steps_done;      ///< Number of steps done as of the last call to update().
+    double start_time;         ///< System time when begin() was called, in seconds.
+    double last_report_time;   ///< System time of the last report, in seconds.
+
+}; // class ProgressReporter
+
+} // namespace DGP
+
+#endif
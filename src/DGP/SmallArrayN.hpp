@@ -0,0 +1,212 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+#ifndef __DGP_SmallArrayN_hpp__
+#define __DGP_SmallArrayN_hpp__
+
+#include "Common.hpp"
+#include <algorithm>
+#include <iterator>
+
+namespace DGP {
+
+/**
+ * A resizable array that stores up to N elements within the object itself, and only allocates memory on the heap when it grows
+ * beyond N elements. This class is useful for very many small sequences whose size is usually, but not always, at most N: they
+ * then take no separate allocations and are contiguous in memory with their owner.
+ *
+ * The interface follows the STL sequence containers (including push_front() and reverse(), as in <tt>std::list</tt>, so that
+ * it can replace a short list). Iterators are raw pointers. Unlike a list, inserting or erasing elements invalidates iterators
+ * at or after the point of insertion or erasure, and growing beyond the current capacity invalidates all iterators.
+ *
+ * T must be default-constructible and assignable. The capacity N should be <b>positive</b> (non-zero).
+ *
+ * For a stack-based array whose size can never exceed N, see BoundedArrayN.
+ */
+template <int N, typename T>
+class SmallArrayN
+{
+  public:
+    typedef T                                      value_type;              ///< Type of elements.
+    typedef T *                                    iterator;                ///< Iterator over elements.
+    typedef T const *                              const_iterator;          ///< Const iterator over elements.
+    typedef std::reverse_iterator<iterator>        reverse_iterator;        ///< Reverse iterator over elements.
+    typedef std::reverse_iterator<const_iterator>  const_reverse_iterator;  ///< Const reverse iterator over elements.
+
+    /** Constructor. */
+    SmallArrayN() : values(local_values), num_elems(0), capacity(N) {}
+
+    /** Copy constructor. */
+    SmallArrayN(SmallArrayN const & src) : values(local_values), num_elems(0), capacity(N) { *this = src; }
+
+    /** Destructor. */
+    ~SmallArrayN() { if (values != local_values) delete [] values; }
+
+    /** Assignment operator. */
+    SmallArrayN & operator=(SmallArrayN const & src)
+    {
+      if (this != &src)
+      {
+        num_elems = 0;
+        reserve(src.num_elems);
+        std::copy(src.begin(), src.end(), values);
+        num_elems = src.num_elems;
+      }
+
+      return *this;
+    }
+
+    /** Get the number of elements in the array. */
+    size_t size() const { return (size_t)num_elems; }
+
+    /** Check if the array is empty or not. */
+    bool empty() const { return num_elems == 0; }
+
+    /** Check if the elements are stored within the object, i.e. no heap memory has been allocated. */
+    bool isLocal() const { return values == local_values; }
+
+    /** Get the element at a given position in the array. Bounds checks are only performed in debug mode. */
+    T const & operator[](size_t i) const
+    {
+      debugAssertM(i < (size_t)num_elems, "SmallArrayN: Index out of bounds");
+      return values[i];
+    }
+
+    /** Get the element at a given position in the array. Bounds checks are only performed in debug mode. */
+    T & operator[](size_t i)
+    {
+      debugAssertM(i < (size_t)num_elems, "SmallArrayN: Index out of bounds");
+      return values[i];
+    }
+
+    /** Get the first element in the array. */
+    T const & front() const { return (*this)[0]; }
+
+    /** Get the first element in the array. */
+    T & front() { return (*this)[0]; }
+
+    /** Get the last element in the array. */
+    T const & back() const { return (*this)[num_elems - 1]; }
+
+    /** Get the last element in the array. */
+    T & back() { return (*this)[num_elems - 1]; }
+
+    /** Get an iterator pointing to the first element. */
+    const_iterator begin() const { return values; }
+
+    /** Get an iterator pointing to the first element. */
+    iterator begin() { return values; }
+
+    /** Get an iterator pointing to the position beyond the last element. */
+    const_iterator end() const { return values + num_elems; }
+
+    /** Get an iterator pointing to the position beyond the last element. */
+    iterator end() { return values + num_elems; }
+
+    /** Get a reverse iterator pointing to the last element. */
+    const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+
+    /** Get a reverse iterator pointing to the last element. */
+    reverse_iterator rbegin() { return reverse_iterator(end()); }
+
+    /** Get a reverse iterator pointing to the position before the first element. */
+    const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+    /** Get a reverse iterator pointing to the position before the first element. */
+    reverse_iterator rend() { return reverse_iterator(begin()); }
+
+    /** Make sure the array can hold at least a given number of elements without allocating more memory. */
+    void reserve(size_t n)
+    {
+      if (n <= (size_t)capacity)
+        return;
+
+      size_t new_capacity = std::max(n, 2 * (size_t)capacity);
+      T * new_values = new T[new_capacity];
+      std::copy(begin(), end(), new_values);
+
+      if (values != local_values)
+        delete [] values;
+
+      values = new_values;
+      capacity = (uint32)new_capacity;
+    }
+
+    /** Add an element to the end of the array. */
+    void push_back(T const & t)
+    {
+      if (num_elems >= capacity)
+      {
+        T copy = t;  // t might be an element of this array
+        reserve((size_t)num_elems + 1);
+        values[num_elems++] = copy;
+      }
+      else
+        values[num_elems++] = t;
+    }
+
+    /** Add an element to the beginning of the array, shifting all existing elements up by one position. */
+    void push_front(T const & t) { insert(begin(), t); }
+
+    /**
+     * Insert an element before a given position, shifting all existing elements at or after this position up by one position.
+     *
+     * @return An iterator pointing to the inserted element.
+     */
+    iterator insert(iterator pos, T const & t)
+    {
+      size_t i = (size_t)(pos - values);
+      T copy = t;  // t might be an element of this array
+      reserve((size_t)num_elems + 1);
+
+      std::copy_backward(values + i, values + num_elems, values + num_elems + 1);
+      values[i] = copy;
+      ++num_elems;
+
+      return values + i;
+    }
+
+    /** Remove the last element of the array. */
+    void pop_back()
+    {
+      debugAssertM(num_elems > 0, "SmallArrayN: Can't remove element from empty array");
+      --num_elems;
+    }
+
+    /**
+     * Remove the element at a given position, shifting all elements after it down by one position.
+     *
+     * @return An iterator pointing to the element that followed the removed one.
+     */
+    iterator erase(iterator pos)
+    {
+      std::copy(pos + 1, end(), pos);
+      --num_elems;
+      return pos;
+    }
+
+    /** Reverse the order of the elements. */
+    void reverse() { std::reverse(begin(), end()); }
+
+    /** Remove all elements from the array. Any heap memory is retained for reuse. */
+    void clear() { num_elems = 0; }
+
+  private:
+    T * values;          ///< The elements, either local_values or a heap allocation.
+    uint32 num_elems;    ///< Number of elements.
+    uint32 capacity;     ///< Number of elements that can be stored without reallocation.
+    T local_values[N];   ///< Storage for the first N elements.
+
+}; // class SmallArrayN
+
+} // namespace DGP
+
+#endif
@@ -13,6 +13,7 @@
 #define __DGP_Spinlock_hpp__
 
 #include "AtomicInt32.hpp"
+#include <atomic>
 
 namespace DGP {
 
@@ -36,6 +37,24 @@ class DGP_API Spinlock
       while (atomic.compareAndSet(0, 1) != 0) {}
     }
 
+    /**
+     * Try to acquire the lock without waiting.
+     *
+     * @return True if the lock was obtained, false if it is held by another thread (or by this one).
+     *
+     * @see lock(), unlock()
+     */
+    bool tryLock()
+    {
+      return atomic.compareAndSet(0, 1) == 0;
+    }
+
+    /** Check if the lock is currently held. This is only a snapshot if other threads are using the lock. */
+    bool isLocked() const
+    {
+      return atomic.value() != 0;
+    }
+
     /**
      * Release the lock by atomically setting the value of an integer to zero. This operation is immediate and does not wait.
      *
@@ -43,6 +62,7 @@ class DGP_API Spinlock
      */
     void unlock()
     {
+      std::atomic_thread_fence(std::memory_order_release);  // writes made while holding the lock must not be moved past this
       atomic = 0;
     }
 
@@ -0,0 +1,162 @@
+#include "DecimationWorker.hpp"
+#include "Mesh.hpp"
+#include "DGP/System.hpp"
+#include <unordered_map>
+
+DecimationWorker::DecimationWorker()
+: mesh(NULL), running(false), cancelled(false)
+{}
+
+DecimationWorker::~DecimationWorker()
+{
+  cancel();
+  wait();
+}
+
+bool
+DecimationWorker::start(Mesh * mesh_, long target_num_faces, double publish_interval)
+{
+  alwaysAssertM(mesh_, "DecimationWorker: Mesh must be non-null");
+
+  if (thread.joinable())
+  {
+    if (running)
+      return false;
+
+    thread.join();
+  }
+
+  mesh = mesh_;
+  running = true;
+  cancelled = false;
+
+  {
+    std::lock_guard<std::mutex> lock(snapshot_mutex);
+    front.reset();
+  }
+
+  thread = std::thread(&DecimationWorker::run, this, target_num_faces, publish_interval);
+  return true;
+}
+
+void
+DecimationWorker::wait()
+{
+  if (thread.joinable())
+    thread.join();
+}
+
+DecimationWorker::SnapshotPtr
+DecimationWorker::getSnapshot() const
+{
+  std::lock_guard<std::mutex> lock(snapshot_mutex);
+  return front;
+}
+
+void
+DecimationWorker::run(long target_num_faces, double publish_interval)
+{
+  // Check the clock only every so often, since a collapse can be much cheaper than a call to the clock
+  static long const COLLAPSES_PER_CLOCK_CHECK = 64;
+
+  // Snapshots are taken at most this often, relative to the time taken to create one, so that the time spent on them is a small
+  // fraction of the time spent decimating
+  static double const MIN_TIME_BETWEEN_SNAPSHOTS = 10;
+
+  double start_time = System::time();
+  long initial_num_faces = mesh->numFaces();
+  long total_steps = std::max(initial_num_faces - target_num_faces, 0L);
+
+  publish(0, 0, total_steps, 0, total_steps <= 0);
+
+  double next_publish_time = start_time + publish_interval;
+  long num_collapses = 0;
+  while (mesh->numFaces() > target_num_faces && !cancelled)
+  {
+    Mesh::CollapseStatus status;
+    mesh->decimateQuadricEdgeCollapse(NULL, &status);
+    if (status == Mesh::NO_EDGES_LEFT)
+      break;
+    else if (status == Mesh::EDGE_SKIPPED)
+      continue;
+
+    if (++num_collapses % COLLAPSES_PER_CLOCK_CHECK == 0)
+    {
+      double now = System::time();
+      if (now >= next_publish_time)
+      {
+        publish(num_collapses, initial_num_faces - mesh->numFaces(), total_steps, now - start_time, false);
+
+        double snapshot_time = System::time() - now;
+        next_publish_time = now + std::max(publish_interval, MIN_TIME_BETWEEN_SNAPSHOTS * snapshot_time);
+      }
+    }
+  }
+
+  mesh->updateBounds();
+  publish(num_collapses, initial_num_faces - mesh->numFaces(), total_steps, System::time() - start_time, true);
+
+  DGP_DEBUG << "DecimationWorker: Decimated mesh '" << mesh->getName() << "' from " << initial_num_faces << " to "
+            << mesh->numFaces() << " faces in " << System::time() - start_time << 's';
+
+  running = false;
+}
+
+void
+DecimationWorker::publish(long num_collapses, long steps_done, long total_steps, double elapsed_time, bool finished)
+{
+  // The back buffer can only be reused if no reader still holds it
+  if (!back || back.use_count() > 1)
+    back = std::make_shared<Snapshot>();
+
+  Snapshot & s = *back;
+  s.positions.clear();
+  s.normals.clear();
+  s.tri_indices.clear();
+
+  mesh->updateNormals();
+
+  std::unordered_map<Mesh::Vertex const *, uint32> vertex_indices;
+  vertex_indices.reserve((size_t)mesh->numVertices());
+  s.positions.reserve((size_t)mesh->numVertices());
+  s.normals.reserve((size_t)mesh->numVertices());
+  for (Mesh::VertexConstIterator vi = mesh->verticesBegin(); vi != mesh->verticesEnd(); ++vi)
+  {
+    vertex_indices[&(*vi)] = (uint32)s.positions.size();
+    s.positions.push_back(vi->getPosition());
+    s.normals.push_back(vi->getNormal());
+  }
+
+  // Split each face into a fan of triangles
+  s.tri_indices.reserve((size_t)(3 * mesh->numFaces()));
+  for (Mesh::FaceConstIterator fi = mesh->facesBegin(); fi != mesh->facesEnd(); ++fi)
+  {
+    if (fi->numVertices() < 3)
+      continue;
+
+    Mesh::Face::VertexConstIterator fvi = fi->verticesBegin();
+    uint32 i0 = vertex_indices[*(fvi++)];
+    uint32 i1 = vertex_indices[*(fvi++)];
+    for ( ; fvi != fi->verticesEnd(); ++fvi)
+    {
+      uint32 i2 = vertex_indices[*fvi];
+      s.tri_indices.push_back(i0);
+      s.tri_indices.push_back(i1);
+      s.tri_indices.push_back(i2);
+      i1 = i2;
+    }
+  }
+
+  s.num_vertices = mesh->numVertices();
+  s.num_faces = mesh->numFaces();
+  s.num_collapses = num_collapses;
+  s.steps_done = steps_done;
+  s.total_steps = total_steps;
+  s.elapsed_time = elapsed_time;
+  s.finished = finished;
+
+  {
+    std::lock_guard<std::mutex> lock(snapshot_mutex);
+    std::swap(front, back);
+  }
+}
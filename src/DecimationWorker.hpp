@@ -0,0 +1,103 @@
+#ifndef __A2_DecimationWorker_hpp__
+#define __A2_DecimationWorker_hpp__
+
+#include "Common.hpp"
+#include "DGP/Noncopyable.hpp"
+#include "DGP/Vector3.hpp"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Forward declaration
+class Mesh;
+
+/**
+ * Decimates a mesh on a background thread, so that an interactive viewer stays responsive. While the worker is running it owns
+ * the mesh, which must not be accessed by any other thread. Instead, the worker periodically publishes an immutable snapshot of
+ * the mesh in a compact, renderable form, which other threads can display. Snapshots are double-buffered: the worker fills a
+ * back buffer and swaps it with the front buffer, reusing the old front buffer for the next snapshot once no reader holds it.
+ */
+class DecimationWorker : private Noncopyable
+{
+  public:
+    /** An immutable copy of the mesh at some point during decimation, as indexed triangles with smooth vertex normals. */
+    struct Snapshot
+    {
+      /** Constructor. */
+      Snapshot()
+      : num_vertices(0), num_faces(0), num_collapses(0), steps_done(0), total_steps(0), elapsed_time(0), finished(false) {}
+
+      /** Get the fraction of the decimation that has been completed, in [0, 1]. */
+      double progress() const { return total_steps > 0 ? std::min(steps_done / (double)total_steps, 1.0) : 1.0; }
+
+      std::vector<Vector3> positions;    ///< Vertex positions.
+      std::vector<Vector3> normals;      ///< Vertex normals.
+      std::vector<uint32> tri_indices;   ///< Vertex indices of triangles, three per triangle.
+      long num_vertices;                 ///< Number of vertices of the mesh.
+      long num_faces;                    ///< Number of faces of the mesh (before splitting polygons into triangles).
+      long num_collapses;                ///< Number of edges collapsed so far.
+      long steps_done;                   ///< Number of faces removed so far.
+      long total_steps;                  ///< Number of faces to remove.
+      double elapsed_time;               ///< Seconds since decimation started.
+      bool finished;                     ///< True if this is the final state of the mesh.
+    };
+
+    /** Shared, read-only handle to a snapshot. */
+    typedef std::shared_ptr<Snapshot const> SnapshotPtr;
+
+    /** Constructor. */
+    DecimationWorker();
+
+    /** Destructor. Stops any decimation in progress. */
+    ~DecimationWorker();
+
+    /**
+     * Start decimating a mesh to a target number of faces on a background thread. Assumes the quadrics and collapse errors of
+     * the mesh have been initialized, as for Mesh::decimateQuadricEdgeCollapse(). The mesh must not be accessed by other
+     * threads until the worker has stopped (see isRunning() and wait()).
+     *
+     * @param mesh The mesh to decimate.
+     * @param target_num_faces The number of faces to stop at.
+     * @param publish_interval The minimum number of seconds between snapshots. The interval is increased automatically if
+     *   taking snapshots would otherwise slow down decimation noticeably.
+     *
+     * @return True if decimation was started, false if the worker is already running.
+     */
+    bool start(Mesh * mesh, long target_num_faces, double publish_interval = 0.25);
+
+    /** Ask the worker to stop at the next opportunity, without waiting for it to do so. */
+    void cancel() { cancelled = true; }
+
+    /** Wait for the worker to stop. After this, the mesh may be accessed by the calling thread again. */
+    void wait();
+
+    /** Check if the worker is decimating a mesh. A false value means the mesh may be reclaimed by calling wait(). */
+    bool isRunning() const { return running; }
+
+    /** Check if the worker has been started and has not been waited for yet. */
+    bool isActive() const { return thread.joinable(); }
+
+    /** Get the most recently published snapshot, or null if none has been published yet. Safe to call from any thread. */
+    SnapshotPtr getSnapshot() const;
+
+  private:
+    /** Main function of the worker thread. */
+    void run(long target_num_faces, double publish_interval);
+
+    /** Copy the current state of the mesh to the back buffer and swap it to the front. */
+    void publish(long num_collapses, long steps_done, long total_steps, double elapsed_time, bool finished);
+
+    Mesh * mesh;                         ///< The mesh being decimated.
+    std::thread thread;                  ///< The worker thread.
+    std::atomic<bool> running;           ///< Is the worker decimating?
+    std::atomic<bool> cancelled;         ///< Has the worker been asked to stop?
+    mutable std::mutex snapshot_mutex;   ///< Protects the front buffer.
+    std::shared_ptr<Snapshot> front;     ///< The latest published snapshot.
+    std::shared_ptr<Snapshot> back;      ///< The snapshot being filled by the worker.
+
+}; // class DecimationWorker
+
+#endif
@@ -0,0 +1,160 @@
+#include "FacePlanes.hpp"
+#include "MeshFace.hpp"
+#include "MeshVertex.hpp"
+#include "DGP/Parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace FacePlanesInternal {
+
+enum { BLOCK_SIZE = 64 };
+
+// The corners of a block of triangles and their computed planes, as arrays of coordinates.
+struct TriangleBlock
+{
+  Real x[3][BLOCK_SIZE], y[3][BLOCK_SIZE], z[3][BLOCK_SIZE];
+  Real nx[BLOCK_SIZE], ny[BLOCK_SIZE], nz[BLOCK_SIZE], offset[BLOCK_SIZE], len[BLOCK_SIZE];
+};
+
+// Compute the planes of all triangles of a block (unused slots should hold degenerate triangles). The main loop has a fixed trip
+// count, no branches and no aliasing, so the compiler turns it into SIMD code. The operations and their order are those of
+// MeshFace::computeNormal(), VectorN::unit() and QuadricFrame::toLocal(), so the results are identical.
+void
+computeTrianglePlanes(TriangleBlock & b, Vector3 const & center, Real scale)
+{
+  Real const cx = center.x(), cy = center.y(), cz = center.z();
+
+  for (int i = 0; i < BLOCK_SIZE; ++i)
+  {
+    // (p2 - p1).cross(p0 - p1)
+    Real ux = b.x[2][i] - b.x[1][i], uy = b.y[2][i] - b.y[1][i], uz = b.z[2][i] - b.z[1][i];
+    Real vx = b.x[0][i] - b.x[1][i], vy = b.y[0][i] - b.y[1][i], vz = b.z[0][i] - b.z[1][i];
+    Real wx = uy * vz - uz * vy;
+    Real wy = uz * vx - ux * vz;
+    Real wz = ux * vy - uy * vx;
+
+    Real len = std::sqrt(wx * wx + wy * wy + wz * wz);
+    Real nx = wx / len, ny = wy / len, nz = wz / len;
+    Real lx = (b.x[0][i] - cx) * scale, ly = (b.y[0][i] - cy) * scale, lz = (b.z[0][i] - cz) * scale;
+
+    b.nx[i] = nx;
+    b.ny[i] = ny;
+    b.nz[i] = nz;
+    b.offset[i] = -(nx * lx + ny * ly + nz * lz);
+    b.len[i] = len;
+  }
+
+  // Degenerate triangles have zero normals, as in VectorN::unit(). Comparisons would keep the loop above from being vectorized
+  // (they may trap), so these are fixed up separately.
+  Real const tiny = 32 * std::numeric_limits<Real>::min();
+  for (int i = 0; i < BLOCK_SIZE; ++i)
+    if (!(b.len[i] >= tiny))
+    {
+      Real lx = (b.x[0][i] - cx) * scale, ly = (b.y[0][i] - cy) * scale, lz = (b.z[0][i] - cz) * scale;
+      b.nx[i] = b.ny[i] = b.nz[i] = 0;
+      b.offset[i] = -(0 * lx + 0 * ly + 0 * lz);
+    }
+}
+
+} // namespace FacePlanesInternal
+
+void
+FacePlanes::clear()
+{
+  row_begin.clear();
+  nx.clear();
+  ny.clear();
+  nz.clear();
+  offset.clear();
+}
+
+void
+FacePlanes::compute(std::vector<MeshVertex *> const & vertices, QuadricFrame const & frame, long num_threads)
+{
+  using namespace FacePlanesInternal;
+
+  size_t num_vertices = vertices.size();
+  row_begin.resize(num_vertices + 1);
+  row_begin[0] = 0;
+  for (size_t i = 0; i < num_vertices; ++i)
+    row_begin[i + 1] = row_begin[i] + (size_t)vertices[i]->numFaces();
+
+  size_t n = row_begin[num_vertices];
+  nx.resize(n);
+  ny.resize(n);
+  nz.resize(n);
+  offset.resize(n);
+
+  // The face of each row, only needed while the planes are computed
+  std::vector<MeshFace const *> faces(n);
+
+  num_threads = Parallel::numThreads((long)num_vertices, num_threads, 1024);
+  Parallel::forChunks(0, (long)num_vertices, [&](long first_vertex, long end_vertex, long)
+  {
+    for (long j = first_vertex; j < end_vertex; ++j)
+      std::copy(vertices[(size_t)j]->facesBegin(), vertices[(size_t)j]->facesEnd(), faces.begin() + row_begin[(size_t)j]);
+
+    long begin = (long)row_begin[(size_t)first_vertex], end = (long)row_begin[(size_t)end_vertex];
+#if A2_MESH_ATTRIBUTES == A2_MESH_ATTRIBUTES_FULL
+    long v = first_vertex;  // vertex of the current row
+#endif
+
+    TriangleBlock block;
+    for (long block_begin = begin; block_begin < end; block_begin += BLOCK_SIZE)
+    {
+      long block_size = std::min(end - block_begin, (long)BLOCK_SIZE);
+
+      // Gather the corners of triangles. Other faces are handled separately below, and leave degenerate triangles behind.
+      for (long i = 0; i < BLOCK_SIZE; ++i)
+      {
+        MeshFace const * face = (i < block_size ? faces[(size_t)(block_begin + i)] : NULL);
+        MeshFace::VertexConstIterator fvi = (face ? face->verticesBegin() : NULL);
+        for (int j = 0; j < 3; ++j)
+        {
+          Vector3 const & p = (face && face->isTriangle() ? fvi[j]->getPosition() : Vector3::zero());
+          block.x[j][i] = p.x();
+          block.y[j][i] = p.y();
+          block.z[j][i] = p.z();
+        }
+      }
+
+      computeTrianglePlanes(block, frame.center, frame.scale);
+
+      for (long i = 0; i < block_size; ++i)
+      {
+        size_t k = (size_t)(block_begin + i);
+        MeshFace const * face = faces[k];
+        Vector3 normal;
+        if (face->isTriangle())
+        {
+          normal = Vector3(block.nx[i], block.ny[i], block.nz[i]);
+          offset[k] = block.offset[i];
+        }
+        else
+        {
+          // Other polygons
+          normal = face->computeNormal();
+          offset[k] = (face->numVertices() > 0 ? -normal.dot(frame.toLocal((*face->verticesBegin())->getPosition())) : 0);
+        }
+
+        nx[k] = normal.x();
+        ny[k] = normal.y();
+        nz[k] = normal.z();
+
+#if A2_MESH_ATTRIBUTES == A2_MESH_ATTRIBUTES_FULL
+        // Update the normal stored with the face while it is in cache, as MeshFace::recomputeNormal() would. Only the row of
+        // its first vertex does so, so that no two threads write the same face.
+        while (row_begin[(size_t)v + 1] <= k)
+          ++v;
+
+        if (face->numVertices() > 0 && *face->verticesBegin() == vertices[(size_t)v])
+        {
+          face->normal = normal;
+          face->normal_dirty = false;
+        }
+#endif
+      }
+    }
+  }, num_threads);
+}
@@ -0,0 +1,67 @@
+#ifndef __A2_FacePlanes_hpp__
+#define __A2_FacePlanes_hpp__
+
+#include "Common.hpp"
+#include "QuadricFrame.hpp"
+#include "DGP/Vector3.hpp"
+#include <vector>
+
+// Forward declarations
+class MeshVertex;
+class MeshFace;
+
+/**
+ * The supporting planes of the faces around a sequence of vertices: a unit normal and an offset per row, stored as separate
+ * arrays of scalars (structure of arrays) rather than per face. The plane of row i is the set of points p with
+ * <code>getNormal(i).dot(p) + getOffset(i) = 0</code>, and passes through the first vertex of the face of the row.
+ *
+ * The faces of vertex j are rows beginRow(j) to beginRow(j + 1) - 1, in the order of the vertex's own list of faces, so that a
+ * vertex reads its planes from consecutive rows, without looking its faces up in the table. A face has one row per vertex of
+ * the sequence that it is incident on.
+ *
+ * All values are computed in one pass by compute(). Vertices are processed in parallel, with their rows in blocks whose vertex
+ * positions are first gathered into arrays of coordinates, so that the arithmetic on triangles runs over contiguous arrays and
+ * is vectorized by the compiler. The normals are bitwise identical to those computed by the faces themselves, and the normals
+ * stored with the faces (if any) are updated to them on the way.
+ */
+class FacePlanes
+{
+  public:
+    /** Clear all data. */
+    void clear();
+
+    /**
+     * Compute the planes of the faces around a sequence of vertices, and update the normals stored with the faces. The normal
+     * of a face is updated once, from the row of its first vertex, which must be in the sequence. The vertices themselves are
+     * not changed.
+     *
+     * @param vertices The vertices. The rows of vertex i of this sequence start at beginRow(i).
+     * @param frame Offsets are computed for vertex positions mapped to this frame (see QuadricFrame::toLocal()). Normals are
+     *   the same in every frame.
+     * @param num_threads The number of threads to use. If non-positive, all available hardware threads are used.
+     */
+    void compute(std::vector<MeshVertex *> const & vertices, QuadricFrame const & frame = QuadricFrame(),
+                 long num_threads = -1);
+
+    /** Get the number of rows. */
+    long size() const { return (long)offset.size(); }
+
+    /** Get the first row of a vertex, or the number of rows for the index one beyond the last vertex. */
+    long beginRow(long vertex_index) const { return (long)row_begin[(size_t)vertex_index]; }
+
+    /** Get the unit normal of the face of a row, or zero if the face is degenerate. */
+    Vector3 getNormal(long i) const { return Vector3(nx[(size_t)i], ny[(size_t)i], nz[(size_t)i]); }
+
+    /** Get the plane offset of the face of a row, in the frame passed to compute(). */
+    Real getOffset(long i) const { return offset[(size_t)i]; }
+
+  private:
+    std::vector<size_t> row_begin;  ///< First row of each vertex, followed by the number of rows.
+    std::vector<Real> nx;           ///< X coordinates of normals.
+    std::vector<Real> ny;           ///< Y coordinates of normals.
+    std::vector<Real> nz;           ///< Z coordinates of normals.
+    std::vector<Real> offset;       ///< Plane offsets.
+
+}; // class FacePlanes
+
+#endif
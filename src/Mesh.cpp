@@ -1,22 +1,121 @@
 #include "Mesh.hpp"
+#include "CheckpointWriter.hpp"
 #include "MeshVertex.hpp"
 #include "MeshEdge.hpp"
 #include "MeshFace.hpp"
+#include "MultiQueue.hpp"
+#include "UnionFind.hpp"
+#include "DGP/BoundedSortedArray.hpp"
 #include "DGP/FilePath.hpp"
+#include "DGP/Parallel.hpp"
+#include "DGP/Polygon2.hpp"
+#include "DGP/Polygon3.hpp"
+#include "DGP/Random.hpp"
+#include "DGP/Graphics/GLCaps.hpp"
 #include <algorithm>
 #include <cmath>
 #include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 
+uint32 const Mesh::RenderCache::NONE;
+
+void
+Mesh::insert_into_heap(std::multiset<Edge*, EdgeHeapComp>& eh, Edge* e)
+{
+  e->heap_sequence = next_heap_sequence++;
+  eh.insert(e);
+}
+
+void
+Mesh::remove_from_heap(std::multiset<Edge*, EdgeHeapComp>& eh, Edge* e)
+{
+  // Keys are unique, so this finds the edge itself, if it is in the queue
+  auto it = eh.find(e);
+  if (it != eh.end() && *it == e)
+    eh.erase(it);
+
+  // All removed edges pass through here, including those removed by decimateMultipleChoice(), which has no heap
+  removeCollapseCandidate(e);
+}
+
+void
+Mesh::removeCollapseCandidate(Edge * edge)
+{
+  if (!isCollapseCandidate(edge))
+    return;
+
+  // Move the last edge of the pool into the vacated position
+  Edge * last = collapse_candidates.back();
+  last->candidate_index = edge->candidate_index;
+  collapse_candidates[last->candidate_index] = last;
+  collapse_candidates.pop_back();
+}
+
+void
+Mesh::removeVertex(Vertex * vertex)
+{
+  if (deferred_removals)
+  {
+    deferred_removals->add(vertex);
+    return;
+  }
+
+  std::unordered_map<Vertex const *, VertexIterator>::iterator loc = vertex_locations.find(vertex);
+  if (loc == vertex_locations.end())
+    return;
+
+  if (change_log) change_log->remove(vertex);
+
+  vertices.erase(loc->second);
+  vertex_locations.erase(loc);
+}
+
+void
+Mesh::eraseDeferredRemovals(DeferredRemovals & removals)
+{
+  deferred_removals = NULL;
+
+  for (size_t i = 0; i < removals.faces.size(); ++i)
+  {
+    std::unordered_map<Face const *, FaceIterator>::iterator loc = face_locations.find(removals.faces[i]);
+    faces.erase(loc->second);
+    face_locations.erase(loc);
+  }
+
+  for (size_t i = 0; i < removals.vertices.size(); ++i)
+    removeVertex(removals.vertices[i]);
+
+  removals.faces.clear();
+  removals.vertices.clear();
+}
+
 void
-Mesh::remove_from_heap(std::multiset<Edge*, EdgeComp>& eh, Edge* e)
+Mesh::eraseRemovedEdges()
 {
-  auto pp = eh.equal_range(e);
-  std::multiset<Edge*, EdgeComp>::iterator tod;
-  for (auto it = pp.first; it != pp.second; it++)
-    if (*it == e)
-      tod = it;
-  eh.erase(tod);
+  // Each edge of the mesh is found once, through its first endpoint
+  std::vector<Edge const *> live_edges;
+  for (VertexIterator vi = vertices.begin(); vi != vertices.end(); ++vi)
+    for (Vertex::EdgeIterator vei = vi->edgesBegin(); vei != vi->edgesEnd(); ++vei)
+      if ((*vei)->getEndpoint(0) == &(*vi))
+        live_edges.push_back(*vei);
+
+  if (live_edges.size() == edges.size())
+    return;
+
+  std::sort(live_edges.begin(), live_edges.end());
+  for (EdgeIterator ei = edges.begin(); ei != edges.end(); )
+  {
+    if (std::binary_search(live_edges.begin(), live_edges.end(), &(*ei)))
+      ++ei;
+    else
+      ei = edges.erase(ei);
+  }
+
+  invalidateRenderCache();
 }
 
 MeshEdge *
@@ -52,6 +151,7 @@ Mesh::mergeEdges(Edge * e0, Edge * e1)
 
     edges_to_remove[i]->getEndpoint(0)->removeEdge(edges_to_remove[i]);
     edges_to_remove[i]->getEndpoint(1)->removeEdge(edges_to_remove[i]);
+    if (change_log) change_log->remove(edges_to_remove[i]);
 
     remove_from_heap(edge_heap, edges_to_remove[i]);
   }
@@ -65,36 +165,39 @@ Mesh::mergeEdges(Edge * e0, Edge * e1)
     if (!vertices_to_remove[i])
       continue;
 
-    for (VertexIterator vj = vertices.begin(); vj != vertices.end(); ++vj)
-      if (&(*vj) == vertices_to_remove[i])
-      {
-        vertices.erase(vj);
-        break;
-      }
+    removeVertex(vertices_to_remove[i]);
   }
 
   return (edges_to_remove[1] == e0 ? NULL : e0);
 }
 
 MeshVertex *
-Mesh::collapseEdge(Edge * edge)
+Mesh::collapseEdge(Edge * edge, bool * collapsed)
 {
+  if (collapsed)
+    *collapsed = false;
+
   if (!edge)
     return NULL;
 
+  if (triangles_only)
+    return collapseTriangleEdge(edge, collapsed);
+
   Vertex * u = edge->getEndpoint(0);
   Vertex * v = edge->getEndpoint(1);
 
   if (u == v)
   {
-    DGP_CONSOLE << getName() << ": Can't collapse edge that is self loop";
+    DGP_TRACE << getName() << ": Can't collapse edge that is self loop";
     return NULL;
   }
 
-  // Check if u is a repeated vertex in any face. If so, preferentially remove it (one copy at a time)
+  // Check if u is a repeated vertex in any face. If so, preferentially remove it (one copy at a time). Only the faces
+  // incident on u can contain it.
   bool stop = false;
-  for (FaceConstIterator fi = faces.begin(); fi != faces.end(); ++fi)
+  for (Vertex::FaceConstIterator ufi = u->facesBegin(); ufi != u->facesEnd(); ++ufi)
   {
+    Face const * fi = *ufi;
     int num_occurrences = 0;
     for (MeshFace::VertexConstIterator vi = fi->verticesBegin(); vi != fi->verticesEnd(); ++vi)
     {
@@ -171,14 +274,58 @@ Mesh::collapseEdge(Edge * edge)
 
   assert(edge->numFaces() == 0);
 
-  // Faces adjacent to the edge do not reference it, or v, any more. 'edge' is isolated except for its references to u and v.
-  // The mesh is in an inconsistent state since the face does not reference v whereas the next edge around the face does.
+  // Faces adjacent to the edge do not reference it, or v, any more. The mesh is in an inconsistent state since the face does
+  // not reference v whereas the next edge around the face does. Faces shrunk below a triangle are removed right away.
+
+  for (size_t i = 0; i < edge_faces.size(); ++i)
+  {
+    Face * face = edge_faces[i];
+    if (face->numVertices() >= 3)
+      continue;
+
+    removeFace(face);
+  }
+
+  if (collapsed)
+    *collapsed = true;
+
+  return finishCollapse(edge, u, v);
+}
+
+MeshVertex *
+Mesh::collapseTriangleEdge(Edge * edge, bool * collapsed)
+{
+  Vertex * u = edge->getEndpoint(0);
+  Vertex * v = edge->getEndpoint(1);
+
+  if (u == v)
+  {
+    DGP_TRACE << getName() << ": Can't collapse edge that is self loop";
+    return NULL;
+  }
+
+  // Each face on the edge has u and v as two of its three vertices, and would be left with just u and the third vertex
+  while (edge->numFaces() > 0)
+    removeFace(*edge->facesBegin());
 
+  // The edge has no faces. The mesh is in a consistent state.
+
+  if (collapsed)
+    *collapsed = true;
+
+  return finishCollapse(edge, u, v);
+}
+
+MeshVertex *
+Mesh::finishCollapse(Edge * edge, Vertex * u, Vertex * v)
+{
+  // Edges and faces of v that already have u are already known to u, which saves searching the (possibly long) lists of u
   for (Vertex::EdgeIterator vei = v->edgesBegin(); vei != v->edgesEnd(); ++vei)
   {
+    bool had_u = (*vei)->hasEndpoint(u);
     (*vei)->replaceVertex(v, u);  // this also makes edge = (u, u)
 
-    if (!u->hasIncidentEdge(*vei))
+    if (!had_u)
       u->addEdge(*vei);
   }
 
@@ -191,9 +338,10 @@ Mesh::collapseEdge(Edge * edge)
 
   for (Vertex::FaceIterator vfi = v->facesBegin(); vfi != v->facesEnd(); ++vfi)
   {
+    bool had_u = (*vfi)->hasVertex(u);
     (*vfi)->replaceVertex(v, u);  // no-op if we had removed v from this face above
 
-    if (!u->hasIncidentFace(*vfi))
+    if (!had_u)
       u->addFace(*vfi);
   }
 
@@ -201,64 +349,111 @@ Mesh::collapseEdge(Edge * edge)
 
   assert(v->numFaces() == 0);
 
+#if A2_MESH_ATTRIBUTES == A2_MESH_ATTRIBUTES_FULL
+  // Faces that had v now have u at a different position, and faces adjacent to the edge have lost a vertex
+  for (Vertex::FaceIterator ufi = u->facesBegin(); ufi != u->facesEnd(); ++ufi)
+    (*ufi)->invalidateNormal();
+#endif
+
+  invalidateRenderCache();
+
   // No faces reference v any more. The mesh is in a consistent state.
 
   remove_from_heap(edge_heap, edge);
 
   u->removeEdge(edge);
+  if (change_log) change_log->remove(edge);
 
   // No more edge. The mesh is in a consistent state
 
-  for (VertexIterator vi = vertices.begin(); vi != vertices.end(); ++vi)
-    if (&(*vi) == v)
-    {
-      vertices.erase(vi);
-      break;
-    }
+  removeVertex(v);
 
   // No more v. The mesh is in a consistent state.
 
-  for (size_t i = 0; i < edge_faces.size(); ++i)
+  // Merge edges that now join u to the same vertex (this can happen either because faces were shrunk to zero, or because the
+  // mesh has genus > 0). Sorting the edges of u on their other endpoint brings duplicates together, in O(d log d) time for
+  // valence d. The buffer is reused across collapses, and is per thread since decimateConcurrent() collapses on many.
+  static thread_local std::vector<EdgeKey> edge_keys;
+  edge_keys.clear();
+  size_t position = 0;
+  for (Vertex::EdgeIterator vei = u->edgesBegin(); vei != u->edgesEnd(); ++vei, ++position)
   {
-    Face * face = edge_faces[i];
-    if (face->numVertices() >= 3)
+    EdgeKey key = { (*vei)->getOtherEndpoint(u), position, position, *vei };
+    edge_keys.push_back(key);
+  }
+
+  std::sort(edge_keys.begin(), edge_keys.end());
+
+  // Keep only the duplicates, each with the position of the first edge of its group, and put them back in list order
+  size_t num_duplicates = 0;
+  for (size_t group_begin = 0, group_end = 0; group_begin < edge_keys.size(); group_begin = group_end)
+  {
+    for (group_end = group_begin + 1;
+         group_end < edge_keys.size() && edge_keys[group_end].other == edge_keys[group_begin].other; ++group_end) {}
+
+    if (group_end - group_begin <= 1)
       continue;
 
-    removeFace(face);
+    size_t group = edge_keys[group_begin].position;  // may be overwritten below
+    for (size_t i = group_begin; i < group_end; ++i)
+    {
+      edge_keys[num_duplicates] = edge_keys[i];
+      edge_keys[num_duplicates++].group = group;
+    }
   }
 
-  // All faces shrunk to zero by the edge collapse have been removed.
+  if (num_duplicates <= 0)
+    return u;
+
+  edge_keys.resize(num_duplicates);
+  std::sort(edge_keys.begin(), edge_keys.end(),
+            [](EdgeKey const & a, EdgeKey const & b) { return a.position < b.position; });
 
-  bool found = true;
-  while (found)
+  // Merge each duplicate into the current survivor of its group, which is held by the first edge of the group, in list order.
+  // This makes the same merges in the same order as a pairwise scan of the list, which is what decides the resulting mesh.
+  for (size_t i = 0; i < edge_keys.size(); ++i)
   {
-    found = false;
+    if (edge_keys[i].position == edge_keys[i].group)
+      continue;
 
-    for (Vertex::EdgeIterator vei = u->edgesBegin(); vei != u->edgesEnd(); ++vei)
-    {
-      for (Vertex::EdgeIterator vej = u->edgesBegin(); vej != vei; ++vej)
-        if ((*vei)->isCoincidentTo(**vej))
-        {
-          mergeEdges(*vei, *vej);
-          found = true;
-          break;
-        }
+    EdgeKey const probe = { NULL, edge_keys[i].group, 0, NULL };
+    EdgeKey & first = *std::lower_bound(edge_keys.begin(), edge_keys.begin() + (long)i, probe,
+                                        [](EdgeKey const & a, EdgeKey const & b) { return a.position < b.position; });
 
-      if (found)
-        break;
+    Edge * e = edge_keys[i].edge;
+    Edge * survivor = first.edge;
+    if (!survivor)  // the previous merge removed both edges, since neither had faces
+    {
+      first.edge = e;
+      continue;
     }
+
+    // If these are the last edges of u and have no faces, merging them removes u, which happens when the collapse consumes the
+    // last faces of a component
+    bool removes_u = (u->numFaces() <= 0 && u->numEdges() == 2 && e->numFaces() + survivor->numFaces() <= 0);
+
+    first.edge = mergeEdges(e, survivor);
+    if (removes_u)
+      return NULL;
   }
 
-  // All double edges have been collapsed to single edges (this can happen either because faces were shrunk to zero, or because
-  // the mesh has genus > 0).
+  // All double edges have been collapsed to single edges
 
   return u;
 }
 
+void
+Mesh::updateTriangleFlag()
+{
+  triangles_only = true;
+  for (FaceConstIterator fi = faces.begin(); fi != faces.end() && triangles_only; ++fi)
+    triangles_only = fi->isProperTriangle();
+}
+
 MeshVertex *
-Mesh::decimateQuadricEdgeCollapse()
+Mesh::decimateQuadricEdgeCollapse(Changes * changes, CollapseStatus * status)
 {
-  DGP_CONSOLE << getName() << ": Mesh has " << numFaces() << " faces, collapsing a single edge";
+  DGP_TRACE << getName() << ": Mesh has " << numFaces() << " faces, collapsing a single edge";
 
   // The general scheme here is:
   // (1) Loop over edges to find the one with the minimum error (remember to check if the error is negative, in which case the
@@ -266,18 +461,19 @@ Mesh::decimateQuadricEdgeCollapse()
   // (2) Collapse the min error edge, if a valid one is found (else return NULL). There is a convenient function for this (it is
   //     a good exercise to study how this function operates). Make a note of the single vertex which is the result of the
   //     collapse.
-  // (3) Update the normal of every face incident on this vertex.
-  // (4) Update the quadric for this vertex, as well as the normal of the vertex (there are convenient functions for this, one
-  //     of which you will write yourself).
-  // (5) For every edge incident on this vertex:
-  //     - Update the quadric and normal for its other endpoint, which has also been affected.
+  // (3) Update the quadric for this vertex.
+  // (4) For every edge incident on this vertex:
+  //     - Update the quadric for its other endpoint, which has also been affected.
   //     - Update the quadric collapse error and the optimal collapse position for the edge.
-  // (6) Return the vertex.
+  // (5) Return the vertex.
+  //
+  // Normals are not updated here. Moving the vertex marks the affected face and vertex normals as out of date, and the
+  // quadric updates recompute just the face normals they need, on demand.
 
   if (not heap_constructed)
   {
     for (auto &e : edges)
-      edge_heap.insert(&e);
+      insert_into_heap(edge_heap, &e);
     heap_constructed = true;
     assert(edge_heap.size() == edges.size());
   }
@@ -287,176 +483,1561 @@ Mesh::decimateQuadricEdgeCollapse()
   if (edge_heap.begin() != edge_heap.end())
     min_edge = *edge_heap.begin();
   else
+  {
+    if (status)
+      *status = NO_EDGES_LEFT;
+
     return NULL;
+  }
 
-  auto v = collapseEdge(min_edge);
-  v->setPosition(min_edge->getQuadricCollapsePosition());
+  // Edits between recorded collapses would not be reflected in the record
+  if (changes)
+  {
+    if (changes->isEmpty())
+      changes->begin_version = edit_version;
+    else if (changes->end_version != edit_version)
+      changes->complete = false;
+  }
+
+  change_log = changes;
+  bool collapsed = false;
+  auto v = collapseEdge(min_edge, &collapsed);
+  change_log = NULL;
+
+  if (!v)
+  {
+    // The collapse may have removed the last faces of a component along with all its vertices, which is still an edit
+    if (changes && !(changes->removed_vertices.empty() && changes->removed_edges.empty() && changes->removed_faces.empty()))
+    {
+      changes->num_edits++;
+      changes->end_version = edit_version;
+    }
+
+    // An edge that cannot be collapsed would otherwise stay at the top of the queue and block every edge behind it. It is
+    // queued again if a collapse next to it updates its error.
+    if (!collapsed)
+      remove_from_heap(edge_heap, min_edge);
+
+    if (status)
+      *status = (collapsed ? COMPONENT_REMOVED : EDGE_SKIPPED);
+
+    return NULL;
+  }
 
-  for (auto &f : v->faces)
-      f->updateNormal();
+  v->setPosition(min_edge->getQuadricCollapsePosition());
 
-  v->updateQuadric();
-  v->updateNormal();
+  v->updateQuadric(quadric_frame);
 
   for (auto &e : v->edges)
   {
     remove_from_heap(edge_heap, e);
-    e->getOtherEndpoint(v)->updateQuadric();
-    e->getOtherEndpoint(v)->updateNormal();
-    e->updateQuadricCollapseError();
-    edge_heap.insert(e);
+    e->getOtherEndpoint(v)->updateQuadric(quadric_frame);
+    e->updateQuadricCollapseError(quadric_frame);
+    insert_into_heap(edge_heap, e);
+  }
+
+  if (changes)
+  {
+    // The retained vertex has moved and its incident faces and edges have changed. The normals of its neighbors have also
+    // changed, since they depend on the normals of the faces.
+    changes->touch(v);
+    for (Vertex::EdgeConstIterator vei = v->edgesBegin(); vei != v->edgesEnd(); ++vei)
+    {
+      changes->touch(*vei);
+      changes->touch((*vei)->getOtherEndpoint(v));
+    }
+
+    for (Vertex::FaceConstIterator vfi = v->facesBegin(); vfi != v->facesEnd(); ++vfi)
+      changes->touch(*vfi);
+
+    changes->num_edits++;
+    changes->end_version = edit_version;
   }
 
+  if (status)
+    *status = EDGE_COLLAPSED;
+
   return v;
 }
 
 void
-Mesh::decimateQuadricEdgeCollapse(long target_num_faces)
+Mesh::decimateQuadricEdgeCollapse(long target_num_faces, ProgressReporter * progress)
+{
+  decimateQuadricEdgeCollapse(target_num_faces, std::string(), 0, progress);
+}
+
+void
+Mesh::decimateQuadricEdgeCollapse(long target_num_faces, std::string const & checkpoint_path, long checkpoint_interval,
+                                  ProgressReporter * progress)
 {
   if (target_num_faces < 0)
     return;
 
+  long initial_num_faces = numFaces();
+  if (progress)
+    progress->begin(initial_num_faces - target_num_faces);
+
+  CheckpointWriter checkpoint_writer;
+  long num_collapses = 0;
+  long next_checkpoint = checkpoint_interval;
+
   while (numFaces() > target_num_faces)
   {
-    decimateQuadricEdgeCollapse();
+    CollapseStatus status;
+    decimateQuadricEdgeCollapse(NULL, &status);
+    if (status == NO_EDGES_LEFT)
+      break;
+    else if (status == EDGE_SKIPPED)
+      continue;
+
+    // The snapshot is taken here, between collapses, but serialized and written in the background
+    ++num_collapses;
+    if (checkpoint_interval > 0 && num_collapses >= next_checkpoint && !checkpoint_writer.isBusy())
+    {
+      std::shared_ptr<Snapshot> snapshot(new Snapshot);
+      takeSnapshot(*snapshot);
+      checkpoint_writer.write(snapshot, checkpoint_path);
+      next_checkpoint = num_collapses + checkpoint_interval;
+    }
+
+    if (progress)
+      progress->update(initial_num_faces - numFaces());
 
     // This might help to debug stuff. Remember that if you messed up the mesh, this saving step can also crash.
     // save(FilePath::baseName(getName()) + format("%ld.off", numFaces()));
   }
+
+  if (progress)
+    progress->end(initial_num_faces - numFaces());
+
+  checkpoint_writer.wait();
+  if (checkpoint_writer.numFailed() > 0)
+    DGP_WARNING << getName() << ": " << checkpoint_writer.numFailed() << " checkpoint(s) could not be written";
 }
 
 void
-Mesh::draw(Graphics::RenderSystem & render_system, bool draw_edges, bool use_vertex_data, bool send_colors) const
+Mesh::decimateMultipleChoice(long target_num_faces, int num_choices, uint32 seed, ProgressReporter * progress)
 {
-  // Three separate passes over the faces is probably faster than using Primitive::POLYGON for each face
+  if (target_num_faces < 0)
+    return;
 
-  if (draw_edges)
-  {
-    render_system.pushShapeFlags();
-    render_system.setPolygonOffset(true, 1);
-  }
+  num_choices = std::max(num_choices, 1);
 
-  // First try to render as much stuff using triangles as possible
-  render_system.beginPrimitive(Graphics::RenderSystem::Primitive::TRIANGLES);
-    for (FaceConstIterator fi = facesBegin(); fi != facesEnd(); ++fi)
-      if (fi->isTriangle()) drawFace(*fi, render_system, use_vertex_data, send_colors);
-  render_system.endPrimitive();
+  // Collapse errors will change without the heap being updated, so it must be rebuilt if it is needed again
+  edge_heap.clear();
+  heap_constructed = false;
+
+  // The pool holds every edge of the mesh, found through the first endpoint (the edge list may also have edges removed by
+  // earlier collapses). Edges removed from the mesh from now on are removed from the pool too, in remove_from_heap().
+  collapse_candidates.clear();
+  for (VertexIterator vi = vertices.begin(); vi != vertices.end(); ++vi)
+    for (Vertex::EdgeIterator vei = vi->edgesBegin(); vei != vi->edgesEnd(); ++vei)
+      if ((*vei)->getEndpoint(0) == &(*vi) && !isCollapseCandidate(*vei))
+      {
+        (*vei)->candidate_index = (uint32)collapse_candidates.size();
+        collapse_candidates.push_back(*vei);
+      }
 
-  // Now render all quads
-  render_system.beginPrimitive(Graphics::RenderSystem::Primitive::QUADS);
-    for (FaceConstIterator fi = facesBegin(); fi != facesEnd(); ++fi)
-      if (fi->isQuad()) drawFace(*fi, render_system, use_vertex_data, send_colors);
-  render_system.endPrimitive();
+  long initial_num_faces = numFaces();
+  if (progress)
+    progress->begin(initial_num_faces - target_num_faces);
 
-  // Finish off with all larger polygons
-  for (FaceConstIterator fi = facesBegin(); fi != facesEnd(); ++fi)
-    if (fi->numEdges() > 4)
+  Random rng(seed, /* threadsafe = */ false);
+  BoundedSortedArray<Edge *, EdgeComp> cheapest(num_choices);
+  while (numFaces() > target_num_faces && !collapse_candidates.empty())
+  {
+    // The quadrics of the endpoints may have changed since an edge was last sampled, so its error is always recomputed
+    cheapest.clear();
+    for (int i = 0; i < num_choices && !collapse_candidates.empty(); ++i)
     {
-      render_system.beginPrimitive(Graphics::RenderSystem::Primitive::POLYGON);
-        drawFace(*fi, render_system, use_vertex_data, send_colors);
-      render_system.endPrimitive();
-    }
+      Edge * e = collapse_candidates[(size_t)rng.integer(0, (int32)collapse_candidates.size() - 1)];
+      if (e->isSelfLoop())  // can't be collapsed
+      {
+        removeCollapseCandidate(e);
+        continue;
+      }
 
-  if (draw_edges)
-    render_system.popShapeFlags();
+      e->updateQuadricCollapseError(quadric_frame);
+      cheapest.insert(e);
+    }
 
-  if (draw_edges)
-  {
-    render_system.pushShader();
-    render_system.pushColorFlags();
+    if (cheapest.isEmpty())
+      continue;
 
-      render_system.setShader(NULL);
-      render_system.setColor(ColorRGBA(0.2, 0.3, 0.7, 1));  // set default edge color
+    Edge * edge = cheapest.first();
+    Vertex * v = collapseEdge(edge);
+    if (!v)
+    {
+      // Either the collapse removed the last faces of a component, or the edge cannot be collapsed and must not be sampled
+      // again
+      removeCollapseCandidate(edge);
+      continue;
+    }
 
-      render_system.beginPrimitive(Graphics::RenderSystem::Primitive::LINES);
-        for (EdgeConstIterator ei = edgesBegin(); ei != edgesEnd(); ++ei)
-        {
-          render_system.sendVertex(ei->getEndpoint(0)->getPosition());
-          render_system.sendVertex(ei->getEndpoint(1)->getPosition());
-        }
-      render_system.endPrimitive();
+    // The edge errors are left to be recomputed when sampled
+    v->setPosition(edge->getQuadricCollapsePosition());
+    v->updateQuadric(quadric_frame);
+    for (Vertex::EdgeIterator vei = v->edgesBegin(); vei != v->edgesEnd(); ++vei)
+      (*vei)->getOtherEndpoint(v)->updateQuadric(quadric_frame);
 
-    render_system.popColorFlags();
-    render_system.popShader();
+    if (progress)
+      progress->update(initial_num_faces - numFaces());
   }
-}
 
-bool
-Mesh::loadOFF(std::string const & path)
-{
-  std::ifstream in(path.c_str());
-  if (!in)
-  {
-    DGP_ERROR << "Could not open '" << path << "' for reading";
-    return false;
-  }
+  if (progress)
+    progress->end(initial_num_faces - numFaces());
 
-  clear();
+  // The pool no longer holds self loops and edges that could not be collapsed, which are still part of the mesh, so the edges
+  // to keep are found through the vertices instead
+  std::vector<Edge *>().swap(collapse_candidates);
+  eraseRemovedEdges();
+}
 
-  std::string magic;
-  if (!(in >> magic) || magic != "OFF")
-  {
-    DGP_ERROR << "Header string OFF not found at beginning of file '" << path << '\'';
-    return false;
-  }
+namespace MeshInternal {
 
-  long nv, nf, ne;
-  if (!(in >> nv >> nf >> ne))
-  {
-    DGP_ERROR << "Could not read element counts from OFF file '" << path << '\'';
-    return false;
-  }
+// An edge waiting to be collapsed by Mesh::decimateConcurrent(), with the endpoints it had when it was queued. The endpoints
+// are locked first, after which the entry can be checked against the current state of the edge.
+struct ConcurrentCollapse
+{
+  MeshEdge * edge;
+  MeshVertex * u;
+  MeshVertex * v;
+};
 
-  if (nv < 0 || nf < 0 || ne < 0)
-  {
-    DGP_ERROR << "Negative element count in OFF file '" << path << '\'';
-    return false;
-  }
+} // namespace MeshInternal
 
-  std::vector<Vertex *> indexed_vertices;
-  Vector3 p;
-  for (long i = 0; i < nv; ++i)
-  {
-    if (!(in >> p[0] >> p[1] >> p[2]))
-    {
-      DGP_ERROR << "Could not read vertex " << indexed_vertices.size() << " from '" << path << '\'';
-      return false;
-    }
+Mesh::ConcurrentStats
+Mesh::decimateConcurrent(long target_num_faces, long num_threads, ProgressReporter * progress)
+{
+  using namespace MeshInternal;
 
-    Vertex * v = addVertex(p);
-    if (!v)
-      return false;
+  ConcurrentStats stats = { 0, 0, 0 };
+  if (target_num_faces < 0)
+    return stats;
+
+  // Collapse errors will change without the heap being updated, so it must be rebuilt if it is needed again
+  edge_heap.clear();
+  heap_constructed = false;
+
+  // Face normals are recomputed on demand, which is not threadsafe. From here on, a normal is only marked out of date by a
+  // thread that holds the locks of all the vertices of the face, and which brings it up to date again before releasing them.
+  updateNormals();
+
+  // Queue every edge of the mesh, found through its first endpoint (the edge list may also have edges removed by earlier
+  // collapses)
+  num_threads = Parallel::numThreads(numFaces(), num_threads, 1024);
+  MultiQueue<ConcurrentCollapse> queue(2 * num_threads);
+  Random queue_rng(0, /* threadsafe = */ false);
+  std::atomic<long> num_pending(0);  // entries in the queue or being processed
+  for (VertexIterator vi = vertices.begin(); vi != vertices.end(); ++vi)
+    for (Vertex::EdgeIterator vei = vi->edgesBegin(); vei != vi->edgesEnd(); ++vei)
+      if ((*vei)->getEndpoint(0) == &(*vi) && !(*vei)->isSelfLoop())
+      {
+        ConcurrentCollapse entry = { *vei, (*vei)->getEndpoint(0), (*vei)->getEndpoint(1) };
+        queue.push(entry, (*vei)->getQuadricCollapseError(), queue_rng);
+        ++num_pending;
+      }
 
-    indexed_vertices.push_back(v);
-  }
+  long initial_num_faces = numFaces();
+  if (progress)
+    progress->begin(initial_num_faces - target_num_faces);
 
-  std::vector<Vertex *> face_vertices;
-  long num_face_vertices, vertex_index;
-  for (long i = 0; i < nf; ++i)
+  DeferredRemovals removals;
+  deferred_removals = &removals;
+
+  std::atomic<long> num_collapses(0), num_conflicts(0), num_stale(0);
+  Parallel::forChunks(0, num_threads, [&](long, long, long thread_index)
   {
-    if (!(in >> num_face_vertices) || num_face_vertices < 0)
-    {
-      DGP_ERROR << "Could not read valid vertex count of face " << faces.size() << " from '" << path << '\'';
-      return false;
-    }
+    Random rng((uint32)thread_index, /* threadsafe = */ false);
+    std::vector<Vertex *> locked;
+    std::vector<Vertex *> ring;
+    auto unlockVertices = [&locked]() { for (size_t i = 0; i < locked.size(); ++i) locked[i]->collapse_lock.unlock(); };
 
-    face_vertices.resize(num_face_vertices);
-    for (size_t j = 0; j < face_vertices.size(); ++j)
+    while (initial_num_faces - removals.num_faces > target_num_faces && num_pending > 0)
     {
-      if (!(in >> vertex_index))
+      ConcurrentCollapse entry;
+      double error;
+      if (!queue.pop(entry, error, rng))  // other threads still hold entries, and may queue more
       {
-        DGP_ERROR << "Could not read vertex " << j << " of face " << faces.size() << " from '" << path << '\'';
-        return false;
+        std::this_thread::yield();
+        continue;
       }
 
-      if (vertex_index < 0 || vertex_index >= (long)vertices.size())
+      // Lock the endpoints, then make sure the entry is current: the edge must still join them and have the same error (if
+      // it was updated, a newer entry was queued for it)
+      locked.clear();
+      bool current = false;
+      if (entry.u->collapse_lock.tryLock())
       {
-        DGP_ERROR << "Out-of-bounds index " << vertex_index << " of vertex " << j << " of face " << faces.size() << " from '"
-                  << path << '\'';
-        return false;
+        locked.push_back(entry.u);
+        if (entry.v->collapse_lock.tryLock())
+        {
+          locked.push_back(entry.v);
+          current = (entry.u->hasIncidentEdge(entry.edge) && entry.edge->hasEndpoint(entry.v) && !entry.edge->isSelfLoop()
+                  && entry.edge->getQuadricCollapseError() == error);
+          if (!current)
+          {
+            unlockVertices();
+            ++num_stale;
+            --num_pending;
+            continue;
+          }
+        }
       }
 
-      face_vertices[j] = indexed_vertices[(size_t)vertex_index];
+      // Lock everything the collapse reads or writes: the vertices of all faces and edges at the endpoints. Whoever holds a
+      // vertex is then the only thread that can change its faces and edges, or move one of its neighbors.
+      if (current)
+      {
+        ring.clear();
+        for (int i = 0; i < 2; ++i)
+        {
+          Vertex * w = (i == 0 ? entry.u : entry.v);
+          for (Vertex::FaceConstIterator wfi = w->facesBegin(); wfi != w->facesEnd(); ++wfi)
+            ring.insert(ring.end(), (*wfi)->verticesBegin(), (*wfi)->verticesEnd());
+
+          for (Vertex::EdgeConstIterator wei = w->edgesBegin(); wei != w->edgesEnd(); ++wei)
+            ring.push_back((*wei)->getOtherEndpoint(w));
+        }
+
+        std::sort(ring.begin(), ring.end());
+        ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+
+        for (size_t i = 0; i < ring.size() && current; ++i)
+        {
+          if (ring[i] == entry.u || ring[i] == entry.v)
+            continue;
+
+          if (ring[i]->collapse_lock.tryLock())
+            locked.push_back(ring[i]);
+          else
+            current = false;
+        }
+      }
+
+      // Rather than wait for another thread to finish, put the edge back and try a different one
+      if (!current)
+      {
+        unlockVertices();
+        queue.push(entry, error, rng);
+        ++num_conflicts;
+        continue;
+      }
+
+      Vertex * v = collapseEdge(entry.edge);
+      if (v)
+      {
+        v->setPosition(entry.edge->getQuadricCollapsePosition());
+        v->updateQuadric(quadric_frame);  // also brings the normals of the faces of v up to date
+
+        for (Vertex::EdgeIterator vei = v->edgesBegin(); vei != v->edgesEnd(); ++vei)
+        {
+          Edge * e = *vei;
+          e->getOtherEndpoint(v)->updateQuadric(quadric_frame);
+          e->updateQuadricCollapseError(quadric_frame);
+
+          ConcurrentCollapse next = { e, e->getEndpoint(0), e->getEndpoint(1) };
+          ++num_pending;
+          queue.push(next, e->getQuadricCollapseError(), rng);
+        }
+      }
+
+      unlockVertices();
+      ++num_collapses;
+      --num_pending;
+
+      if (progress && thread_index == 0)
+        progress->update(removals.num_faces);
+    }
+  }, num_threads);
+
+  // Now that no other thread can be using them, erase the removed elements from the lists
+  eraseDeferredRemovals(removals);
+  eraseRemovedEdges();
+
+  if (progress)
+    progress->end(initial_num_faces - numFaces());
+
+  stats.num_collapses = num_collapses;
+  stats.num_conflicts = num_conflicts;
+  stats.num_stale = num_stale;
+
+  return stats;
+}
+
+namespace MeshInternal {
+
+// A node of the k-d tree that splits space into regions for Mesh::decimatePartitioned(). Leaves have a region index, other
+// nodes a splitting plane: points below it on the axis are in the first child, the others in the second.
+struct PartitionNode
+{
+  int axis;
+  Real split;
+  long children[2];
+  long region;  // -1 if not a leaf
+};
+
+// Build a k-d tree that splits the points in [begin, end) into a number of regions with about the same number of points each,
+// numbered from first_region. Each node splits its box across the longest axis. The points are reordered. Returns the index of
+// the root.
+long
+buildPartitionTree(std::vector<Vector3> & points, size_t begin, size_t end, AxisAlignedBox3 const & box, long num_regions,
+                   long first_region, std::vector<PartitionNode> & nodes)
+{
+  long index = (long)nodes.size();
+  PartitionNode leaf = { 0, 0, { -1, -1 }, first_region };
+  nodes.push_back(leaf);
+
+  if (num_regions <= 1 || end - begin < 2)
+    return index;
+
+  int axis = (int)box.getExtent().maxAxis();
+  long num_first = num_regions / 2;
+  size_t mid = begin + (size_t)((double)(end - begin) * num_first / num_regions);
+  std::nth_element(points.begin() + (long)begin, points.begin() + (long)mid, points.begin() + (long)end,
+                   [axis](Vector3 const & a, Vector3 const & b) { return a[axis] < b[axis]; });
+  Real split = points[mid][axis];
+
+  Vector3 first_high = box.getHigh(), second_low = box.getLow();
+  first_high[axis] = second_low[axis] = split;
+  long first = buildPartitionTree(points, begin, mid, AxisAlignedBox3(box.getLow(), first_high), num_first, first_region,
+                                  nodes);
+  long second = buildPartitionTree(points, mid, end, AxisAlignedBox3(second_low, box.getHigh()), num_regions - num_first,
+                                   first_region + num_first, nodes);
+
+  PartitionNode & node = nodes[(size_t)index];
+  node.axis = axis;
+  node.split = split;
+  node.children[0] = first;
+  node.children[1] = second;
+  node.region = -1;
+
+  return index;
+}
+
+// Get the centroid of a face.
+Vector3
+faceCentroid(MeshFace const * face)
+{
+  Vector3 sum = Vector3::zero();
+  for (MeshFace::VertexConstIterator fvi = face->verticesBegin(); fvi != face->verticesEnd(); ++fvi)
+    sum += (*fvi)->getPosition();
+
+  return sum / (Real)std::max(face->numVertices(), 1);
+}
+
+// Get the region of a face from the k-d tree built by buildPartitionTree(), with its root at index 0.
+long
+findPartition(std::vector<PartitionNode> const & nodes, MeshFace const * face)
+{
+  Vector3 c = faceCentroid(face);
+  size_t i = 0;
+  while (nodes[i].region < 0)
+    i = (size_t)nodes[i].children[c[nodes[i].axis] < nodes[i].split ? 0 : 1];
+
+  return nodes[i].region;
+}
+
+} // namespace MeshInternal
+
+void
+Mesh::pushLocalCollapse(std::vector<LocalCollapse> & queue, Edge * edge)
+{
+  LocalCollapse entry = { edge->getQuadricCollapseError(), edge, edge->getEndpoint(0), edge->getEndpoint(1) };
+  queue.push_back(entry);
+  std::push_heap(queue.begin(), queue.end());
+}
+
+bool
+Mesh::isCurrent(LocalCollapse const & entry)
+{
+  return entry.u->hasIncidentEdge(entry.edge) && entry.edge->hasEndpoint(entry.v) && !entry.edge->isSelfLoop()
+      && entry.edge->getQuadricCollapseError() == entry.error;
+}
+
+long
+Mesh::applyLocalCollapse(LocalCollapse const & entry, std::vector<LocalCollapse> & queue)
+{
+  // Faces of the endpoints that do not survive the collapse are the ones it removes
+  long num_endpoint_faces = entry.u->numFaces();
+  for (Vertex::FaceConstIterator vfi = entry.v->facesBegin(); vfi != entry.v->facesEnd(); ++vfi)
+    if (!(*vfi)->hasVertex(entry.u))
+      ++num_endpoint_faces;
+
+  bool collapsed = false;
+  Vertex * v = collapseEdge(entry.edge, &collapsed);
+  if (!v)
+    return (collapsed ? num_endpoint_faces : 0);  // the whole component was removed, or the edge could not be collapsed
+
+  v->setPosition(entry.edge->getQuadricCollapsePosition());
+  v->updateQuadric(quadric_frame);
+
+  for (Vertex::EdgeIterator vei = v->edgesBegin(); vei != v->edgesEnd(); ++vei)
+  {
+    Edge * e = *vei;
+    e->getOtherEndpoint(v)->updateQuadric(quadric_frame);
+    e->updateQuadricCollapseError(quadric_frame);
+    pushLocalCollapse(queue, e);
+  }
+
+  return num_endpoint_faces - v->numFaces();
+}
+
+Mesh::PartitionedStats
+Mesh::decimatePartitioned(long target_num_faces, long num_partitions, ProgressReporter * progress)
+{
+  using namespace MeshInternal;
+
+  PartitionedStats stats = { 0, 0, 0 };
+  if (target_num_faces < 0)
+    return stats;
+
+  long initial_num_faces = numFaces();
+  if (progress)
+    progress->begin(initial_num_faces - target_num_faces);
+
+  // Collapses in the regions do not update the heap, so it must be rebuilt for the final pass
+  edge_heap.clear();
+  heap_constructed = false;
+
+  num_partitions = Parallel::numThreads(initial_num_faces, num_partitions, 1024);
+  stats.num_partitions = num_partitions;
+
+  std::atomic<long> num_region_collapses(0);
+  if (num_partitions > 1 && initial_num_faces > target_num_faces)
+  {
+    // Split space into regions with about the same number of face centroids
+    std::vector<Face const *> face_list;
+    face_list.reserve(faces.size());
+    for (FaceConstIterator fi = faces.begin(); fi != faces.end(); ++fi)
+      face_list.push_back(&(*fi));
+
+    std::vector<Vector3> centroids(face_list.size());
+    Parallel::forEach(0, (long)face_list.size(), [&](long i) { centroids[(size_t)i] = faceCentroid(face_list[(size_t)i]); },
+                      Parallel::numThreads((long)face_list.size(), -1, 1024));
+
+    std::vector<PartitionNode> tree;
+    buildPartitionTree(centroids, 0, centroids.size(), getAABB(), num_partitions, 0, tree);
+    std::vector<long> region_num_faces((size_t)num_partitions, 0);
+    for (size_t i = 0; i < face_list.size(); ++i)
+      region_num_faces[(size_t)findPartition(tree, face_list[i])]++;
+
+    // A vertex belongs to a region if all its faces do, and all its edges have faces (else an edge could join it to a vertex
+    // of another region). The others lie on seams between regions, and are frozen by locking them: no region touches them or
+    // their faces, which keeps the regions from ever touching the same elements.
+    std::vector<Vertex *> vertex_list;
+    vertex_list.reserve(vertices.size());
+    for (VertexIterator vi = vertices.begin(); vi != vertices.end(); ++vi)
+      vertex_list.push_back(&(*vi));
+
+    std::vector<long> vertex_regions(vertex_list.size());
+    Parallel::forEach(0, (long)vertex_list.size(), [&](long i)
+    {
+      Vertex * vertex = vertex_list[(size_t)i];
+      long region = (vertex->numFaces() > 0 ? findPartition(tree, *vertex->facesBegin()) : -1);
+      for (Vertex::FaceConstIterator vfi = vertex->facesBegin(); vfi != vertex->facesEnd() && region >= 0; ++vfi)
+        if (findPartition(tree, *vfi) != region)
+          region = -1;
+
+      for (Vertex::EdgeConstIterator vei = vertex->edgesBegin(); vei != vertex->edgesEnd() && region >= 0; ++vei)
+        if ((*vei)->numFaces() <= 0)
+          region = -1;
+
+      vertex_regions[(size_t)i] = region;
+      if (region < 0)
+        vertex->collapse_lock.lock();
+    }, Parallel::numThreads((long)vertex_list.size(), -1, 1024));
+
+    std::vector< std::vector<Vertex *> > region_vertices((size_t)num_partitions);
+    for (size_t i = 0; i < vertex_list.size(); ++i)
+      if (vertex_regions[i] >= 0)
+        region_vertices[(size_t)vertex_regions[i]].push_back(vertex_list[i]);
+
+    // Faces and vertices are only erased from the shared lists once all regions are done
+    DeferredRemovals removals;
+    deferred_removals = &removals;
+
+    Parallel::forChunks(0, num_partitions, [&](long region, long, long)
+    {
+      // Each region only removes three quarters of its share of the faces. Regions are decimated to a face count rather than
+      // to an error, and the vertices on their borders are frozen, so finishing each region on its own would coarsen some
+      // more than others and leave their interiors coarser than their borders. The final pass takes the cheapest collapses
+      // from the whole mesh, which evens this out.
+      long region_faces = region_num_faces[(size_t)region];
+      long region_target = region_faces - 3 * (region_faces - region_faces * target_num_faces / initial_num_faces) / 4;
+
+      // Queue the edges of the region, found through their first endpoints
+      std::vector<LocalCollapse> queue;
+      std::vector<Vertex *> const & rv = region_vertices[(size_t)region];
+      for (size_t i = 0; i < rv.size(); ++i)
+        for (Vertex::EdgeIterator vei = rv[i]->edgesBegin(); vei != rv[i]->edgesEnd(); ++vei)
+        {
+          Edge * e = *vei;
+          if (e->getEndpoint(0) == rv[i] && !e->isSelfLoop() && !e->getEndpoint(1)->collapse_lock.isLocked())
+            pushLocalCollapse(queue, e);
+        }
+
+      while (region_faces > region_target && !queue.empty())
+      {
+        std::pop_heap(queue.begin(), queue.end());
+        LocalCollapse entry = queue.back();
+        queue.pop_back();
+
+        if (!isCurrent(entry))
+          continue;
+
+        // Skip collapses that would change a frozen vertex, i.e. any vertex of the faces and edges at the endpoints. The edge
+        // is left to the final pass.
+        bool frozen = false;
+        for (int i = 0; i < 2 && !frozen; ++i)
+        {
+          Vertex * w = (i == 0 ? entry.u : entry.v);
+          for (Vertex::FaceConstIterator wfi = w->facesBegin(); wfi != w->facesEnd() && !frozen; ++wfi)
+            for (Face::VertexConstIterator fvi = (*wfi)->verticesBegin(); fvi != (*wfi)->verticesEnd() && !frozen; ++fvi)
+              frozen = (*fvi)->collapse_lock.isLocked();
+
+          for (Vertex::EdgeConstIterator wei = w->edgesBegin(); wei != w->edgesEnd() && !frozen; ++wei)
+            frozen = (*wei)->getOtherEndpoint(w)->collapse_lock.isLocked();
+        }
+
+        if (frozen)
+          continue;
+
+        region_faces -= applyLocalCollapse(entry, queue);
+        ++num_region_collapses;
+
+        if (progress && region == 0)
+          progress->update(removals.num_faces);
+      }
+    }, num_partitions);
+
+    // Unfreeze the seams, and erase the elements removed in the regions so that the heap is built from the remaining ones
+    for (size_t i = 0; i < vertex_list.size(); ++i)
+      if (vertex_regions[i] < 0)
+        vertex_list[i]->collapse_lock.unlock();
+
+    eraseDeferredRemovals(removals);
+  }
+
+  // The heap is built from the edge list, which may also hold edges removed here or by earlier decimation
+  eraseRemovedEdges();
+  stats.num_region_collapses = num_region_collapses;
+
+  // Finish with the priority queue over the whole mesh, which crosses the seams. Errors of the edges that are not incident on
+  // a vertex moved in the regions are as up to date as they would be in decimateQuadricEdgeCollapse().
+  while (numFaces() > target_num_faces)
+  {
+    CollapseStatus status;
+    decimateQuadricEdgeCollapse(NULL, &status);
+    if (status == NO_EDGES_LEFT)
+      break;
+    else if (status == EDGE_SKIPPED)
+      continue;
+
+    ++stats.num_seam_collapses;
+    if (progress)
+      progress->update(initial_num_faces - numFaces());
+  }
+
+  if (progress)
+    progress->end(initial_num_faces - numFaces());
+
+  return stats;
+}
+
+long
+Mesh::findConnectedComponents(std::vector< std::vector<Vertex *> > & components, long num_threads)
+{
+  components.clear();
+
+  std::vector<Vertex *> vertex_list;
+  vertex_list.reserve(vertices.size());
+  std::unordered_map<Vertex const *, uint32> vertex_indices;
+  vertex_indices.reserve(vertices.size());
+  for (VertexIterator vi = vertices.begin(); vi != vertices.end(); ++vi)
+  {
+    vertex_indices[&(*vi)] = (uint32)vertex_list.size();
+    vertex_list.push_back(&(*vi));
+  }
+
+  // Merge the endpoints of every edge, each edge found through its first endpoint
+  UnionFind sets((long)vertex_list.size());
+  Parallel::forEach(0, (long)vertex_list.size(), [&](long i)
+  {
+    Vertex * vertex = vertex_list[(size_t)i];
+    for (Vertex::EdgeConstIterator vei = vertex->edgesBegin(); vei != vertex->edgesEnd(); ++vei)
+      if ((*vei)->getEndpoint(0) == vertex)
+        sets.unite((uint32)i, vertex_indices.find((*vei)->getEndpoint(1))->second);
+  }, Parallel::numThreads((long)vertex_list.size(), num_threads, 1024));
+
+  // The root of each set is its first vertex, so the components come out in order of their first vertex
+  std::vector<long> component_indices(vertex_list.size(), -1);
+  for (size_t i = 0; i < vertex_list.size(); ++i)
+  {
+    size_t root = sets.find((uint32)i);
+    if (component_indices[root] < 0)
+    {
+      component_indices[root] = (long)components.size();
+      components.push_back(std::vector<Vertex *>());
+    }
+
+    components[(size_t)component_indices[root]].push_back(vertex_list[i]);
+  }
+
+  std::stable_sort(components.begin(), components.end(),
+                   [](std::vector<Vertex *> const & a, std::vector<Vertex *> const & b) { return a.size() > b.size(); });
+
+  return (long)components.size();
+}
+
+Mesh::ComponentStats
+Mesh::decimateComponents(long target_num_faces, long num_threads, ProgressReporter * progress)
+{
+  return decimateScene(std::vector<Mesh *>(1, this), target_num_faces, num_threads, progress);
+}
+
+Mesh::ComponentStats
+Mesh::decimateScene(std::vector<Mesh *> const & meshes, long target_num_faces, long num_threads, ProgressReporter * progress)
+{
+  ComponentStats stats = { 0, 0, 0, 0 };
+  if (target_num_faces < 0 || meshes.empty())
+    return stats;
+
+  // The components of a mesh listed twice would be decimated by two threads at once
+  std::vector<Mesh *> sorted_meshes(meshes);
+  std::sort(sorted_meshes.begin(), sorted_meshes.end());
+  alwaysAssertM(std::adjacent_find(sorted_meshes.begin(), sorted_meshes.end()) == sorted_meshes.end(),
+                "Mesh::decimateScene: A mesh must not appear twice");
+
+  long num_meshes = (long)meshes.size();
+  long initial_num_faces = 0;
+  for (size_t i = 0; i < meshes.size(); ++i)
+    initial_num_faces += meshes[i]->numFaces();
+
+  if (progress)
+    progress->begin(initial_num_faces - target_num_faces);
+
+  // Collapse errors will change without the heaps being updated, so they must be rebuilt if they are needed again
+  for (size_t i = 0; i < meshes.size(); ++i)
+  {
+    meshes[i]->edge_heap.clear();
+    meshes[i]->heap_constructed = false;
+  }
+
+  // Find the components of several meshes at once, or of a single mesh with all threads
+  long num_mesh_threads = Parallel::numThreads(num_meshes, num_threads);
+  long threads_per_mesh = std::max((num_threads > 0 ? num_threads : System::concurrency()) / num_meshes, 1L);
+  std::vector< std::vector< std::vector<Vertex *> > > vertex_sets((size_t)num_meshes);
+  Parallel::forEach(0, num_meshes, [&](long i) { meshes[(size_t)i]->findConnectedComponents(vertex_sets[(size_t)i],
+                                                                                              threads_per_mesh); },
+                    num_mesh_threads);
+
+  // A component of one of the meshes and its private priority queue
+  struct Component
+  {
+    Mesh * mesh;
+    std::vector<Vertex *> const * vertices;
+    std::vector<LocalCollapse> queue;
+    long num_faces;  // at the start
+
+    // Drop stale entries from the top of the queue, and get the error of the cheapest edge, if any, in mesh coordinates so
+    // that it can be compared with the errors of other meshes
+    bool top(double & error)
+    {
+      while (!queue.empty() && !isCurrent(queue.front()))
+      {
+        std::pop_heap(queue.begin(), queue.end());
+        queue.pop_back();
+      }
+
+      if (queue.empty())
+        return false;
+
+      error = mesh->quadric_frame.toWorldError(queue.front().error);
+      return true;
+    }
+  };
+
+  std::vector<Component> components;
+  for (size_t i = 0; i < vertex_sets.size(); ++i)
+    for (size_t j = 0; j < vertex_sets[i].size(); ++j)
+    {
+      Component c;
+      c.mesh = meshes[i];
+      c.vertices = &vertex_sets[i][j];
+      c.num_faces = 0;
+      components.push_back(c);
+    }
+
+  // Components have very different sizes, so threads take the next one from a shared counter when they are done with one
+  num_threads = Parallel::numThreads((long)components.size(), num_threads);
+  auto forEachComponent = [&](std::function<void (Component &)> const & func)
+  {
+    std::atomic<long> next(0);
+    Parallel::forChunks(0, num_threads, [&](long, long, long)
+    {
+      for (long i = next++; i < (long)components.size(); i = next++)
+        func(components[(size_t)i]);
+    }, num_threads);
+  };
+
+  // Count the faces of each component, each face through its first vertex, and queue its edges
+  forEachComponent([&](Component & c)
+  {
+    for (size_t i = 0; i < c.vertices->size(); ++i)
+    {
+      Vertex * vertex = (*c.vertices)[i];
+      for (Vertex::FaceConstIterator vfi = vertex->facesBegin(); vfi != vertex->facesEnd(); ++vfi)
+        if (*(*vfi)->verticesBegin() == vertex)
+          ++c.num_faces;
+
+      for (Vertex::EdgeIterator vei = vertex->edgesBegin(); vei != vertex->edgesEnd(); ++vei)
+        if ((*vei)->getEndpoint(0) == vertex && !(*vei)->isSelfLoop())
+          pushLocalCollapse(c.queue, *vei);
+    }
+  });
+
+  components.erase(std::remove_if(components.begin(), components.end(), [](Component const & c) { return c.num_faces <= 0; }),
+                   components.end());
+  stats.num_components = (long)components.size();
+
+  // Faces and vertices are only erased from the shared lists of each mesh once all components are done
+  std::vector<DeferredRemovals> removals((size_t)num_meshes);
+  for (size_t i = 0; i < meshes.size(); ++i)
+    meshes[i]->deferred_removals = &removals[i];
+
+  std::atomic<long> num_removed_faces(0);
+  auto numLiveFaces = [&]() { return initial_num_faces - num_removed_faces.load(); };
+  auto collapse = [&](Component & c)
+  {
+    LocalCollapse entry = c.queue.front();
+    std::pop_heap(c.queue.begin(), c.queue.end());
+    c.queue.pop_back();
+
+    num_removed_faces += c.mesh->applyLocalCollapse(entry, c.queue);
+  };
+
+  // Rounds in parallel. A collapse of a triangle mesh typically removes two faces. Rounds stop when the remaining collapses are
+  // too few to be worth spreading over the threads, or when they stop making much progress.
+  bool all_triangles = true;
+  for (size_t i = 0; i < meshes.size(); ++i)
+    all_triangles = all_triangles && meshes[i]->triangles_only;
+
+  long faces_per_collapse = (all_triangles ? 2 : 1);
+  std::vector<double> errors;
+  while (numLiveFaces() - target_num_faces > 64 * faces_per_collapse * num_threads)
+  {
+    long num_faces_to_remove = numLiveFaces() - target_num_faces;
+
+    // Find the error threshold below which there are as many queued collapses as needed, after dropping stale entries
+    errors.clear();
+    for (size_t i = 0; i < components.size(); ++i)
+    {
+      std::vector<LocalCollapse> & queue = components[i].queue;
+      queue.erase(std::remove_if(queue.begin(), queue.end(), [](LocalCollapse const & e) { return !isCurrent(e); }),
+                  queue.end());
+      std::make_heap(queue.begin(), queue.end());
+
+      QuadricFrame const & frame = components[i].mesh->quadric_frame;
+      for (size_t j = 0; j < queue.size(); ++j)
+        errors.push_back(frame.toWorldError(queue[j].error));
+    }
+
+    if (errors.empty())
+      break;
+
+    size_t k = std::min((size_t)std::max(num_faces_to_remove / faces_per_collapse, 1L), errors.size()) - 1;
+
+    std::nth_element(errors.begin(), errors.begin() + (long)k, errors.end());
+    double threshold = errors[k];
+
+    // Take every component to the threshold, stopping early if the target is reached
+    std::atomic<long> num_round_collapses(0);
+    forEachComponent([&](Component & c)
+    {
+      double error;
+      while (numLiveFaces() > target_num_faces && c.top(error) && error <= threshold)
+      {
+        collapse(c);
+        ++num_round_collapses;
+      }
+    });
+
+    ++stats.num_rounds;
+    stats.error_threshold = std::max(stats.error_threshold, threshold);
+
+    if (progress)
+      progress->update(initial_num_faces - numLiveFaces());
+
+    if (num_round_collapses * faces_per_collapse < num_faces_to_remove / 8)
+      break;
+  }
+
+  // Finish one collapse at a time, from the component with the cheapest edge. Each component's entry in this heap holds the
+  // error of its cheapest edge when it was queued, and is refreshed if that has changed.
+  typedef std::pair<double, size_t> ComponentTop;  // (error, component), with the cheapest on top
+  std::vector<ComponentTop> tops;
+  for (size_t i = 0; i < components.size(); ++i)
+  {
+    double error;
+    if (components[i].top(error))
+      tops.push_back(ComponentTop(error, i));
+  }
+
+  std::make_heap(tops.begin(), tops.end(), std::greater<ComponentTop>());
+  while (numLiveFaces() > target_num_faces && !tops.empty())
+  {
+    std::pop_heap(tops.begin(), tops.end(), std::greater<ComponentTop>());
+    ComponentTop t = tops.back();
+    tops.pop_back();
+
+    Component & c = components[t.second];
+    double error;
+    if (!c.top(error))
+      continue;
+
+    if (error == t.first)
+    {
+      collapse(c);
+      ++stats.num_final_collapses;
+      stats.error_threshold = std::max(stats.error_threshold, error);
+
+      if (progress)
+        progress->update(initial_num_faces - numLiveFaces());
+
+      if (!c.top(error))
+        continue;
+    }
+
+    tops.push_back(ComponentTop(error, t.second));
+    std::push_heap(tops.begin(), tops.end(), std::greater<ComponentTop>());
+  }
+
+  Parallel::forEach(0, num_meshes, [&](long i)
+  {
+    meshes[(size_t)i]->eraseDeferredRemovals(removals[(size_t)i]);
+    meshes[(size_t)i]->eraseRemovedEdges();
+  }, num_mesh_threads);
+
+  if (progress)
+    progress->end(initial_num_faces - numLiveFaces());
+
+  return stats;
+}
+
+long
+Mesh::updateNormals(long num_threads) const
+{
+#if A2_MESH_ATTRIBUTES != A2_MESH_ATTRIBUTES_FULL
+  return 0;  // nothing is stored, so nothing can be out of date
+#else
+  // Face normals first, since vertex normals are computed from them
+  std::vector<Face const *> dirty_faces;
+  for (FaceConstIterator fi = faces.begin(); fi != faces.end(); ++fi)
+    if (fi->isNormalDirty())
+      dirty_faces.push_back(&(*fi));
+
+  Parallel::forEach(0, (long)dirty_faces.size(), [&](long i) { dirty_faces[(size_t)i]->recomputeNormal(); },
+                    Parallel::numThreads((long)dirty_faces.size(), num_threads, 1024));
+
+  std::vector<Vertex const *> dirty_vertices;
+  for (VertexConstIterator vi = vertices.begin(); vi != vertices.end(); ++vi)
+    if (vi->isNormalDirty())
+      dirty_vertices.push_back(&(*vi));
+
+  Parallel::forEach(0, (long)dirty_vertices.size(), [&](long i) { dirty_vertices[(size_t)i]->recomputeNormal(); },
+                    Parallel::numThreads((long)dirty_vertices.size(), num_threads, 1024));
+
+  return (long)(dirty_faces.size() + dirty_vertices.size());
+#endif
+}
+
+void
+Mesh::releaseRenderCache()
+{
+  if (render_cache.render_system)
+  {
+    render_cache.render_system->destroyVARArea(render_cache.vertex_area);
+    render_cache.render_system->destroyVARArea(render_cache.index_area);
+  }
+
+  delete render_cache.positions;
+  delete render_cache.normals;
+  delete render_cache.colors;
+  delete render_cache.tri_indices;
+  delete render_cache.edge_indices;
+
+  render_cache = RenderCache();
+}
+
+namespace MeshInternal {
+
+// Create a VAR area large enough for a number of bytes, reusing an existing area if possible.
+Graphics::VARArea *
+reserveVARArea(Graphics::RenderSystem & render_system, Graphics::VARArea * area, char const * name, long num_bytes)
+{
+  if (area && area->getCapacity() >= num_bytes)
+  {
+    area->reset();
+    return area;
+  }
+
+  render_system.destroyVARArea(area);
+
+  // Leave some room for growth so that a slightly larger mesh does not need a new area
+  return render_system.createVARArea(name, std::max(num_bytes + num_bytes / 4, 1024L),
+                                     Graphics::VARArea::Usage::WRITE_OCCASIONALLY,
+                                     /* gpu_memory = */ DGP_SUPPORTS(ARB_vertex_buffer_object));
+}
+
+// Create a VAR in an area and fill it with an array of vectors (or colors, or indices), or return null if the array is empty.
+template <typename T, typename UpdateFuncT>
+Graphics::VAR *
+createVAR(Graphics::VARArea * area, std::vector<T> const & data, UpdateFuncT update)
+{
+  if (data.empty())
+    return NULL;
+
+  Graphics::VAR * var = area->createArray((long)(data.size() * sizeof(T)));
+  (var->*update)(0, (long)data.size(), &data[0]);
+  return var;
+}
+
+// Upload the dirty items of an array to a VAR, where item i occupies elements [offset + i * item_size, offset + (i + 1) *
+// item_size). Nearby items are sent in a single update, since a few redundant elements are cheaper than many small updates.
+template <typename T, typename UpdateFuncT>
+void
+uploadDirty(Graphics::VAR * var, std::vector<T> const & data, std::vector<long> dirty, long offset, long item_size,
+            UpdateFuncT update)
+{
+  static long const MAX_GAP = 8;
+
+  if (!var || dirty.empty())
+    return;
+
+  std::sort(dirty.begin(), dirty.end());
+
+  size_t i = 0;
+  while (i < dirty.size())
+  {
+    long first = dirty[i], last = dirty[i];
+    while (++i < dirty.size() && dirty[i] - last <= MAX_GAP)
+      last = dirty[i];
+
+    long start = offset + first * item_size;
+    (var->*update)(start, (last - first + 1) * item_size, &data[(size_t)start]);
+  }
+}
+
+// Check if an edge should be drawn. Edges that are no longer part of the mesh may linger in the edge list, possibly pointing to
+// deleted vertices, so only edges whose endpoints are both current (i.e. have slots), and which are still referenced by them,
+// are drawn.
+bool
+isDrawableEdge(Mesh::Edge const * edge, std::unordered_map<Mesh::Vertex const *, uint32> const & vertex_slots)
+{
+  Mesh::Vertex const * e0 = edge->getEndpoint(0);
+  Mesh::Vertex const * e1 = edge->getEndpoint(1);
+
+  return e0 != e1
+      && vertex_slots.find(e0) != vertex_slots.end()
+      && vertex_slots.find(e1) != vertex_slots.end()
+      && e0->hasIncidentEdge(edge);
+}
+
+typedef void (Graphics::VAR::*VectorUpdate)(long, long, Vector3 const *);
+typedef void (Graphics::VAR::*ColorUpdate)(long, long, ColorRGBA const *);
+typedef void (Graphics::VAR::*IndexUpdate)(long, long, uint32 const *);
+
+} // namespace MeshInternal
+
+void
+Mesh::updateRenderCache(Graphics::RenderSystem & render_system, bool use_vertex_data, bool send_colors) const
+{
+  using namespace MeshInternal;
+
+  Graphics::VARArea * vertex_area = render_cache.vertex_area;
+  Graphics::VARArea * index_area = render_cache.index_area;
+  if (render_cache.render_system && render_cache.render_system != &render_system)
+  {
+    const_cast<Mesh *>(this)->releaseRenderCache();
+    vertex_area = index_area = NULL;
+  }
+
+  delete render_cache.positions;
+  delete render_cache.normals;
+  delete render_cache.colors;
+  delete render_cache.tri_indices;
+  delete render_cache.edge_indices;
+
+  RenderCache & rc = render_cache;
+  rc.use_vertex_data = use_vertex_data;
+  rc.send_colors = send_colors;
+
+  // Assign slots to all vertices, triangles and edges, with no free slots in between
+  rc.position_data.clear(); rc.normal_data.clear(); rc.color_data.clear();
+  rc.tri_index_data.clear(); rc.edge_index_data.clear();
+  rc.vertex_slots.clear(); rc.face_slots.clear(); rc.edge_slots.clear(); rc.next_tri_slot.clear();
+  rc.free_vertex_slots.clear(); rc.free_tri_slots.clear(); rc.free_edge_slots.clear();
+
+  rc.num_vertex_slots = 0;
+  rc.vertex_slots.reserve((size_t)numVertices());
+  for (VertexConstIterator vi = vertices.begin(); vi != vertices.end(); ++vi)
+    rc.vertex_slots[&(*vi)] = (uint32)(rc.num_vertex_slots++);
+
+  rc.num_tri_slots = 0;
+  rc.face_slots.reserve((size_t)numFaces());
+  for (FaceConstIterator fi = faces.begin(); fi != faces.end(); ++fi)
+    if (fi->numVertices() >= 3)
+      rc.num_tri_slots += (long)fi->numVertices() - 2;
+
+  rc.position_data.resize((size_t)(rc.num_vertex_slots + (use_vertex_data ? 0 : 3 * rc.num_tri_slots)));
+  rc.normal_data.resize(rc.position_data.size());
+  if (send_colors) rc.color_data.resize(rc.position_data.size());
+  if (use_vertex_data) rc.tri_index_data.resize((size_t)(3 * rc.num_tri_slots));
+  rc.next_tri_slot.resize((size_t)rc.num_tri_slots, RenderCache::NONE);
+
+  // Fill in the slots. The free lists are temporarily filled with all slots in reverse order, so that slots are handed out in
+  // sequence.
+  rc.free_tri_slots.resize((size_t)rc.num_tri_slots);
+  for (long i = 0; i < rc.num_tri_slots; ++i)
+    rc.free_tri_slots[(size_t)i] = (uint32)(rc.num_tri_slots - 1 - i);
+
+  std::vector<long> dirty;
+  for (VertexConstIterator vi = vertices.begin(); vi != vertices.end(); ++vi)
+    writeVertexSlot(&(*vi), dirty);
+
+  for (FaceConstIterator fi = faces.begin(); fi != faces.end(); ++fi)
+    writeFaceSlots(&(*fi), dirty);
+
+  rc.num_edge_slots = 0;
+  for (EdgeConstIterator ei = edges.begin(); ei != edges.end(); ++ei)
+    if (isDrawableEdge(&(*ei), rc.vertex_slots))
+      rc.num_edge_slots++;
+
+  rc.edge_index_data.resize((size_t)(2 * rc.num_edge_slots));
+  rc.free_edge_slots.resize((size_t)rc.num_edge_slots);
+  for (long i = 0; i < rc.num_edge_slots; ++i)
+    rc.free_edge_slots[(size_t)i] = (uint32)(rc.num_edge_slots - 1 - i);
+
+  for (EdgeConstIterator ei = edges.begin(); ei != edges.end(); ++ei)
+    writeEdgeSlot(&(*ei), dirty);
+
+  // Upload to the GPU
+  long vertex_bytes = (long)(rc.position_data.size() * sizeof(Vector3) + rc.normal_data.size() * sizeof(Vector3)
+                           + rc.color_data.size() * sizeof(ColorRGBA));
+  long index_bytes = (long)((rc.tri_index_data.size() + rc.edge_index_data.size()) * sizeof(uint32));
+
+  rc.render_system = &render_system;
+  rc.vertex_area = reserveVARArea(render_system, vertex_area, "Mesh vertex buffer", vertex_bytes);
+  rc.index_area = reserveVARArea(render_system, index_area, "Mesh index buffer", index_bytes);
+
+  rc.positions = createVAR(rc.vertex_area, rc.position_data, (VectorUpdate)&Graphics::VAR::updateVectors);
+  rc.normals = createVAR(rc.vertex_area, rc.normal_data, (VectorUpdate)&Graphics::VAR::updateVectors);
+  rc.colors = createVAR(rc.vertex_area, rc.color_data, (ColorUpdate)&Graphics::VAR::updateColors);
+  rc.tri_indices = createVAR(rc.index_area, rc.tri_index_data, (IndexUpdate)&Graphics::VAR::updateIndices);
+  rc.edge_indices = createVAR(rc.index_area, rc.edge_index_data, (IndexUpdate)&Graphics::VAR::updateIndices);
+
+  rc.version = edit_version;
+  rc.valid = true;
+}
+
+bool
+Mesh::writeVertexSlot(Vertex const * vertex, std::vector<long> & dirty_vertices) const
+{
+  RenderCache & rc = render_cache;
+
+  uint32 slot;
+  std::unordered_map<Vertex const *, uint32>::const_iterator existing = rc.vertex_slots.find(vertex);
+  if (existing != rc.vertex_slots.end())
+    slot = existing->second;
+  else
+  {
+    if (rc.free_vertex_slots.empty())
+      return false;
+
+    slot = rc.free_vertex_slots.back();
+    rc.free_vertex_slots.pop_back();
+    rc.vertex_slots[vertex] = slot;
+  }
+
+  rc.position_data[slot] = vertex->getPosition();
+  rc.normal_data[slot] = vertex->getNormal();
+  if (rc.send_colors) rc.color_data[slot] = vertex->getColor();
+
+  dirty_vertices.push_back((long)slot);
+  return true;
+}
+
+void
+Mesh::releaseFaceSlots(Face const * face, std::vector<long> & dirty_tris) const
+{
+  RenderCache & rc = render_cache;
+
+  std::unordered_map<Face const *, uint32>::iterator existing = rc.face_slots.find(face);
+  if (existing == rc.face_slots.end())
+    return;
+
+  for (uint32 slot = existing->second; slot != RenderCache::NONE; )
+  {
+    if (rc.use_vertex_data)
+      rc.tri_index_data[3 * slot] = rc.tri_index_data[3 * slot + 1] = rc.tri_index_data[3 * slot + 2] = 0;
+    else
+    {
+      size_t corner = (size_t)(rc.num_vertex_slots + 3 * slot);
+      rc.position_data[corner] = rc.position_data[corner + 1] = rc.position_data[corner + 2] = Vector3::zero();
+    }
+
+    dirty_tris.push_back((long)slot);
+    rc.free_tri_slots.push_back(slot);
+
+    uint32 next = rc.next_tri_slot[slot];
+    rc.next_tri_slot[slot] = RenderCache::NONE;
+    slot = next;
+  }
+
+  rc.face_slots.erase(existing);
+}
+
+bool
+Mesh::writeFaceSlots(Face const * face, std::vector<long> & dirty_tris) const
+{
+  RenderCache & rc = render_cache;
+
+  releaseFaceSlots(face, dirty_tris);
+
+  if (face->numVertices() < 3)
+    return true;
+
+  if ((long)rc.free_tri_slots.size() < (long)face->numVertices() - 2)
+    return false;
+
+  // Look up the vertex slots, which must already exist
+  face_vertices.clear();
+  for (Face::VertexConstIterator fvi = face->verticesBegin(); fvi != face->verticesEnd(); ++fvi)
+  {
+    if (rc.vertex_slots.find(*fvi) == rc.vertex_slots.end())
+      return false;
+
+    face_vertices.push_back(*fvi);
+  }
+
+  // Split the face into a fan of triangles, each in its own slot
+  uint32 prev_slot = RenderCache::NONE;
+  for (size_t i = 2; i < face_vertices.size(); ++i)
+  {
+    uint32 slot = rc.free_tri_slots.back();
+    rc.free_tri_slots.pop_back();
+
+    if (prev_slot == RenderCache::NONE)
+      rc.face_slots[face] = slot;
+    else
+      rc.next_tri_slot[prev_slot] = slot;
+
+    prev_slot = slot;
+
+    Vertex const * tri[3] = { face_vertices[0], face_vertices[i - 1], face_vertices[i] };
+    if (rc.use_vertex_data)
+    {
+      for (int k = 0; k < 3; ++k)
+        rc.tri_index_data[3 * slot + k] = rc.vertex_slots[tri[k]];
+    }
+    else
+    {
+      size_t corner = (size_t)(rc.num_vertex_slots + 3 * slot);
+      for (int k = 0; k < 3; ++k)
+      {
+        rc.position_data[corner + k] = tri[k]->getPosition();
+        rc.normal_data[corner + k] = face->getNormal();
+        if (rc.send_colors) rc.color_data[corner + k] = face->getColor();
+      }
+    }
+
+    dirty_tris.push_back((long)slot);
+  }
+
+  return true;
+}
+
+bool
+Mesh::writeEdgeSlot(Edge const * edge, std::vector<long> & dirty_edges) const
+{
+  RenderCache & rc = render_cache;
+
+  std::unordered_map<Edge const *, uint32>::iterator existing = rc.edge_slots.find(edge);
+  if (!MeshInternal::isDrawableEdge(edge, rc.vertex_slots))
+  {
+    if (existing != rc.edge_slots.end())
+    {
+      uint32 slot = existing->second;
+      rc.edge_index_data[2 * slot] = rc.edge_index_data[2 * slot + 1] = 0;
+      dirty_edges.push_back((long)slot);
+      rc.free_edge_slots.push_back(slot);
+      rc.edge_slots.erase(existing);
+    }
+
+    return true;
+  }
+
+  uint32 slot;
+  if (existing != rc.edge_slots.end())
+    slot = existing->second;
+  else
+  {
+    if (rc.free_edge_slots.empty())
+      return false;
+
+    slot = rc.free_edge_slots.back();
+    rc.free_edge_slots.pop_back();
+    rc.edge_slots[edge] = slot;
+  }
+
+  rc.edge_index_data[2 * slot] = rc.vertex_slots[edge->getEndpoint(0)];
+  rc.edge_index_data[2 * slot + 1] = rc.vertex_slots[edge->getEndpoint(1)];
+
+  dirty_edges.push_back((long)slot);
+  return true;
+}
+
+bool
+Mesh::patchRenderCache(Changes const & changes)
+{
+  using namespace MeshInternal;
+
+  RenderCache & rc = render_cache;
+
+  if (changes.isEmpty())
+    return rc.valid && rc.version == edit_version;
+
+  if (!rc.valid
+   || !changes.complete
+   || rc.version != changes.begin_version
+   || changes.end_version != edit_version)
+    return false;
+
+  // Once most triangle slots are unused, drawing the degenerate triangles left in their place costs more than a rebuild
+  if (rc.num_tri_slots >= 1024 && 2 * (long)rc.free_tri_slots.size() > rc.num_tri_slots)
+  {
+    rc.valid = false;
+    return false;
+  }
+
+  updateNormals();
+
+  std::vector<long> dirty_vertices, dirty_tris, dirty_edges;
+  bool ok = true;
+
+  // Release the slots of removed elements first, so they can be reused
+  for (std::unordered_set<Face const *>::const_iterator fi = changes.removed_faces.begin(); fi != changes.removed_faces.end();
+       ++fi)
+    releaseFaceSlots(*fi, dirty_tris);
+
+  for (std::unordered_set<Edge const *>::const_iterator ei = changes.removed_edges.begin(); ei != changes.removed_edges.end();
+       ++ei)
+  {
+    std::unordered_map<Edge const *, uint32>::iterator existing = rc.edge_slots.find(*ei);
+    if (existing != rc.edge_slots.end())
+    {
+      rc.edge_index_data[2 * existing->second] = rc.edge_index_data[2 * existing->second + 1] = 0;
+      dirty_edges.push_back((long)existing->second);
+      rc.free_edge_slots.push_back(existing->second);
+      rc.edge_slots.erase(existing);
+    }
+  }
+
+  for (std::unordered_set<Vertex const *>::const_iterator vi = changes.removed_vertices.begin();
+       vi != changes.removed_vertices.end(); ++vi)
+  {
+    std::unordered_map<Vertex const *, uint32>::iterator existing = rc.vertex_slots.find(*vi);
+    if (existing != rc.vertex_slots.end())
+    {
+      rc.free_vertex_slots.push_back(existing->second);
+      rc.vertex_slots.erase(existing);
+    }
+  }
+
+  // Rewrite the modified elements, vertices first since triangles and edges refer to their slots
+  for (std::unordered_set<Vertex const *>::const_iterator vi = changes.touched_vertices.begin();
+       ok && vi != changes.touched_vertices.end(); ++vi)
+    ok = writeVertexSlot(*vi, dirty_vertices);
+
+  for (std::unordered_set<Face const *>::const_iterator fi = changes.touched_faces.begin();
+       ok && fi != changes.touched_faces.end(); ++fi)
+    ok = writeFaceSlots(*fi, dirty_tris);
+
+  for (std::unordered_set<Edge const *>::const_iterator ei = changes.touched_edges.begin();
+       ok && ei != changes.touched_edges.end(); ++ei)
+    ok = writeEdgeSlot(*ei, dirty_edges);
+
+  if (!ok)  // out of slots, the buffers are now inconsistent
+  {
+    rc.valid = false;
+    return false;
+  }
+
+  // Send the modified ranges to the GPU
+  uploadDirty(rc.positions, rc.position_data, dirty_vertices, 0, 1, (VectorUpdate)&Graphics::VAR::updateVectors);
+  uploadDirty(rc.normals, rc.normal_data, dirty_vertices, 0, 1, (VectorUpdate)&Graphics::VAR::updateVectors);
+  uploadDirty(rc.colors, rc.color_data, dirty_vertices, 0, 1, (ColorUpdate)&Graphics::VAR::updateColors);
+
+  if (rc.use_vertex_data)
+    uploadDirty(rc.tri_indices, rc.tri_index_data, dirty_tris, 0, 3, (IndexUpdate)&Graphics::VAR::updateIndices);
+  else
+  {
+    uploadDirty(rc.positions, rc.position_data, dirty_tris, rc.num_vertex_slots, 3,
+                (VectorUpdate)&Graphics::VAR::updateVectors);
+    uploadDirty(rc.normals, rc.normal_data, dirty_tris, rc.num_vertex_slots, 3, (VectorUpdate)&Graphics::VAR::updateVectors);
+    uploadDirty(rc.colors, rc.color_data, dirty_tris, rc.num_vertex_slots, 3, (ColorUpdate)&Graphics::VAR::updateColors);
+  }
+
+  uploadDirty(rc.edge_indices, rc.edge_index_data, dirty_edges, 0, 2, (IndexUpdate)&Graphics::VAR::updateIndices);
+
+  rc.version = edit_version;
+  return true;
+}
+
+void
+Mesh::draw(Graphics::RenderSystem & render_system, bool draw_edges, bool use_vertex_data, bool send_colors) const
+{
+  send_colors = send_colors && MeshAttributes::COLORS;  // no point sending colors that are all white
+
+  // Recomputed normals mean that the geometry has changed since the buffers were built
+  if (updateNormals() > 0
+   || !render_cache.valid
+   || render_cache.version != edit_version
+   || render_cache.render_system != &render_system
+   || render_cache.use_vertex_data != use_vertex_data
+   || render_cache.send_colors != send_colors)
+  {
+    updateRenderCache(render_system, use_vertex_data, send_colors);
+  }
+
+  if (!render_cache.positions)
+    return;
+
+  if (draw_edges)
+  {
+    render_system.pushShapeFlags();
+    render_system.setPolygonOffset(true, 1);
+  }
+
+  render_system.beginIndexedPrimitives();
+
+    render_system.setVertexArray(render_cache.positions);
+    render_system.setNormalArray(render_cache.normals);
+    if (render_cache.colors) render_system.setColorArray(render_cache.colors);
+
+    if (use_vertex_data)
+    {
+      if (render_cache.tri_indices)
+      {
+        render_system.setIndexArray(render_cache.tri_indices);
+        render_system.sendIndicesFromArray(Graphics::RenderSystem::Primitive::TRIANGLES, 0, 3 * render_cache.num_tri_slots);
+      }
+    }
+    else
+      render_system.sendSequentialIndices(Graphics::RenderSystem::Primitive::TRIANGLES, (int)render_cache.num_vertex_slots,
+                                          (int)(3 * render_cache.num_tri_slots));
+
+  render_system.endIndexedPrimitives();
+
+  if (draw_edges)
+    render_system.popShapeFlags();
+
+  if (draw_edges && render_cache.edge_indices)
+  {
+    render_system.pushShader();
+    render_system.pushColorFlags();
+
+      render_system.setShader(NULL);
+      render_system.setColor(ColorRGBA(0.2, 0.3, 0.7, 1));  // set default edge color
+
+      render_system.beginIndexedPrimitives();
+        render_system.setVertexArray(render_cache.positions);
+        render_system.setIndexArray(render_cache.edge_indices);
+        render_system.sendIndicesFromArray(Graphics::RenderSystem::Primitive::LINES, 0, 2 * render_cache.num_edge_slots);
+      render_system.endIndexedPrimitives();
+
+    render_system.popColorFlags();
+    render_system.popShader();
+  }
+}
+
+bool
+Mesh::loadOFF(std::string const & path)
+{
+  std::ifstream in(path.c_str());
+  if (!in)
+  {
+    DGP_ERROR << "Could not open '" << path << "' for reading";
+    return false;
+  }
+
+  clear();
+
+  std::string magic;
+  if (!(in >> magic) || magic != "OFF")
+  {
+    DGP_ERROR << "Header string OFF not found at beginning of file '" << path << '\'';
+    return false;
+  }
+
+  long nv, nf, ne;
+  if (!(in >> nv >> nf >> ne))
+  {
+    DGP_ERROR << "Could not read element counts from OFF file '" << path << '\'';
+    return false;
+  }
+
+  if (nv < 0 || nf < 0 || ne < 0)
+  {
+    DGP_ERROR << "Negative element count in OFF file '" << path << '\'';
+    return false;
+  }
+
+  std::vector<Vertex *> indexed_vertices;
+  Vector3 p;
+  for (long i = 0; i < nv; ++i)
+  {
+    if (!(in >> p[0] >> p[1] >> p[2]))
+    {
+      DGP_ERROR << "Could not read vertex " << indexed_vertices.size() << " from '" << path << '\'';
+      return false;
+    }
+
+    Vertex * v = addVertex(p);
+    if (!v)
+      return false;
+
+    indexed_vertices.push_back(v);
+  }
+
+  std::vector<Vertex *> face_vertices;
+  long num_face_vertices, vertex_index;
+  for (long i = 0; i < nf; ++i)
+  {
+    if (!(in >> num_face_vertices) || num_face_vertices < 0)
+    {
+      DGP_ERROR << "Could not read valid vertex count of face " << faces.size() << " from '" << path << '\'';
+      return false;
+    }
+
+    face_vertices.resize(num_face_vertices);
+    for (size_t j = 0; j < face_vertices.size(); ++j)
+    {
+      if (!(in >> vertex_index))
+      {
+        DGP_ERROR << "Could not read vertex " << j << " of face " << faces.size() << " from '" << path << '\'';
+        return false;
+      }
+
+      if (vertex_index < 0 || vertex_index >= (long)vertices.size())
+      {
+        DGP_ERROR << "Out-of-bounds index " << vertex_index << " of vertex " << j << " of face " << faces.size() << " from '"
+                  << path << '\'';
+        return false;
+      }
+
+      face_vertices[j] = indexed_vertices[(size_t)vertex_index];
     }
 
     addFace(face_vertices.begin(), face_vertices.end());  // ok if this fails, just skip the face with a warning
@@ -513,8 +2094,570 @@ Mesh::saveOFF(std::string const & path) const
   return true;
 }
 
+void
+Mesh::Snapshot::clear()
+{
+  name.clear();
+  vertices.clear();
+  edges.clear();
+  faces.clear();
+  vertex_edge_offsets.clear();
+  vertex_edges.clear();
+  vertex_face_offsets.clear();
+  vertex_faces.clear();
+  edge_endpoints.clear();
+  edge_face_offsets.clear();
+  edge_faces.clear();
+  face_vertex_offsets.clear();
+  face_vertices.clear();
+  face_edge_offsets.clear();
+  face_edges.clear();
+  bounds = AxisAlignedBox3();
+  quadric_frame = QuadricFrame();
+  triangles_only = true;
+  heap_constructed = false;
+  heap_order.clear();
+}
+
+namespace MeshInternal {
+
+// Magic number and version at the start of a serialized snapshot
+uint32 const SNAPSHOT_MAGIC = 0x4b433241;  // "A2CK"
+uint32 const SNAPSHOT_VERSION = 2;  // 1 also had the table of face planes
+
+// Write an array of indices, preceded by its size.
+void
+writeIndices(BinaryOutputStream & output, std::vector<uint32> const & indices)
+{
+  output.writeInt64((int64)indices.size());
+  if (!indices.empty())
+    output.writeUInt32((int64)indices.size(), &indices[0]);
+}
+
+// Read an array of indices written by writeIndices(), checking that they are all less than a bound.
+void
+readIndices(BinaryInputStream & input, uint32 bound, std::vector<uint32> & indices)
+{
+  int64 n = input.readInt64();
+  if (n < 0 || n > input.size())
+    throw Error("Mesh::Snapshot: Invalid array size");
+
+  indices.resize((size_t)n);
+  if (n > 0)
+    input.readUInt32(n, &indices[0]);
+
+  for (size_t i = 0; i < indices.size(); ++i)
+    if (indices[i] >= bound)
+      throw Error("Mesh::Snapshot: Index out of range");
+}
+
+// Read the start of each of a sequence of lists in a concatenated array, followed by the total size, as written by
+// writeIndices(), checking that they are in order.
+void
+readOffsets(BinaryInputStream & input, size_t num_lists, std::vector<uint32> & offsets)
+{
+  readIndices(input, std::numeric_limits<uint32>::max(), offsets);
+  if (offsets.size() != num_lists + 1 || offsets[0] != 0)
+    throw Error("Mesh::Snapshot: Invalid offsets");
+
+  for (size_t i = 0; i < num_lists; ++i)
+    if (offsets[i + 1] < offsets[i])
+      throw Error("Mesh::Snapshot: Invalid offsets");
+}
+
+// Get the start of each of a sequence of lists in a concatenated array, followed by the total size.
+template <typename T, typename ListSizeFunc> void
+listOffsets(std::vector<T const *> const & elems, ListSizeFunc list_size, std::vector<uint32> & offsets)
+{
+  offsets.resize(elems.size() + 1);
+  offsets[0] = 0;
+  for (size_t i = 0; i < elems.size(); ++i)
+    offsets[i + 1] = offsets[i] + (uint32)list_size(elems[i]);
+}
+
+} // namespace MeshInternal
+
+void
+Mesh::Snapshot::serialize(BinaryOutputStream & output, Codec const & codec) const
+{
+  using namespace MeshInternal;
+
+  output.setEndianness(Endianness::LITTLE);
+
+  // Element attributes are written as stored, so they can only be read back by a build that stores the same ones
+  output.writeUInt32(SNAPSHOT_MAGIC);
+  output.writeUInt32(SNAPSHOT_VERSION);
+  output.writeUInt8((uint8)A2_MESH_ATTRIBUTES);
+  output.writeUInt8((uint8)sizeof(QuadricReal));
+
+  output.writeString(name);
+
+  output.writeInt64((int64)vertices.size());
+  for (size_t i = 0; i < vertices.size(); ++i) vertices[i].serialize(output);
+
+  output.writeInt64((int64)edges.size());
+  for (size_t i = 0; i < edges.size(); ++i) edges[i].serialize(output);
+
+  output.writeInt64((int64)faces.size());
+  for (size_t i = 0; i < faces.size(); ++i) faces[i].serialize(output);
+
+  writeIndices(output, vertex_edge_offsets);
+  writeIndices(output, vertex_edges);
+  writeIndices(output, vertex_face_offsets);
+  writeIndices(output, vertex_faces);
+  writeIndices(output, edge_endpoints);
+  writeIndices(output, edge_face_offsets);
+  writeIndices(output, edge_faces);
+  writeIndices(output, face_vertex_offsets);
+  writeIndices(output, face_vertices);
+  writeIndices(output, face_edge_offsets);
+  writeIndices(output, face_edges);
+
+  output.writeBool8(bounds.isNull());
+  output.writeVector3(bounds.getLow());
+  output.writeVector3(bounds.getHigh());
+  output.writeVector3(quadric_frame.center);
+  output.writeFloat32(quadric_frame.scale);
+  output.writeBool8(triangles_only);
+
+  output.writeBool8(heap_constructed);
+  writeIndices(output, heap_order);
+}
+
+void
+Mesh::Snapshot::deserialize(BinaryInputStream & input, Codec const & codec)
+{
+  using namespace MeshInternal;
+
+  clear();
+  input.setEndianness(Endianness::LITTLE);
+
+  if (input.readUInt32() != SNAPSHOT_MAGIC)
+    throw Error("Mesh::Snapshot: Not a mesh snapshot");
+
+  if (input.readUInt32() != SNAPSHOT_VERSION)
+    throw Error("Mesh::Snapshot: Unsupported version");
+
+  if (input.readUInt8() != (uint8)A2_MESH_ATTRIBUTES || input.readUInt8() != (uint8)sizeof(QuadricReal))
+    throw Error("Mesh::Snapshot: Saved by a build with different mesh attributes or quadric precision");
+
+  name = input.readString();
+
+  int64 n = input.readInt64();
+  if (n < 0 || n > input.size()) throw Error("Mesh::Snapshot: Invalid number of vertices");
+  vertices.resize((size_t)n);
+  for (size_t i = 0; i < vertices.size(); ++i) vertices[i].deserialize(input);
+
+  n = input.readInt64();
+  if (n < 0 || n > input.size()) throw Error("Mesh::Snapshot: Invalid number of edges");
+  edges.resize((size_t)n);
+  for (size_t i = 0; i < edges.size(); ++i) edges[i].deserialize(input);
+
+  n = input.readInt64();
+  if (n < 0 || n > input.size()) throw Error("Mesh::Snapshot: Invalid number of faces");
+  faces.resize((size_t)n);
+  for (size_t i = 0; i < faces.size(); ++i) faces[i].deserialize(input);
+
+  uint32 nv = (uint32)vertices.size(), ne = (uint32)edges.size(), nf = (uint32)faces.size();
+  readOffsets(input, vertices.size(), vertex_edge_offsets);
+  readIndices(input, ne, vertex_edges);
+  readOffsets(input, vertices.size(), vertex_face_offsets);
+  readIndices(input, nf, vertex_faces);
+  readIndices(input, nv, edge_endpoints);
+  readOffsets(input, edges.size(), edge_face_offsets);
+  readIndices(input, nf, edge_faces);
+  readOffsets(input, faces.size(), face_vertex_offsets);
+  readIndices(input, nv, face_vertices);
+  readOffsets(input, faces.size(), face_edge_offsets);
+  readIndices(input, ne, face_edges);
+
+  if (vertex_edges.size() != vertex_edge_offsets.back() || vertex_faces.size() != vertex_face_offsets.back()
+   || edge_endpoints.size() != 2 * edges.size() || edge_faces.size() != edge_face_offsets.back()
+   || face_vertices.size() != face_vertex_offsets.back() || face_edges.size() != face_edge_offsets.back())
+    throw Error("Mesh::Snapshot: Inconsistent references between elements");
+
+  bool null_bounds = input.readBool8();
+  Vector3 lo = input.readVector3();
+  Vector3 hi = input.readVector3();
+  bounds = (null_bounds ? AxisAlignedBox3() : AxisAlignedBox3(lo, hi));
+  quadric_frame.center = input.readVector3();
+  quadric_frame.scale = input.readFloat32();
+  triangles_only = input.readBool8();
+
+  heap_constructed = input.readBool8();
+  readIndices(input, ne, heap_order);
+
+  // Edges that could not be collapsed are dropped from the queue, so it may hold any subset of the edges, but each only once
+  if (!heap_constructed && !heap_order.empty())
+    throw Error("Mesh::Snapshot: Invalid priority queue");
+
+  std::vector<bool> queued(edges.size(), false);
+  for (size_t i = 0; i < heap_order.size(); ++i)
+  {
+    if (queued[heap_order[i]])
+      throw Error("Mesh::Snapshot: Invalid priority queue");
+
+    queued[heap_order[i]] = true;
+  }
+}
+
+void
+Mesh::takeSnapshot(Snapshot & snapshot, long num_threads) const
+{
+  using namespace MeshInternal;
+
+  snapshot.clear();
+  snapshot.name = getNameStr();
+
+  // Copy the elements without their references to each other, and number them
+  std::unordered_map<Vertex const *, uint32> vertex_index(vertices.size());
+  std::unordered_map<Edge const *, uint32> edge_index(edges.size());
+  std::unordered_map<Face const *, uint32> face_index(faces.size());
+  std::vector<Vertex const *> src_vertices;
+  std::vector<Edge const *> src_edges;
+  std::vector<Face const *> src_faces;
+  src_vertices.reserve(vertices.size());
+  src_edges.reserve(edges.size());
+  src_faces.reserve(faces.size());
+
+  snapshot.vertices.reserve(vertices.size());
+  for (VertexConstIterator vi = vertices.begin(); vi != vertices.end(); ++vi)
+  {
+    vertex_index[&(*vi)] = (uint32)src_vertices.size();
+    src_vertices.push_back(&(*vi));
+    snapshot.vertices.push_back(*vi);
+    snapshot.vertices.back().edges.clear();
+    snapshot.vertices.back().faces.clear();
+  }
+
+  // Edges consumed by collapses are left in the edge list, detached from the rest of the mesh and possibly referring to removed
+  // vertices, so they are recognized as edges their first endpoint doesn't know about, and are not copied (see isDrawableEdge())
+  snapshot.edges.reserve(edges.size());
+  for (EdgeConstIterator ei = edges.begin(); ei != edges.end(); ++ei)
+  {
+    Vertex const * e0 = ei->getEndpoint(0);
+    if (vertex_index.find(e0) == vertex_index.end() || !e0->hasIncidentEdge(&(*ei)))
+      continue;
+
+    edge_index[&(*ei)] = (uint32)src_edges.size();
+    src_edges.push_back(&(*ei));
+    snapshot.edges.push_back(*ei);
+    snapshot.edges.back().endpoints[0] = snapshot.edges.back().endpoints[1] = NULL;
+    snapshot.edges.back().faces.clear();
+  }
+
+  snapshot.faces.reserve(faces.size());
+  for (FaceConstIterator fi = faces.begin(); fi != faces.end(); ++fi)
+  {
+    face_index[&(*fi)] = (uint32)src_faces.size();
+    src_faces.push_back(&(*fi));
+    snapshot.faces.push_back(*fi);
+    snapshot.faces.back().vertices.clear();
+    snapshot.faces.back().edges.clear();
+  }
+
+  // Size the reference arrays, then fill them. The indices are only read, so each element can be done independently.
+  listOffsets(src_vertices, [](Vertex const * v) { return v->numEdges(); }, snapshot.vertex_edge_offsets);
+  listOffsets(src_vertices, [](Vertex const * v) { return v->numFaces(); }, snapshot.vertex_face_offsets);
+  listOffsets(src_edges, [](Edge const * e) { return e->numFaces(); }, snapshot.edge_face_offsets);
+  listOffsets(src_faces, [](Face const * f) { return f->numVertices(); }, snapshot.face_vertex_offsets);
+  listOffsets(src_faces, [](Face const * f) { return f->numEdges(); }, snapshot.face_edge_offsets);
+
+  snapshot.vertex_edges.resize(snapshot.vertex_edge_offsets.back());
+  snapshot.vertex_faces.resize(snapshot.vertex_face_offsets.back());
+  snapshot.edge_endpoints.resize(2 * src_edges.size());
+  snapshot.edge_faces.resize(snapshot.edge_face_offsets.back());
+  snapshot.face_vertices.resize(snapshot.face_vertex_offsets.back());
+  snapshot.face_edges.resize(snapshot.face_edge_offsets.back());
+
+  Parallel::forEach(0, (long)src_vertices.size(), [&](long i)
+  {
+    Vertex const * v = src_vertices[(size_t)i];
+    uint32 * out = &snapshot.vertex_edges[0] + snapshot.vertex_edge_offsets[(size_t)i];
+    for (Vertex::EdgeConstIterator vei = v->edgesBegin(); vei != v->edgesEnd(); ++vei) *(out++) = edge_index.find(*vei)->second;
+
+    out = &snapshot.vertex_faces[0] + snapshot.vertex_face_offsets[(size_t)i];
+    for (Vertex::FaceConstIterator vfi = v->facesBegin(); vfi != v->facesEnd(); ++vfi) *(out++) = face_index.find(*vfi)->second;
+  }, Parallel::numThreads((long)src_vertices.size(), num_threads, 1024));
+
+  Parallel::forEach(0, (long)src_edges.size(), [&](long i)
+  {
+    Edge const * e = src_edges[(size_t)i];
+    for (int j = 0; j < 2; ++j) snapshot.edge_endpoints[(size_t)(2 * i + j)] = vertex_index.find(e->getEndpoint(j))->second;
+
+    uint32 * out = &snapshot.edge_faces[0] + snapshot.edge_face_offsets[(size_t)i];
+    for (Edge::FaceConstIterator efi = e->facesBegin(); efi != e->facesEnd(); ++efi) *(out++) = face_index.find(*efi)->second;
+  }, Parallel::numThreads((long)src_edges.size(), num_threads, 1024));
+
+  Parallel::forEach(0, (long)src_faces.size(), [&](long i)
+  {
+    Face const * f = src_faces[(size_t)i];
+    uint32 * out = &snapshot.face_vertices[0] + snapshot.face_vertex_offsets[(size_t)i];
+    for (Face::VertexConstIterator fvi = f->verticesBegin(); fvi != f->verticesEnd(); ++fvi)
+      *(out++) = vertex_index.find(*fvi)->second;
+
+    out = &snapshot.face_edges[0] + snapshot.face_edge_offsets[(size_t)i];
+    for (Face::EdgeConstIterator fei = f->edgesBegin(); fei != f->edgesEnd(); ++fei) *(out++) = edge_index.find(*fei)->second;
+  }, Parallel::numThreads((long)src_faces.size(), num_threads, 1024));
+
+  snapshot.bounds = bounds;
+  snapshot.quadric_frame = quadric_frame;
+  snapshot.triangles_only = triangles_only;
+
+  // Ties between equal errors are broken by the order of the queue, so it is recorded exactly
+  snapshot.heap_constructed = heap_constructed;
+  if (heap_constructed)
+  {
+    snapshot.heap_order.reserve(edge_heap.size());
+    for (auto ei = edge_heap.begin(); ei != edge_heap.end(); ++ei)
+      snapshot.heap_order.push_back(edge_index.find(*ei)->second);
+  }
+}
+
+void
+Mesh::restoreSnapshot(Snapshot const & snapshot, long num_threads)
+{
+  clear();
+  setName(snapshot.name);
+
+  // Copy the elements, and note where each one went
+  std::vector<Vertex *> new_vertices(snapshot.vertices.size());
+  std::vector<Edge *> new_edges(snapshot.edges.size());
+  std::vector<Face *> new_faces(snapshot.faces.size());
+
+  vertex_locations.reserve(new_vertices.size());
+  for (size_t i = 0; i < new_vertices.size(); ++i)
+  {
+    VertexIterator loc = vertices.insert(vertices.end(), snapshot.vertices[i]);
+    vertex_locations[&(*loc)] = loc;
+    new_vertices[i] = &(*loc);
+  }
+
+  for (size_t i = 0; i < new_edges.size(); ++i)
+  {
+    edges.push_back(snapshot.edges[i]);
+    new_edges[i] = &edges.back();
+  }
+
+  face_locations.reserve(new_faces.size());
+  for (size_t i = 0; i < new_faces.size(); ++i)
+  {
+    FaceIterator loc = faces.insert(faces.end(), snapshot.faces[i]);
+    face_locations[&(*loc)] = loc;
+    new_faces[i] = &(*loc);
+  }
+
+  // Link the elements to each other. Each element only changes itself, so this is done in parallel.
+  Parallel::forEach(0, (long)new_vertices.size(), [&](long i)
+  {
+    Vertex * v = new_vertices[(size_t)i];
+    for (uint32 j = snapshot.vertex_edge_offsets[(size_t)i]; j < snapshot.vertex_edge_offsets[(size_t)i + 1]; ++j)
+      v->addEdge(new_edges[snapshot.vertex_edges[j]]);
+
+    for (uint32 j = snapshot.vertex_face_offsets[(size_t)i]; j < snapshot.vertex_face_offsets[(size_t)i + 1]; ++j)
+      v->faces.push_back(new_faces[snapshot.vertex_faces[j]]);  // not addFace(), which would mark the normal as stale
+  }, Parallel::numThreads((long)new_vertices.size(), num_threads, 1024));
+
+  Parallel::forEach(0, (long)new_edges.size(), [&](long i)
+  {
+    Edge * e = new_edges[(size_t)i];
+    for (int j = 0; j < 2; ++j) e->setEndpoint(j, new_vertices[snapshot.edge_endpoints[(size_t)(2 * i + j)]]);
+
+    for (uint32 j = snapshot.edge_face_offsets[(size_t)i]; j < snapshot.edge_face_offsets[(size_t)i + 1]; ++j)
+      e->addFace(new_faces[snapshot.edge_faces[j]]);
+  }, Parallel::numThreads((long)new_edges.size(), num_threads, 1024));
+
+  Parallel::forEach(0, (long)new_faces.size(), [&](long i)
+  {
+    Face * f = new_faces[(size_t)i];
+    for (uint32 j = snapshot.face_vertex_offsets[(size_t)i]; j < snapshot.face_vertex_offsets[(size_t)i + 1]; ++j)
+      f->addVertex(new_vertices[snapshot.face_vertices[j]]);
+
+    for (uint32 j = snapshot.face_edge_offsets[(size_t)i]; j < snapshot.face_edge_offsets[(size_t)i + 1]; ++j)
+      f->addEdge(new_edges[snapshot.face_edges[j]]);
+  }, Parallel::numThreads((long)new_faces.size(), num_threads, 1024));
+
+  bounds = snapshot.bounds;
+  quadric_frame = snapshot.quadric_frame;
+  triangles_only = snapshot.triangles_only;
+
+  // Inserting in queue order puts each edge after the equal ones before it, which reproduces the order exactly
+  heap_constructed = snapshot.heap_constructed;
+  for (size_t i = 0; i < snapshot.heap_order.size(); ++i)
+    insert_into_heap(edge_heap, new_edges[snapshot.heap_order[i]]);
+}
+
+bool
+Mesh::saveCheckpoint(std::string const & path) const
+{
+  Snapshot snapshot;
+  takeSnapshot(snapshot);
+  return CheckpointWriter::writeFile(snapshot, path);
+}
+
+bool
+Mesh::loadCheckpoint(std::string const & path)
+{
+  clear();
+
+  Snapshot snapshot;
+  try
+  {
+    BinaryInputStream in(path, Endianness::LITTLE);
+    snapshot.deserialize(in);
+  }
+  DGP_STANDARD_CATCH_BLOCKS(return false;, ERROR, "Could not read checkpoint '%s'", path.c_str())
+
+  restoreSnapshot(snapshot);
+  return true;
+}
+
+void
+Mesh::copyTo(Mesh & dst, long num_threads) const
+{
+  if (&dst == this)
+    return;
+
+  Snapshot snapshot;
+  takeSnapshot(snapshot, num_threads);
+  dst.restoreSnapshot(snapshot, num_threads);
+}
+
+namespace MeshInternal {
+
+// Split a polygon into triangles by ear clipping, as indices into its vertex list. Returns false if the polygon is not simple
+// (once projected onto its plane), in which case ear clipping cannot complete.
+bool
+earClip(std::vector<Vector3> const & polygon, std::vector<long> & tris)
+{
+  Polygon3 poly;
+  for (size_t i = 0; i < polygon.size(); ++i)
+    poly.addVertex(polygon[i], (long)i);
+
+  return poly.triangulate(tris) == (long)polygon.size() - 2;
+}
+
+// Split a polygon into triangles by constrained Delaunay triangulation of its projection onto the plane with a given normal,
+// with the boundary as constraints and no added vertices. Returns false if the triangulation needs vertices other than those of
+// the polygon (e.g. because the boundary crosses itself). The Triangle library keeps global state, so calls are serialized.
+bool
+constrainedDelaunay(std::vector<Vector3> const & polygon, Vector3 const & normal, std::vector<long> & tris)
+{
+  static std::mutex triangle_mutex;
+
+  Vector3 axis0, axis1;
+  normal.createOrthonormalBasis(axis0, axis1);
+
+  Polygon2 poly;
+  std::vector<Vector2> proj(polygon.size());
+  for (size_t i = 0; i < polygon.size(); ++i)
+  {
+    proj[i] = Vector2((polygon[i] - polygon[0]).dot(axis0), (polygon[i] - polygon[0]).dot(axis1));
+    poly.addVertex(proj[i], (long)i);
+  }
+
+  Polygon2::TriangulationOptions options;
+  options.max_steiner_points = 0;
+
+  std::vector<Vector2> tri_verts;
+  {
+    std::lock_guard<std::mutex> lock(triangle_mutex);
+    poly.triangulateInterior(tri_verts, tris, NULL, options);
+  }
+
+  if (tris.size() != 3 * (polygon.size() - 2))
+    return false;
+
+  // Map output vertices back to the polygon. Triangle may have renumbered them, but it copies coordinates exactly.
+  std::vector<long> index(tri_verts.size(), -1);
+  for (size_t i = 0; i < tri_verts.size(); ++i)
+  {
+    for (size_t j = 0; j < proj.size() && index[i] < 0; ++j)
+      if (tri_verts[i] == proj[j])
+        index[i] = (long)j;
+
+    if (index[i] < 0)
+      return false;
+  }
+
+  for (size_t i = 0; i < tris.size(); ++i)
+    tris[i] = index[(size_t)tris[i]];
+
+  return true;
+}
+
+} // namespace MeshInternal
+
+long
+Mesh::triangulate(long num_threads)
+{
+  using namespace MeshInternal;
+
+  std::vector<Face *> polygons;
+  for (FaceIterator fi = faces.begin(); fi != faces.end(); ++fi)
+    if (fi->numVertices() > 3)
+      polygons.push_back(&(*fi));
+
+  // Triangulate each face independently, as indices into its vertex list
+  std::vector< std::vector<long> > face_tris(polygons.size());
+  Parallel::forEach(0, (long)polygons.size(), [&](long i)
+  {
+    Face const * face = polygons[(size_t)i];
+    std::vector<long> & tris = face_tris[(size_t)i];
+
+    std::vector<Vector3> polygon;
+    for (Face::VertexConstIterator fvi = face->verticesBegin(); fvi != face->verticesEnd(); ++fvi)
+      polygon.push_back((*fvi)->getPosition());
+
+    Vector3 normal = face->computeNormal();
+    if (!earClip(polygon, tris) && !constrainedDelaunay(polygon, normal, tris))
+    {
+      // Fall back to a fan, which at least covers the polygon
+      tris.clear();
+      for (size_t j = 2; j < polygon.size(); ++j)
+      {
+        tris.push_back(0);
+        tris.push_back((long)j - 1);
+        tris.push_back((long)j);
+      }
+    }
+
+    // Keep the winding of the face
+    for (size_t j = 0; j < tris.size(); j += 3)
+    {
+      Vector3 const & p0 = polygon[(size_t)tris[j]];
+      Vector3 const & p1 = polygon[(size_t)tris[j + 1]];
+      Vector3 const & p2 = polygon[(size_t)tris[j + 2]];
+      if ((p2 - p1).cross(p0 - p1).dot(normal) < 0)
+        std::swap(tris[j + 1], tris[j + 2]);
+    }
+  }, Parallel::numThreads((long)polygons.size(), num_threads, 256));
+
+  // Replace the faces. This edits the mesh, so it is done serially. The edges of each face are reused by its triangles.
+  std::vector<Vertex *> face_verts;
+  Vertex * tri[3];
+  for (size_t i = 0; i < polygons.size(); ++i)
+  {
+    face_verts.assign(polygons[i]->verticesBegin(), polygons[i]->verticesEnd());
+    removeFace(polygons[i]);
+
+    std::vector<long> const & tris = face_tris[i];
+    for (size_t j = 0; j < tris.size(); j += 3)
+    {
+      for (int k = 0; k < 3; ++k)
+        tri[k] = face_verts[(size_t)tris[j + k]];
+
+      addFace(tri, tri + 3);
+    }
+  }
+
+  updateTriangleFlag();
+
+  return (long)polygons.size();
+}
+
 bool
-Mesh::load(std::string const & path)
+Mesh::load(std::string const & path, bool triangulate_polygons)
 {
   std::string path_lc = toLower(path);
   bool status = false;
@@ -527,16 +2670,49 @@ Mesh::load(std::string const & path)
 
   if (status)
   {
-    for (VertexIterator vi = vertices.begin(); vi != vertices.end(); ++vi)
-      vi->updateQuadric();
+    if (triangulate_polygons)
+      triangulate();
 
-    for (EdgeIterator ei = edges.begin(); ei != edges.end(); ++ei)
-      ei->updateQuadricCollapseError();
+    updateQuadrics();
   }
 
   return status;
 }
 
+void
+Mesh::updateQuadrics(long num_threads)
+{
+  // Edges left in the list by earlier collapses may refer to vertices that no longer exist
+  eraseRemovedEdges();
+
+  quadric_frame = QuadricFrame::forBounds(bounds);
+
+  std::vector<Vertex *> vertex_list;
+  vertex_list.reserve(vertices.size());
+  for (VertexIterator vi = vertices.begin(); vi != vertices.end(); ++vi)
+    vertex_list.push_back(&(*vi));
+
+  // The planes of the faces around each vertex are computed in one vectorized pass. Each vertex then sums its own consecutive
+  // rows of the table, so faces are not visited again, and vertices and edges can be processed in parallel.
+  FacePlanes face_planes;
+  face_planes.compute(vertex_list, quadric_frame, num_threads);
+
+  Parallel::forEach(0, (long)vertex_list.size(), [&](long i) { vertex_list[(size_t)i]->updateQuadric(face_planes, i); },
+                    Parallel::numThreads((long)vertex_list.size(), num_threads, 1024));
+
+  std::vector<Edge *> edge_list;
+  edge_list.reserve(edges.size());
+  for (EdgeIterator ei = edges.begin(); ei != edges.end(); ++ei)
+    edge_list.push_back(&(*ei));
+
+  Parallel::forEach(0, (long)edge_list.size(), [&](long i) { edge_list[(size_t)i]->updateQuadricCollapseError(quadric_frame); },
+                    Parallel::numThreads((long)edge_list.size(), num_threads, 1024));
+
+  // Any existing ordering of edges by collapse error is out of date
+  edge_heap.clear();
+  heap_constructed = false;
+}
+
 bool
 Mesh::save(std::string const & path) const
 {
@@ -7,12 +7,20 @@
 #include "DGP/Colors.hpp"
 #include "DGP/NamedObject.hpp"
 #include "DGP/Noncopyable.hpp"
+#include "DGP/ProgressReporter.hpp"
+#include "DGP/Serializable.hpp"
 #include "DGP/Vector3.hpp"
 #include "MeshFace.hpp"
 #include "MeshVertex.hpp"
 #include "MeshEdge.hpp"
+#include "FacePlanes.hpp"
+#include "QuadricFrame.hpp"
+#include <atomic>
+#include <functional>
 #include <list>
 #include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <set>
 
@@ -37,8 +45,160 @@ class Mesh : public virtual NamedObject, private Noncopyable
     typedef typename FaceList::iterator          FaceIterator;         ///< Iterator over faces.
     typedef typename FaceList::const_iterator    FaceConstIterator;    ///< Const iterator over faces.
 
+    /**
+     * The elements affected by a sequence of edits, recorded by the decimator so that data derived from the mesh (such as the
+     * GPU buffers used by draw()) can be updated incrementally instead of being rebuilt. Touched elements are still part of the
+     * mesh and have been modified (or added). Removed elements are no longer part of the mesh: pointers to them serve only as
+     * identifiers and must not be dereferenced.
+     */
+    struct Changes
+    {
+      /** Constructor. */
+      Changes() { clear(); }
+
+      /** Forget all recorded changes. */
+      void clear()
+      {
+        touched_vertices.clear(); removed_vertices.clear();
+        touched_edges.clear();    removed_edges.clear();
+        touched_faces.clear();    removed_faces.clear();
+        num_edits = 0;
+        begin_version = end_version = 0;
+        complete = true;
+      }
+
+      /** Check if no changes have been recorded. */
+      bool isEmpty() const { return num_edits <= 0; }
+
+      /** Record that a vertex was modified or added. */
+      void touch(Vertex const * vertex) { touched_vertices.insert(vertex); }
+
+      /** Record that an edge was modified or added. */
+      void touch(Edge const * edge) { touched_edges.insert(edge); }
+
+      /** Record that a face was modified or added. */
+      void touch(Face const * face) { touched_faces.insert(face); }
+
+      /** Record that a vertex was removed. */
+      void remove(Vertex const * vertex) { touched_vertices.erase(vertex); removed_vertices.insert(vertex); }
+
+      /** Record that an edge was removed. */
+      void remove(Edge const * edge) { touched_edges.erase(edge); removed_edges.insert(edge); }
+
+      /** Record that a face was removed. */
+      void remove(Face const * face) { touched_faces.erase(face); removed_faces.insert(face); }
+
+      std::unordered_set<Vertex const *> touched_vertices;  ///< Vertices that were modified or added.
+      std::unordered_set<Vertex const *> removed_vertices;  ///< Vertices that were removed.
+      std::unordered_set<Edge const *> touched_edges;       ///< Edges that were modified or added.
+      std::unordered_set<Edge const *> removed_edges;       ///< Edges that were removed.
+      std::unordered_set<Face const *> touched_faces;       ///< Faces that were modified or added.
+      std::unordered_set<Face const *> removed_faces;       ///< Faces that were removed.
+
+      long num_edits;        ///< Number of recorded edits (e.g. edge collapses).
+      uint64 begin_version;  ///< Version of the mesh before the first recorded edit.
+      uint64 end_version;    ///< Version of the mesh after the last recorded edit.
+      bool complete;         ///< False if the mesh was also edited without recording, between recorded edits.
+    };
+
+    /**
+     * A compact copy of a mesh, made by takeSnapshot() and turned back into a mesh by restoreSnapshot(). Elements are stored in
+     * arrays, in the order of the mesh, and refer to each other by index rather than by pointer, so that a mesh can be rebuilt
+     * from a snapshot with no lookups, and a snapshot can itself be copied like any value. Edges left over from collapses, which
+     * are no longer part of the mesh, are not included.
+     *
+     * The snapshot also records the order of the edges in the priority queue of decimateQuadricEdgeCollapse(), so that a mesh
+     * restored in the middle of decimation continues exactly as the original would have. Snapshots are serialized in binary
+     * form as decimation checkpoints (see saveCheckpoint()), which can only be read by builds with the same element attributes
+     * and quadric precision.
+     */
+    class Snapshot : public Serializable
+    {
+      public:
+        /** Constructor. */
+        Snapshot() : triangles_only(true), heap_constructed(false) {}
+
+        /** Clear all data. */
+        void clear();
+
+        void serialize(BinaryOutputStream & output, Codec const & codec = Codec_AUTO()) const;
+
+        void deserialize(BinaryInputStream & input, Codec const & codec = Codec_AUTO());
+
+        /** Get the number of vertices. */
+        long numVertices() const { return (long)vertices.size(); }
+
+        /** Get the number of edges. */
+        long numEdges() const { return (long)edges.size(); }
+
+        /** Get the number of faces. */
+        long numFaces() const { return (long)faces.size(); }
+
+      private:
+        friend class Mesh;
+
+        std::string name;                          ///< Name of the mesh.
+        std::vector<Vertex> vertices;              ///< Vertices, without references to edges and faces.
+        std::vector<Edge> edges;                   ///< Edges, without references to endpoints and faces.
+        std::vector<Face> faces;                   ///< Faces, without references to vertices and edges.
+        std::vector<uint32> vertex_edge_offsets;   ///< Start of the edges of each vertex in vertex_edges, and the total.
+        std::vector<uint32> vertex_edges;          ///< Indices of the edges of all vertices.
+        std::vector<uint32> vertex_face_offsets;   ///< Start of the faces of each vertex in vertex_faces, and the total.
+        std::vector<uint32> vertex_faces;          ///< Indices of the faces of all vertices.
+        std::vector<uint32> edge_endpoints;        ///< Indices of the two endpoints of each edge.
+        std::vector<uint32> edge_face_offsets;     ///< Start of the faces of each edge in edge_faces, and the total.
+        std::vector<uint32> edge_faces;            ///< Indices of the faces of all edges.
+        std::vector<uint32> face_vertex_offsets;   ///< Start of the vertices of each face in face_vertices, and the total.
+        std::vector<uint32> face_vertices;         ///< Indices of the vertices of all faces.
+        std::vector<uint32> face_edge_offsets;     ///< Start of the edges of each face in face_edges, and the total.
+        std::vector<uint32> face_edges;            ///< Indices of the edges of all faces.
+        AxisAlignedBox3 bounds;                    ///< Mesh bounding box.
+        QuadricFrame quadric_frame;                ///< Frame in which quadrics are computed.
+        bool triangles_only;                       ///< Is every face a proper triangle?
+        bool heap_constructed;                     ///< Had decimation built its priority queue?
+        std::vector<uint32> heap_order;            ///< Indices of queued edges (not skipped ones), in queue order.
+    };
+
+    /** Outcome of a single step of decimateQuadricEdgeCollapse(). */
+    enum CollapseStatus
+    {
+      EDGE_COLLAPSED,     ///< The cheapest edge was collapsed, and its retained endpoint returned.
+      COMPONENT_REMOVED,  ///< The cheapest edge was collapsed, removing the last faces and all vertices of its component.
+      EDGE_SKIPPED,       ///< The cheapest edge could not be collapsed, and was dropped from the priority queue.
+      NO_EDGES_LEFT       ///< The priority queue was empty, so nothing was done.
+    };
+
+    /** Statistics of a run of decimateConcurrent(). */
+    struct ConcurrentStats
+    {
+      long num_collapses;  ///< Number of edges collapsed.
+      long num_conflicts;  ///< Number of edges put back because another thread held a lock on their neighborhood.
+      long num_stale;      ///< Number of queue entries dropped because their edge had been removed or changed.
+    };
+
+    /** Statistics of a run of decimatePartitioned(). */
+    struct PartitionedStats
+    {
+      long num_partitions;        ///< Number of regions the mesh was split into.
+      long num_region_collapses;  ///< Number of edges collapsed inside the regions, in parallel.
+      long num_seam_collapses;    ///< Number of edges collapsed by the final pass, which also crosses region borders.
+    };
+
+    /** Statistics of a run of decimateComponents() or decimateScene(). */
+    struct ComponentStats
+    {
+      long num_components;        ///< Number of connected components with faces, over all meshes.
+      long num_rounds;            ///< Number of rounds in which all components were decimated in parallel.
+      long num_final_collapses;   ///< Number of edges collapsed one at a time, from the cheapest component, after the rounds.
+      double error_threshold;     ///< Largest collapse error reached, in mesh coordinates. About the same for all components.
+    };
+
     /** Constructor. */
-    Mesh(std::string const & name = "AnonymousMesh") : NamedObject(name) {}
+    Mesh(std::string const & name = "AnonymousMesh")
+    : NamedObject(name), triangles_only(true), edit_version(0), change_log(NULL), deferred_removals(NULL) {}
+
+    /** Destructor. Releases any GPU buffers created by draw(). */
+    ~Mesh() { releaseRenderCache(); }
 
     /** Get an iterator pointing to the first vertex. */
     VertexConstIterator verticesBegin() const { return vertices.begin(); }
@@ -82,9 +242,85 @@ class Mesh : public virtual NamedObject, private Noncopyable
       vertices.clear();
       edges.clear();
       faces.clear();
+      vertex_locations.clear();
+      face_locations.clear();
+      edge_heap.clear();
+      heap_constructed = false;
+      next_heap_sequence = 0;
+      collapse_candidates.clear();
       bounds = AxisAlignedBox3();
+      quadric_frame = QuadricFrame();
+      triangles_only = true;
+      invalidateRenderCache();
     }
 
+    /**
+     * Record the contents of the mesh in a snapshot, including vertex quadrics and edge collapse errors. The mesh can then be
+     * recreated from the snapshot any number of times with restoreSnapshot(), without reloading or reinitializing it.
+     *
+     * @param snapshot Used to return the snapshot.
+     * @param num_threads The number of threads to use. If non-positive, all available hardware threads are used.
+     */
+    void takeSnapshot(Snapshot & snapshot, long num_threads = -1) const;
+
+    /**
+     * Replace the contents of the mesh with those recorded in a snapshot. The snapshot is only read, so several meshes can be
+     * restored from the same snapshot at once (e.g. on different threads) and then decimated independently.
+     *
+     * @param snapshot The snapshot to restore.
+     * @param num_threads The number of threads to use. If non-positive, all available hardware threads are used.
+     */
+    void restoreSnapshot(Snapshot const & snapshot, long num_threads = -1);
+
+    /**
+     * Replace the contents of another mesh with a copy of this one, including vertex quadrics and edge collapse errors, so that
+     * the copy can be decimated independently. This takes a snapshot and restores it: to make several copies, take a snapshot
+     * once instead. GPU buffers and change logs are not copied.
+     *
+     * @param dst The mesh to copy to.
+     * @param num_threads The number of threads to use. If non-positive, all available hardware threads are used.
+     */
+    void copyTo(Mesh & dst, long num_threads = -1) const;
+
+    /**
+     * Save the full state of the mesh, including the progress of decimation, to a checkpoint file. Decimation can then be
+     * resumed with loadCheckpoint(), with the same result as if it had not been interrupted. The checkpoint is written to a
+     * temporary file first, which then replaces any existing file at the path, so the path always holds a complete checkpoint.
+     *
+     * @return True on success, false on error.
+     */
+    bool saveCheckpoint(std::string const & path) const;
+
+    /**
+     * Replace the contents of the mesh with a checkpoint saved by saveCheckpoint() or decimateQuadricEdgeCollapse().
+     *
+     * @return True on success, false on error, in which case the mesh is left empty.
+     */
+    bool loadCheckpoint(std::string const & path);
+
+    /**
+     * Check if every face of the mesh is a triangle with three distinct vertices. Such meshes are edited with routines that
+     * assume triangles, which are faster than the general ones. Adding a single face that is not a proper triangle turns this
+     * off until the mesh is cleared (or until updateTriangleFlag() is called, after the face has been removed).
+     */
+    bool isTriangleMesh() const { return triangles_only; }
+
+    /** Recheck whether every face of the mesh is a proper triangle (see isTriangleMesh()). */
+    void updateTriangleFlag();
+
+    /**
+     * Split every face with more than three vertices into triangles, without adding vertices. Simple polygons are split by ear
+     * clipping. Faces for which that fails, e.g. because they are not simple when projected onto their plane, get a constrained
+     * Delaunay triangulation instead, or a fan if that fails too. Faces are triangulated in parallel, and then replaced by their
+     * triangles. Triangles are added at the end of the face list. Quadrics are not updated. If every face is now a proper
+     * triangle, the mesh is edited by the routines for triangle meshes from now on (see isTriangleMesh()).
+     *
+     * @param num_threads The number of threads to use. If non-positive, all available hardware threads are used.
+     *
+     * @return The number of faces split.
+     */
+    long triangulate(long num_threads = -1);
+
     /** True if and only if the mesh contains no objects. */
     bool isEmpty() const { return vertices.empty() && faces.empty() && edges.empty(); }
 
@@ -97,6 +333,12 @@ class Mesh : public virtual NamedObject, private Noncopyable
     /** Get the number of faces. */
     long numFaces() const { return (long)faces.size(); };
 
+    /** Get the number of edges in the priority queue used by decimateQuadricEdgeCollapse(). */
+    long edgeHeapSize() const { return (long)edge_heap.size(); }
+
+    /** Get the number of triangles sent to the GPU by the last call to draw(), including degenerate triangles in free slots. */
+    long numDrawnTriangles() const { return render_cache.num_tri_slots; }
+
     /**
      * Add a vertex to the mesh, with a given location.
      *
@@ -105,10 +347,14 @@ class Mesh : public virtual NamedObject, private Noncopyable
     Vertex * addVertex(Vector3 const & point)
     {
       vertices.push_back(Vertex(point));
+      vertex_locations[&vertices.back()] = --vertices.end();
       bounds.merge(point);
+      invalidateRenderCache();
       return &vertices.back();
     }
 
+#if A2_MESH_ATTRIBUTES == A2_MESH_ATTRIBUTES_FULL
+
     /**
      * Add a vertex to the mesh, with precomputed normal and color.
      *
@@ -117,10 +363,14 @@ class Mesh : public virtual NamedObject, private Noncopyable
     Vertex * addVertex(Vector3 const & point, Vector3 const & normal, ColorRGBA const & color = ColorRGBA(1, 1, 1, 1))
     {
       vertices.push_back(Vertex(point, normal, color));
+      vertex_locations[&vertices.back()] = --vertices.end();
       bounds.merge(point);
+      invalidateRenderCache();
       return &vertices.back();
     }
 
+#endif
+
     /**
      * Add a face to the mesh, specified by the sequence of vertices obtained by dereferencing [vbegin, vend).
      * VertexInputIterator must dereference to a pointer to a Vertex. Unless the mesh is already in an inconsistent state,
@@ -149,6 +399,7 @@ class Mesh : public virtual NamedObject, private Noncopyable
       // Create the (initially empty) face
       faces.push_back(Face());
       Face * face = &(*faces.rbegin());
+      face_locations[face] = --faces.end();
 
       // Add the loop of vertices to the face
       VertexInputIterator next = vbegin;
@@ -157,7 +408,7 @@ class Mesh : public virtual NamedObject, private Noncopyable
         if (next == vend) next = vbegin;
 
         face->addVertex(*vi);
-        (*vi)->addFace(face, false);  // we'll update the normals later
+        (*vi)->addFace(face);  // marks the vertex normal as out of date, the face normal is computed when first needed
 
         Edge * edge = (*vi)->getEdgeTo(*next);
         if (!edge)
@@ -173,10 +424,10 @@ class Mesh : public virtual NamedObject, private Noncopyable
         face->addEdge(edge);
       }
 
-      // Update the face and vertex normals;
-      face->updateNormal();
-      for (typename Face::VertexIterator fvi = face->verticesBegin(); fvi != face->verticesEnd(); ++fvi)
-        (*fvi)->addFaceNormal(face->getNormal());  // weight by face area?
+      if (!face->isProperTriangle())
+        triangles_only = false;
+
+      invalidateRenderCache();
 
       return face;
     }
@@ -185,25 +436,19 @@ class Mesh : public virtual NamedObject, private Noncopyable
      * Remove a face of the mesh. This does NOT remove any vertices or edges. Iterators to the face list remain valid unless the
      * iterator pointed to the removed face.
      *
-     * This is a relatively slow operation since the face needs to be looked up in the face list
-     * (linear in number of faces). For speed, use removeFace(FaceIterator).
-     *
      * @return True if the face was found and removed, else false.
      */
     bool removeFace(Face * face)
     {
-      for (FaceIterator fi = faces.begin(); fi != faces.end(); ++fi)
-        if (&(*fi) == face)
-          return removeFace(fi);
-
-      return false;
+      typename std::unordered_map<Face const *, FaceIterator>::const_iterator loc = face_locations.find(face);
+      return loc != face_locations.end() && removeFace(loc->second);
     }
 
     /**
      * Remove a face of the mesh. This does NOT remove any vertices or edges. Iterators to the face list remain valid unless the
      * iterator pointed to the removed face.
      *
-     * Use this version in preference to removeFace(Face const *) where possible.
+     * Use this version in preference to removeFace(Face *) where possible.
      *
      * @return True if the face was found and removed, else false.
      */
@@ -217,7 +462,17 @@ class Mesh : public virtual NamedObject, private Noncopyable
       for (typename Face::EdgeIterator fei = face->edges.begin(); fei != face->edges.end(); ++fei)
         (*fei)->removeFace(fp);
 
-      faces.erase(face);
+      if (change_log) change_log->remove(fp);
+
+      if (deferred_removals)
+        deferred_removals->add(fp);
+      else
+      {
+        face_locations.erase(fp);
+        faces.erase(face);
+      }
+
+      invalidateRenderCache();
 
       return true;
     }
@@ -227,31 +482,227 @@ class Mesh : public virtual NamedObject, private Noncopyable
      * are completely removed from the mesh, and all relevant pointers in all adjacent elements are updated.
      *
      * @param edge The edge to collapse.
+     * @param collapsed If non-null, set to whether the edge was collapsed, which tells the two cases of a null return apart.
+     *
+     * @return The retained endpoint, or null if the edge could not be collapsed or the collapse left the retained endpoint
+     *   isolated (in which case it is removed as well).
+     */
+    Vertex * collapseEdge(Edge * edge, bool * collapsed = NULL);
+
+    /**
+     * Initialize the quadrics of all vertices, and the collapse errors and positions of all edges, for decimation, in a frame
+     * fitted to the current bounding box (see getQuadricFrame()). This is done automatically by load(), but must be called
+     * explicitly if the mesh is built some other way. The planes of the faces around each vertex are computed first, in one
+     * vectorized pass (see FacePlanes), and the vertex quadrics are built from them. Vertices and then edges are processed in
+     * parallel. May be called again after decimation: edges removed by the collapses are erased from the edge list first.
      *
-     * @return The retained endpoint.
+     * @param num_threads The number of threads to use. If non-positive, all available hardware threads are used.
      */
-    Vertex * collapseEdge(Edge * edge);
+    void updateQuadrics(long num_threads = -1);
 
     /**
      * Decimate the mesh by collapsing a single edge, identified using a quadric error metric, as described in the
      * Garland/Heckbert paper. Assumes all vertices have had their quadrics initialized, and all edges their collapse errors and
      * positions initialized in advance (e.g. by load()).
      *
-     * @return The vertex to which the edge has been collapsed.
+     * @param changes If non-null, the vertices, edges and faces affected by the collapse are added to this record, which may
+     *   accumulate the changes from several successive collapses (see patchRenderCache()).
+     * @param status If non-null, set to the outcome of the step. Decimation should go on until it is NO_EDGES_LEFT, since the
+     *   other outcomes that return null do not mean that the remaining edges cannot be collapsed.
+     *
+     * @return The vertex to which the edge has been collapsed, or null if the step did not leave one (see status).
      */
-    Vertex * decimateQuadricEdgeCollapse();
+    Vertex * decimateQuadricEdgeCollapse(Changes * changes = NULL, CollapseStatus * status = NULL);
 
     /**
      * Decimate the mesh to a target number of faces, using edge collapse decimation with a quadric error metric, as described
      * in the Garland/Heckbert paper. Assumes all vertices have had their quadrics initialized, and all edges their collapse
      * errors and positions initialized in advance (e.g. by load()).
+     *
+     * @param target_num_faces The number of faces to stop at.
+     * @param progress If non-null, used to report progress, measured in faces removed.
+     */
+    void decimateQuadricEdgeCollapse(long target_num_faces, ProgressReporter * progress = NULL);
+
+    /**
+     * Decimate the mesh to a target number of faces as above, saving checkpoints along the way (see saveCheckpoint()) so that
+     * an interrupted run can be resumed from the last one with loadCheckpoint(). Snapshots of the mesh are taken between
+     * collapses, and serialized and written on a background thread while decimation continues. If the previous checkpoint is
+     * still being written when the next is due, the next is put off until it has been.
+     *
+     * @param target_num_faces The number of faces to stop at.
+     * @param checkpoint_path The path of the checkpoint file. It is replaced by each new checkpoint and left in place at the end.
+     * @param checkpoint_interval The number of edge collapses between checkpoints. If non-positive, none are saved.
+     * @param progress If non-null, used to report progress, measured in faces removed.
+     */
+    void decimateQuadricEdgeCollapse(long target_num_faces, std::string const & checkpoint_path, long checkpoint_interval,
+                                     ProgressReporter * progress = NULL);
+
+    /**
+     * Decimate the mesh to a target number of faces with the multiple-choice scheme of Wu and Kobbelt, instead of the priority
+     * queue of decimateQuadricEdgeCollapse(). Each step samples a few edges at random, recomputes their quadric collapse errors
+     * and collapses the cheapest. Errors are only ever computed for sampled edges, and there is no queue to keep sorted, so this
+     * is faster and takes less memory, at the cost of a somewhat larger error. Assumes the quadrics have been initialized (e.g.
+     * by load()).
+     *
+     * Edges removed by the collapses are also erased from the edge list, which decimateQuadricEdgeCollapse() does not do. Its
+     * priority queue, if any, is discarded, and rebuilt if it is used again.
+     *
+     * @param target_num_faces The number of faces to stop at.
+     * @param num_choices The number of edges sampled per collapse. Larger numbers give results closer to those of
+     *   decimateQuadricEdgeCollapse(), smaller ones are faster. Wu and Kobbelt found 6 to 8 to be enough.
+     * @param seed Seed of the random number generator. Runs with the same seed give the same result.
+     * @param progress If non-null, used to report progress, measured in faces removed.
+     */
+    void decimateMultipleChoice(long target_num_faces, int num_choices = 8, uint32 seed = 0, ProgressReporter * progress = NULL);
+
+    /**
+     * Decimate the mesh to a target number of faces by quadric edge collapse on several threads at once. Each thread repeatedly
+     * takes a cheap edge from a shared relaxed priority queue (see MultiQueue), tries to lock every vertex that the collapse
+     * reads or changes (the vertices of the faces and edges at both endpoints), and collapses the edge if it gets them all.
+     * Otherwise it releases the locks and puts the edge back, and moves on to another edge without waiting. Threads only stop
+     * when the target is reached, so cores are never left idle waiting for each other.
+     *
+     * Edges come out of the queue only roughly in order of cost, so the result is close to, but not the same as, that of
+     * decimateQuadricEdgeCollapse(), and differs from run to run. Assumes the quadrics and collapse errors have been
+     * initialized (e.g. by load()). Edges removed by the collapses are erased from the edge list, and the priority queue of
+     * decimateQuadricEdgeCollapse(), if any, is discarded.
+     *
+     * @param target_num_faces The number of faces to stop at. A few more faces may be removed, by collapses that were under way
+     *   when the target was reached.
+     * @param num_threads The number of threads to use. If non-positive, all available hardware threads are used.
+     * @param progress If non-null, used to report progress, measured in faces removed.
+     *
+     * @return Counts of what the threads did, to measure throughput and contention.
+     */
+    ConcurrentStats decimateConcurrent(long target_num_faces, long num_threads = -1, ProgressReporter * progress = NULL);
+
+    /**
+     * Decimate the mesh to a target number of faces by splitting it into regions and decimating each on its own thread,
+     * followed by a pass over the whole mesh. This is parallel at the coarsest grain: threads share no queue and take no locks
+     * while they work, which suits very large meshes.
+     *
+     * Faces are assigned to regions by a k-d split of the bounding box (see getAABB()), placed so that regions have about the
+     * same number of faces. Vertices with faces in more than one region are frozen by holding their collapse locks, and each
+     * region removes most (three quarters) of its share of the faces with its own priority queue, skipping any collapse that
+     * would change a frozen vertex or its faces. Then the seams are unfrozen, and decimateQuadricEdgeCollapse() finishes the
+     * job across them, taking the cheapest collapses from the whole mesh so that no region ends up much coarser than another.
+     * Each region is decimated serially, so the result does not depend on how the threads are scheduled, but it does depend on
+     * the number of partitions.
+     *
+     * Assumes the quadrics and collapse errors have been initialized (e.g. by load()). Edges removed by the collapses in the
+     * regions are erased from the edge list.
+     *
+     * @param target_num_faces The number of faces to stop at.
+     * @param num_partitions The number of regions, each decimated on its own thread. If non-positive, one region is created
+     *   per hardware thread. With a single region, only the pass over the whole mesh does any work.
+     * @param progress If non-null, used to report progress, measured in faces removed.
+     *
+     * @return Counts of the collapses made in the regions and in the final pass.
      */
-    void decimateQuadricEdgeCollapse(long target_num_faces);
+    PartitionedStats decimatePartitioned(long target_num_faces, long num_partitions = -1, ProgressReporter * progress = NULL);
 
-    /** Draw the mesh on a render_system. */
+    /**
+     * Find the connected components of the mesh, i.e. the sets of vertices joined by paths of edges. The vertices are merged
+     * along all edges in parallel, with a lock-free union-find (see UnionFind).
+     *
+     * @param components Used to return the vertices of each component. Components are ordered by decreasing number of vertices
+     *   (ties broken by their first vertex in the vertex list), and the vertices of each are in the order of the vertex list.
+     * @param num_threads The number of threads to use. If non-positive, all available hardware threads are used.
+     *
+     * @return The number of components.
+     */
+    long findConnectedComponents(std::vector< std::vector<Vertex *> > & components, long num_threads = -1);
+
+    /**
+     * Decimate the mesh to a target number of faces by decimating each connected component on its own thread. This suits
+     * assemblies of many separate parts, which share nothing, so threads neither lock nor wait while they work, and each works
+     * on one part at a time.
+     *
+     * The target is divided between the components so that they all end at the same quadric error, as they would with one
+     * priority queue for the whole mesh (decimateQuadricEdgeCollapse()). Each component has its own priority queue. In each
+     * round, the error threshold that would allow the remaining faces to be removed is found by selection over all queued
+     * errors, and all components collapse their edges up to it in parallel. Collapses usually make errors grow, so this falls
+     * short, and is repeated. The last few faces are removed one collapse at a time, from whichever component has the
+     * cheapest edge. A round can only overshoot the target by the collapses that are under way when it is reached, at most
+     * one per thread.
+     *
+     * Assumes the quadrics and collapse errors have been initialized (e.g. by load()). Edges removed by the collapses are
+     * erased from the edge list, and the priority queue of decimateQuadricEdgeCollapse(), if any, is discarded.
+     *
+     * @param target_num_faces The number of faces to stop at.
+     * @param num_threads The number of threads to use. If non-positive, all available hardware threads are used.
+     * @param progress If non-null, used to report progress, measured in faces removed.
+     *
+     * @return The number of components and rounds, and the error reached.
+     */
+    ComponentStats decimateComponents(long target_num_faces, long num_threads = -1, ProgressReporter * progress = NULL);
+
+    /**
+     * Decimate several meshes to a total number of faces (a budget shared by a scene), by collapsing edges in order of quadric
+     * error across all the meshes, as if they were the components of one mesh (see decimateComponents()). Errors are compared
+     * in mesh coordinates (see QuadricFrame::toWorldError()), whatever the quadric frame of each mesh, so a large mesh keeps
+     * more of its faces than a small one of the same shape. All components of all meshes are decimated in parallel.
+     *
+     * Assumes the quadrics and collapse errors of every mesh have been initialized (e.g. by load()). A mesh must not appear
+     * twice, which is checked on entry.
+     *
+     * @param meshes The meshes to decimate.
+     * @param target_num_faces The total number of faces of all meshes to stop at.
+     * @param num_threads The number of threads to use. If non-positive, all available hardware threads are used.
+     * @param progress If non-null, used to report progress, measured in faces removed from all meshes.
+     *
+     * @return The number of components and rounds, and the error reached.
+     */
+    static ComponentStats decimateScene(std::vector<Mesh *> const & meshes, long target_num_faces, long num_threads = -1,
+                                        ProgressReporter * progress = NULL);
+
+    /**
+     * Recompute all face and vertex normals that are out of date, in parallel. Normals are not updated as the mesh is edited,
+     * only marked as out of date, and are otherwise recomputed lazily one at a time when requested. This function should be
+     * called before normals are read from multiple threads. It is called automatically by draw(). Does nothing if normals are
+     * not stored (see A2_MESH_ATTRIBUTES).
+     *
+     * @param num_threads The number of threads to use. If non-positive, all available hardware threads are used.
+     *
+     * @return The number of face and vertex normals that were recomputed.
+     */
+    long updateNormals(long num_threads = -1) const;
+
+    /**
+     * Draw the mesh on a render_system. The mesh is sent to the GPU as vertex, normal and index buffers (with faces with more
+     * than three vertices split into triangles), which are cached and reused in subsequent calls until the mesh changes.
+     *
+     * @param render_system The rendersystem to draw on. The GPU buffers are allocated from this rendersystem, which must
+     *   outlive the mesh or a call to releaseRenderCache().
+     * @param draw_edges If true, the edges of the mesh are drawn over the faces.
+     * @param use_vertex_data If true, vertex normals (and colors) are used for smooth shading. Else each face is drawn with its
+     *   own normal (and color).
+     * @param send_colors If true, vertex or face colors are sent to the rendersystem, else the current color is used.
+     */
     void draw(Graphics::RenderSystem & render_system, bool draw_edges = false, bool use_vertex_data = false,
               bool send_colors = false) const;
 
+    /**
+     * Mark the GPU buffers used by draw() as out of date. Edits through the mesh API and vertex position changes are tracked
+     * automatically, so this is only needed if vertex or face colors are changed directly.
+     */
+    void invalidateRenderCache() { ++edit_version; }
+
+    /**
+     * Update the GPU buffers used by draw() to reflect a set of changes recorded by the decimator, rewriting only the affected
+     * ranges. Slots of removed faces and edges are reused by later changes. Vertex positions changed directly since the buffers
+     * were last updated may be missed: call invalidateRenderCache() after such changes.
+     *
+     * @return True if the buffers were patched, false if they must be (and will be, by the next draw()) rebuilt from scratch,
+     *   e.g. because the buffers do not exist yet, the mesh was also edited without recording the changes, or there is not
+     *   enough free space.
+     */
+    bool patchRenderCache(Changes const & changes);
+
+    /** Release the GPU buffers used by draw(). They will be recreated if the mesh is drawn again. */
+    void releaseRenderCache();
+
     /** Update the bounding box of the mesh. */
     void updateBounds()
     {
@@ -263,67 +714,253 @@ class Mesh : public virtual NamedObject, private Noncopyable
     /** Get the bounding box of the mesh. */
     AxisAlignedBox3 const & getAABB() const { return bounds; }
 
-    /** Load the mesh from a disk file. */
-    bool load(std::string const & path);
+    /**
+     * Get the coordinate frame in which vertex quadrics and edge collapse errors are computed. This is chosen from the bounding
+     * box by updateQuadrics() (see QuadricFrame::forBounds()), and is the identity with double-precision quadrics.
+     */
+    QuadricFrame const & getQuadricFrame() const { return quadric_frame; }
+
+    /**
+     * Load the mesh from a disk file, and initialize quadrics for decimation.
+     *
+     * @param path The file to load.
+     * @param triangulate_polygons If true, faces with more than three vertices are split into triangles (see triangulate()).
+     */
+    bool load(std::string const & path, bool triangulate_polygons = false);
 
     /** Save the mesh to a disk file. */
     bool save(std::string const & path) const;
 
   private:
     /**
-     * Utility function to draw a face. Must be enclosed in the appropriate
-     * RenderSystem::beginPrimitive()/RenderSystem::endPrimitive() block.
+     * GPU buffers for drawing the mesh, and copies of their contents in main memory for incremental updates.
+     *
+     * The vertex arrays start with one entry (slot) per mesh vertex. With vertex data, triangles index into these slots.
+     * Without, the vertex slots are followed by three consecutive entries per triangle slot, carrying the normal and color of
+     * the face, which are drawn without indices. Edge indices always refer to the vertex slots. Each face owns a chain of
+     * triangle slots (one per triangle of its fan). Free slots are left in the buffers as degenerate triangles and edges, and
+     * reused by later patches until the buffers are rebuilt.
      */
-    void drawFace(Face const & face, Graphics::RenderSystem & render_system, bool use_vertex_data, bool send_colors) const
+    struct RenderCache
+    {
+      static uint32 const NONE = 0xFFFFFFFF;  ///< Marks the end of a chain of triangle slots.
+
+      RenderCache()
+      : render_system(NULL), vertex_area(NULL), index_area(NULL), positions(NULL), normals(NULL), colors(NULL),
+        tri_indices(NULL), edge_indices(NULL), num_vertex_slots(0), num_tri_slots(0), num_edge_slots(0), version(0),
+        use_vertex_data(false), send_colors(false), valid(false)
+      {}
+
+      Graphics::RenderSystem * render_system;  ///< The rendersystem that owns the buffers.
+      Graphics::VARArea * vertex_area;         ///< Storage for vertex attribute arrays.
+      Graphics::VARArea * index_area;          ///< Storage for index arrays.
+      Graphics::VAR * positions;               ///< Vertex positions.
+      Graphics::VAR * normals;                 ///< Vertex normals.
+      Graphics::VAR * colors;                  ///< Vertex colors, if requested.
+      Graphics::VAR * tri_indices;             ///< Triangle indices, if drawing with vertex data.
+      Graphics::VAR * edge_indices;            ///< Endpoint indices of edges.
+
+      std::vector<Vector3> position_data;      ///< Contents of the position array.
+      std::vector<Vector3> normal_data;        ///< Contents of the normal array.
+      std::vector<ColorRGBA> color_data;       ///< Contents of the color array, if any.
+      std::vector<uint32> tri_index_data;      ///< Contents of the triangle index array, if any.
+      std::vector<uint32> edge_index_data;     ///< Contents of the edge index array.
+
+      long num_vertex_slots;                   ///< Number of vertex slots, used or free.
+      long num_tri_slots;                      ///< Number of triangle slots, used or free.
+      long num_edge_slots;                     ///< Number of edge slots, used or free.
+
+      std::unordered_map<Vertex const *, uint32> vertex_slots;  ///< Slot of each vertex.
+      std::unordered_map<Face const *, uint32> face_slots;      ///< First triangle slot of each face.
+      std::unordered_map<Edge const *, uint32> edge_slots;      ///< Slot of each edge.
+      std::vector<uint32> next_tri_slot;       ///< Next triangle slot of the same face, or NONE.
+      std::vector<uint32> free_vertex_slots;   ///< Unused vertex slots.
+      std::vector<uint32> free_tri_slots;      ///< Unused triangle slots.
+      std::vector<uint32> free_edge_slots;     ///< Unused edge slots.
+
+      uint64 version;                          ///< Version of the mesh reflected by the buffers.
+      bool use_vertex_data;                    ///< Were the buffers built for smooth shading?
+      bool send_colors;                        ///< Were the buffers built with colors?
+      bool valid;                              ///< False if the buffers need to be rebuilt.
+    };
+
+    /** Rebuild the GPU buffers for drawing the mesh. */
+    void updateRenderCache(Graphics::RenderSystem & render_system, bool use_vertex_data, bool send_colors) const;
+
+    /** Write the current data of a vertex to a (possibly new) vertex slot. Returns false if there are no free slots. */
+    bool writeVertexSlot(Vertex const * vertex, std::vector<long> & dirty_vertices) const;
+
+    /**
+     * Split a face into triangles and write them to the triangle slots of the face, after releasing its existing slots. Returns
+     * false if there are not enough free slots.
+     */
+    bool writeFaceSlots(Face const * face, std::vector<long> & dirty_tris) const;
+
+    /** Release the triangle slots of a face, leaving degenerate triangles in their place. */
+    void releaseFaceSlots(Face const * face, std::vector<long> & dirty_tris) const;
+
+    /** Write an edge to a (possibly new) edge slot, or release its slot if it is no longer part of the mesh. */
+    bool writeEdgeSlot(Edge const * edge, std::vector<long> & dirty_edges) const;
+
+    struct EdgeComp
     {
-      if (!use_vertex_data)
+      bool operator()(const Edge* lhs, const Edge* rhs) const
       {
-        render_system.setNormal(face.getNormal());
-        if (send_colors) render_system.setColor(face.getColor());
+        return lhs->getQuadricCollapseError() < rhs->getQuadricCollapseError();
       }
+    };
 
-      for (typename Face::VertexConstIterator vi = face.verticesBegin(); vi != face.verticesEnd(); ++vi)
+    /**
+     * Order of the priority queue: by error, then by order of insertion. Edges of equal error come out in the order they went
+     * in, as in a multiset ordered by error alone, but every edge has a distinct key, so it can be found without walking past
+     * the others of its error (there can be very many, e.g. the spokes of a fan).
+     */
+    struct EdgeHeapComp
+    {
+      bool operator()(const Edge* lhs, const Edge* rhs) const
       {
-        Vertex const & vertex = **vi;
+        if (lhs->getQuadricCollapseError() != rhs->getQuadricCollapseError())
+          return lhs->getQuadricCollapseError() < rhs->getQuadricCollapseError();
 
-        if (use_vertex_data)
-        {
-          render_system.setNormal(vertex.getNormal());
-          if (send_colors) render_system.setColor(vertex.getColor());
-        }
-
-        render_system.sendVertex(vertex.getPosition());
+        return lhs->heap_sequence < rhs->heap_sequence;
       }
+    };
+
+    /** Add an edge to the priority queue, after all edges of the same error. */
+    void insert_into_heap(std::multiset<Edge*, EdgeHeapComp>& eh, Edge* e);
+
+    void remove_from_heap(std::multiset<Edge*, EdgeHeapComp>& eh, Edge* e);
+
+    /** Check if an edge is in the pool of edges sampled by decimateMultipleChoice(). */
+    bool isCollapseCandidate(Edge const * edge) const
+    {
+      return edge->candidate_index < collapse_candidates.size() && collapse_candidates[edge->candidate_index] == edge;
     }
 
-    struct EdgeComp
+    /** Remove an edge, if present, from the pool of edges sampled by decimateMultipleChoice(). */
+    void removeCollapseCandidate(Edge * edge);
+
+    /**
+     * An edge waiting to be collapsed, in a priority queue private to one thread, with the endpoints and error it had when it
+     * was queued. Instead of being removed from the queue when it changes, the entry goes stale (see isCurrent()), and is
+     * skipped when it reaches the top. Ordered so that std::push_heap() and std::pop_heap() keep the cheapest on top.
+     */
+    struct LocalCollapse
     {
-      bool operator()(const Edge* lhs, const Edge* rhs) const
+      double error;  ///< Collapse error of the edge when it was queued.
+      Edge * edge;   ///< The edge.
+      Vertex * u;    ///< First endpoint of the edge when it was queued.
+      Vertex * v;    ///< Second endpoint of the edge when it was queued.
+
+      /** Order by decreasing error. */
+      bool operator<(LocalCollapse const & rhs) const { return error > rhs.error; }
+    };
+
+    /** Add an edge, with its current error, to a local priority queue. */
+    static void pushLocalCollapse(std::vector<LocalCollapse> & queue, Edge * edge);
+
+    /** Check if a queued collapse is current, i.e. its edge still joins the same endpoints and has the same error. */
+    static bool isCurrent(LocalCollapse const & entry);
+
+    /**
+     * Collapse the edge of a current queued collapse, move the retained vertex to the optimal position and update quadrics and
+     * errors, as decimateQuadricEdgeCollapse() does, and queue the edges of the retained vertex with their new errors.
+     *
+     * @return The number of faces removed, zero if the edge could not be collapsed.
+     */
+    long applyLocalCollapse(LocalCollapse const & entry, std::vector<LocalCollapse> & queue);
+
+    /** An edge of a vertex, keyed on its other endpoint and ordered by it, used to find duplicate edges. */
+    struct EdgeKey
+    {
+      Vertex const * other;  ///< The other endpoint.
+      size_t position;       ///< Position of the edge in the edge list of the vertex.
+      size_t group;          ///< Position of the first edge with the same other endpoint.
+      Edge * edge;           ///< The edge.
+
+      /** Order by other endpoint, then by position. */
+      bool operator<(EdgeKey const & rhs) const
       {
-        return lhs->getQuadricCollapseError() < rhs->getQuadricCollapseError();
+        return std::less<Vertex const *>()(other, rhs.other) || (other == rhs.other && position < rhs.position);
       }
     };
 
-    void remove_from_heap(std::multiset<Edge*, EdgeComp>& eh, Edge* e);
+    /**
+     * Faces and vertices removed while decimateConcurrent() runs. They are detached from the rest of the mesh right away, but
+     * only erased from the face and vertex lists (which are shared by all threads) once it is done. This also keeps removed
+     * vertices in memory, so that their locks can still be tried by threads holding stale references to them.
+     */
+    struct DeferredRemovals
+    {
+      Spinlock lock;                  ///< Protects the lists.
+      std::vector<Face *> faces;      ///< Removed faces.
+      std::vector<Vertex *> vertices; ///< Removed vertices.
+      std::atomic<long> num_faces;    ///< Number of removed faces, readable without the lock.
+
+      /** Constructor. */
+      DeferredRemovals() : num_faces(0) {}
+
+      /** Record a removed face. */
+      void add(Face * face) { lock.lock(); faces.push_back(face); lock.unlock(); ++num_faces; }
+
+      /** Record a removed vertex. */
+      void add(Vertex * vertex) { lock.lock(); vertices.push_back(vertex); lock.unlock(); }
+    };
+
+    /** Stop deferring removals, and erase the faces and vertices recorded so far from the face and vertex lists. */
+    void eraseDeferredRemovals(DeferredRemovals & removals);
+
+    /**
+     * Erase edges that have been removed from the mesh, but left in the edge list by collapses, so that the list holds exactly
+     * the edges referenced by the vertices.
+     */
+    void eraseRemovedEdges();
+
+    /** Remove a vertex, which must no longer be referenced by any edge or face, from the vertex list. */
+    void removeVertex(Vertex * vertex);
 
     /** If two edges of the mesh have the same endpoints, merge them into a single edge, which is returned by the function. */
     Edge * mergeEdges(Edge * e0, Edge * e1);
 
+    /**
+     * Collapse an edge of a mesh whose faces are all proper triangles (see isTriangleMesh()). The faces on the edge are simply
+     * removed, since each has lost a vertex and a triangle cannot survive that. See collapseEdge().
+     */
+    Vertex * collapseTriangleEdge(Edge * edge, bool * collapsed);
+
+    /**
+     * Finish collapsing an edge from v to u, once no face references the edge or v: move all other edges and faces of v to u,
+     * remove the edge and v, and merge edges that have become duplicates. See collapseEdge() for the return value.
+     */
+    Vertex * finishCollapse(Edge * edge, Vertex * u, Vertex * v);
+
     /** Load the mesh from an OFF file. */
     bool loadOFF(std::string const & path);
 
     /** Save the mesh to an OFF file. */
     bool saveOFF(std::string const & path) const;
 
-    FaceList         faces;     ///< Set of mesh faces.
-    VertexList       vertices;  ///< Set of mesh vertices.
-    EdgeList         edges;     ///< Set of mesh edges.
-    AxisAlignedBox3  bounds;    ///< Mesh bounding box.
+    FaceList         faces;           ///< Set of mesh faces.
+    VertexList       vertices;        ///< Set of mesh vertices.
+    EdgeList         edges;           ///< Set of mesh edges.
+    AxisAlignedBox3  bounds;          ///< Mesh bounding box.
+    QuadricFrame     quadric_frame;   ///< Frame in which quadrics are computed.
+    bool             triangles_only;  ///< Is every face a triangle with distinct vertices?
+
+    std::unordered_map<Vertex const *, VertexIterator> vertex_locations;  ///< Position of each vertex in the vertex list.
+    std::unordered_map<Face const *, FaceIterator> face_locations;        ///< Position of each face in the face list.
 
     mutable std::vector<Vertex *> face_vertices;  ///< Internal cache of vertex pointers for a face.
+    mutable RenderCache render_cache;              ///< GPU buffers for drawing the mesh.
+    std::atomic<uint64> edit_version;              ///< Incremented whenever the mesh is edited.
+    Changes * change_log;                          ///< If non-null, edits are recorded here.
+    DeferredRemovals * deferred_removals;          ///< If non-null, removed faces and vertices are recorded here.
 
-    std::multiset<Edge*, EdgeComp> edge_heap;
+    std::multiset<Edge*, EdgeHeapComp> edge_heap;
     bool heap_constructed = false;
+    uint64 next_heap_sequence = 0;  ///< Insertion order of the next edge added to the priority queue.
+
+    std::vector<Edge *> collapse_candidates;  ///< Edges sampled by decimateMultipleChoice(), while it runs.
 
 }; // class Mesh
 
@@ -25,7 +25,7 @@ MeshEdge::nextAroundEndpoint(int i)
 }
 
 void
-MeshEdge::updateQuadricCollapseError()
+MeshEdge::updateQuadricCollapseError(QuadricFrame const & frame)
 {
   // Update both quadric_collapse_error and quadric_collapse_position, using the existing endpoint quadrics and the method of
   // Garland/Heckbert.
@@ -34,7 +34,7 @@ MeshEdge::updateQuadricCollapseError()
   // midpoint of the edge (or in the worst case, set the error to a negative value to indicate this edge should not be
   // collapsed).
 
-  DMat4 q = endpoints[0]->getQuadric() + endpoints[1]->getQuadric();
+  DMat4 q = quadricCast<double>(endpoints[0]->getQuadric()) + quadricCast<double>(endpoints[1]->getQuadric());
 
   DMat4 w(q(0,0), q(0,1), q(0,2), q(0,3),
           q(0,1), q(1,1), q(1,2), q(1,3),
@@ -48,9 +48,23 @@ MeshEdge::updateQuadricCollapseError()
   }
   else
   {
-    v = Vector4(endpoints[0]->getPosition() + endpoints[1]->getPosition()/2.0, 1);
+    v = Vector4(frame.toLocal((endpoints[0]->getPosition() + endpoints[1]->getPosition()) / 2.0), 1);
   }
 
-  quadric_collapse_position = Vector3(v[0], v[1], v[2]);
+  quadric_collapse_position = frame.toWorld(Vector3(v[0], v[1], v[2]));
   quadric_collapse_error = v.dot((q * v));
 }
+
+void
+MeshEdge::serialize(BinaryOutputStream & output) const
+{
+  output.writeFloat64(quadric_collapse_error);
+  output.writeVector3(quadric_collapse_position);
+}
+
+void
+MeshEdge::deserialize(BinaryInputStream & input)
+{
+  quadric_collapse_error = input.readFloat64();
+  quadric_collapse_position = input.readVector3();
+}
@@ -2,6 +2,9 @@
 #define __A2_MeshEdge_hpp__
 
 #include "Common.hpp"
+#include "DGP/BinaryInputStream.hpp"
+#include "DGP/BinaryOutputStream.hpp"
+#include "QuadricFrame.hpp"
 #include <list>
 
 // Forward declarations
@@ -23,7 +26,7 @@ class MeshEdge
     typedef typename FaceList::const_iterator  FaceConstIterator;  ///< Const iterator over faces.
 
     /** Construct from two endpoints. */
-    MeshEdge(Vertex * v0 = NULL, Vertex * v1 = NULL) : quadric_collapse_error(-1)
+    MeshEdge(Vertex * v0 = NULL, Vertex * v1 = NULL) : quadric_collapse_error(-1), heap_sequence(0), candidate_index(0)
     {
       endpoints[0] = v0;
       endpoints[1] = v1;
@@ -148,17 +151,26 @@ class MeshEdge
     /** Check if this is a boundary edge, i.e. if it is adjacent to at most one face. */
     bool isBoundary() const { return numFaces() <= 1; }
 
-    /** Get the quadric error of collapsing this edge. */
+    /**
+     * Get the quadric error of collapsing this edge, measured in the frame the quadrics were computed in (see
+     * Mesh::getQuadricFrame()).
+     */
     double getQuadricCollapseError() const { return quadric_collapse_error; }
 
     /** Get the optimal position to which to collapse this edge, according to a quadric error metric. */
     Vector3 const & getQuadricCollapsePosition() const { return quadric_collapse_position; }
 
     /**
-     * Recompute the quadric error and optimal collapse position for this vertex. If these cannot be successfully calculated,
-     * the error will be set to a negative value.
+     * Recompute the quadric error and optimal collapse position for this vertex, given the frame in which the endpoint quadrics
+     * were computed. If these cannot be successfully calculated, the error will be set to a negative value.
      */
-    void updateQuadricCollapseError();
+    void updateQuadricCollapseError(QuadricFrame const & frame = QuadricFrame());
+
+    /** Write the attributes of the edge, but not its references to vertices and faces, to a binary stream. Values are exact. */
+    void serialize(BinaryOutputStream & output) const;
+
+    /** Read the attributes of the edge, but not its references to vertices and faces, from a binary stream. */
+    void deserialize(BinaryInputStream & input);
 
   private:
     friend class Mesh;
@@ -213,6 +225,14 @@ class MeshEdge
     double quadric_collapse_error;
     Vector3 quadric_collapse_position;
 
+    // Order of insertion into the priority queue of Mesh, which breaks ties between edges of equal error (only meaningful while
+    // the edge is in the queue)
+    uint64 heap_sequence;
+
+    // Multiple-choice decimation-specific: position in the pool of edges sampled by Mesh::decimateMultipleChoice(), only
+    // meaningful if the pool has this edge at this position
+    uint32 candidate_index;
+
 }; // class MeshEdge
 
 #endif
@@ -0,0 +1,156 @@
+#include "MeshError.hpp"
+#include "Mesh.hpp"
+#include "DGP/BVH3.hpp"
+#include "DGP/Parallel.hpp"
+#include "DGP/Random.hpp"
+#include "DGP/Triangle3.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace MeshErrorInternal {
+
+// Split the faces of a mesh into triangles.
+void
+triangulate(Mesh const & mesh, std::vector<LocalTriangle3> & tris)
+{
+  tris.clear();
+  tris.reserve((size_t)mesh.numFaces());
+
+  for (Mesh::FaceConstIterator fi = mesh.facesBegin(); fi != mesh.facesEnd(); ++fi)
+  {
+    if (fi->numVertices() < 3)
+      continue;
+
+    Mesh::Face::VertexConstIterator vi = fi->verticesBegin();
+    Vector3 p0 = (*vi)->getPosition(); ++vi;
+    Vector3 p1 = (*vi)->getPosition(); ++vi;
+    for ( ; vi != fi->verticesEnd(); ++vi)
+    {
+      Vector3 p2 = (*vi)->getPosition();
+      tris.push_back(LocalTriangle3(p0, p1, p2));
+      p1 = p2;
+    }
+  }
+}
+
+} // namespace MeshErrorInternal
+
+double
+MeshError::Result::rms() const
+{
+  long n = a_to_b.num_samples + b_to_a.num_samples;
+  if (n <= 0)
+    return 0;
+
+  double sum_sq = a_to_b.rms * a_to_b.rms * a_to_b.num_samples + b_to_a.rms * b_to_a.rms * b_to_a.num_samples;
+  return std::sqrt(sum_sq / n);
+}
+
+std::string
+MeshError::Result::toString() const
+{
+  return format("A -> B: max %g, mean %g, rms %g (%ld samples)\n"
+                "B -> A: max %g, mean %g, rms %g (%ld samples)\n"
+                "Symmetric: Hausdorff %g, rms %g",
+                a_to_b.max, a_to_b.mean, a_to_b.rms, a_to_b.num_samples,
+                b_to_a.max, b_to_a.mean, b_to_a.rms, b_to_a.num_samples,
+                hausdorff(), rms());
+}
+
+MeshError::Result
+MeshError::compute(Mesh const & a, Mesh const & b, long num_samples, uint32 seed, long num_threads)
+{
+  Result result;
+  result.a_to_b = computeOneSided(a, b, num_samples, seed, num_threads);
+  result.b_to_a = computeOneSided(b, a, num_samples, seed + 0x5BD1E995u, num_threads);
+  return result;
+}
+
+MeshError::Stats
+MeshError::computeOneSided(Mesh const & from, Mesh const & to, long num_samples, uint32 seed, long num_threads)
+{
+  using namespace MeshErrorInternal;
+
+  Stats stats;
+
+  std::vector<LocalTriangle3> src;
+  triangulate(from, src);
+
+  BVH3<LocalTriangle3> dst;
+  {
+    std::vector<LocalTriangle3> tris;
+    triangulate(to, tris);
+    dst.add(tris.begin(), tris.end());
+  }
+  dst.init(num_threads);
+
+  if (src.empty() || dst.numElements() <= 0 || num_samples <= 0)
+    return stats;
+
+  // Cumulative distribution of triangle areas, for sampling triangles in proportion to their area
+  std::vector<double> cdf(src.size());
+  double total_area = 0;
+  for (size_t i = 0; i < src.size(); ++i)
+  {
+    total_area += src[i].getArea();
+    cdf[i] = total_area;
+  }
+
+  if (total_area <= 0)
+    return stats;
+
+  // Each chunk of samples gets its own random stream and accumulators, which are combined at the end
+  num_threads = Parallel::numThreads(num_samples, num_threads, 1024);
+  std::vector<double> chunk_max((size_t)num_threads, 0.0), chunk_sum((size_t)num_threads, 0.0),
+                      chunk_sum_sq((size_t)num_threads, 0.0);
+
+  Parallel::forChunks(0, num_samples, [&](long begin, long end, long chunk)
+  {
+    Random rng(seed + (uint32)chunk * 0x9E3779B9u, /* threadsafe = */ false);
+
+    double max_dist = 0, sum = 0, sum_sq = 0;
+    for (long i = begin; i < end; ++i)
+    {
+      // Combine two 32-bit draws so that triangle selection has enough resolution for very large meshes
+      double u = (rng.bits() + rng.bits() / 4294967296.0) / 4294967296.0;
+      size_t t = (size_t)(std::upper_bound(cdf.begin(), cdf.end(), u * total_area) - cdf.begin());
+      if (t >= src.size()) t = src.size() - 1;
+
+      LocalTriangle3 const & tri = src[t];
+      Real s = rng.uniform01(), r = rng.uniform01();
+      if (s + r > 1)
+      {
+        s = 1 - s;
+        r = 1 - r;
+      }
+
+      Vector3 p = tri.getVertex(0) + s * tri.getEdge01() + r * tri.getEdge02();
+
+      Real sqdist = 0;
+      dst.closestElement(p, -1, NULL, &sqdist);
+
+      double d = std::sqrt((double)sqdist);
+      max_dist = std::max(max_dist, d);
+      sum += d;
+      sum_sq += d * d;
+    }
+
+    chunk_max[(size_t)chunk] = max_dist;
+    chunk_sum[(size_t)chunk] = sum;
+    chunk_sum_sq[(size_t)chunk] = sum_sq;
+  }, num_threads);
+
+  double sum = 0, sum_sq = 0;
+  for (long i = 0; i < num_threads; ++i)
+  {
+    stats.max = std::max(stats.max, chunk_max[(size_t)i]);
+    sum += chunk_sum[(size_t)i];
+    sum_sq += chunk_sum_sq[(size_t)i];
+  }
+
+  stats.num_samples = num_samples;
+  stats.mean = sum / num_samples;
+  stats.rms = std::sqrt(sum_sq / num_samples);
+
+  return stats;
+}
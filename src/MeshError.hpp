@@ -0,0 +1,68 @@
+#ifndef __A2_MeshError_hpp__
+#define __A2_MeshError_hpp__
+
+#include "Common.hpp"
+#include <algorithm>
+#include <string>
+
+// Forward declaration
+class Mesh;
+
+/**
+ * Geometric error between two surfaces, measured by sampling points uniformly (by area) on each surface and finding the
+ * distance from each sample to the closest point of the other surface. Closest points are found with a bounding volume
+ * hierarchy over the triangles of the target surface, and samples are processed in parallel, each thread drawing from its own
+ * random number stream.
+ */
+class MeshError
+{
+  public:
+    /** Statistics of the distances from samples on one surface to another surface. */
+    struct Stats
+    {
+      /** Constructor. */
+      Stats() : max(0), mean(0), rms(0), num_samples(0) {}
+
+      double max;         ///< Largest distance (the one-sided Hausdorff distance).
+      double mean;        ///< Mean distance.
+      double rms;         ///< Root mean square distance.
+      long num_samples;   ///< Number of samples.
+    };
+
+    /** Error measured in both directions between two surfaces A and B. */
+    struct Result
+    {
+      Stats a_to_b;  ///< Distances from samples on A to B.
+      Stats b_to_a;  ///< Distances from samples on B to A.
+
+      /** Get the symmetric Hausdorff distance, i.e. the larger of the two maximum distances. */
+      double hausdorff() const { return std::max(a_to_b.max, b_to_a.max); }
+
+      /** Get the root mean square distance over all samples in both directions. */
+      double rms() const;
+
+      /** Get a multi-line description of the result. */
+      std::string toString() const;
+    };
+
+    /**
+     * Measure the error in both directions between two meshes. Faces with more than three vertices are split into triangle
+     * fans.
+     *
+     * @param a The first mesh.
+     * @param b The second mesh.
+     * @param num_samples The number of samples to draw on each mesh.
+     * @param seed Seed for the random number streams. The result is deterministic for a given seed and number of threads.
+     * @param num_threads The number of threads to use. If non-positive, all available hardware threads are used.
+     */
+    static Result compute(Mesh const & a, Mesh const & b, long num_samples, uint32 seed = 0, long num_threads = -1);
+
+    /**
+     * Measure the distances from samples on one mesh to another mesh. See compute() for an explanation of the parameters.
+     */
+    static Stats computeOneSided(Mesh const & from, Mesh const & to, long num_samples, uint32 seed = 0,
+                                 long num_threads = -1);
+
+}; // class MeshError
+
+#endif
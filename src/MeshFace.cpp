@@ -1,36 +1,45 @@
 #include "MeshFace.hpp"
 #include "MeshVertex.hpp"
 
+#if A2_MESH_ATTRIBUTES == A2_MESH_ATTRIBUTES_FULL
+
 void
-MeshFace::updateNormal()
+MeshFace::invalidateNormal()
 {
-  // Assume the face is planar.
-  VertexConstIterator vi2 = vertices.begin();
-  VertexConstIterator vi0 = vi2++;
-  VertexConstIterator vi1 = vi2++;
+  normal_dirty = true;
 
-  if (vertices.size() > 3)
-  {
-    // vi1 might be a concave corner -- we need to add up the cross products at all vertices
-    Vector3 sum_cross = Vector3::zero();
-    for ( ; vi0 != vertices.end(); ++vi0, ++vi1, ++vi2)
-    {
-      if (vi1 == vertices.end()) vi1 = vertices.begin();
-      if (vi2 == vertices.end()) vi2 = vertices.begin();
+  for (VertexIterator vi = vertices.begin(); vi != vertices.end(); ++vi)
+    (*vi)->invalidateNormal();
+}
 
-      Vector3 e1 = (*vi0)->getPosition() - (*vi1)->getPosition();
-      Vector3 e2 = (*vi2)->getPosition() - (*vi1)->getPosition();
-      sum_cross += e2.cross(e1);
-    }
+#endif
 
-    setNormal(sum_cross.unit());
+Vector3
+MeshFace::computeNormal() const
+{
+  if (vertices.size() == 3)  // the common case
+  {
+    Vector3 const & p0 = vertices[0]->getPosition();
+    Vector3 const & p1 = vertices[1]->getPosition();
+    Vector3 const & p2 = vertices[2]->getPosition();
+    return (p2 - p1).cross(p0 - p1).unit();  // counter-clockwise
   }
-  else
+
+  if (vertices.size() < 3)
+    return Vector3::zero();
+
+  // Assume the face is planar. A vertex might be a concave corner -- we need to add up the cross products at all vertices.
+  Vector3 sum_cross = Vector3::zero();
+  size_t n = vertices.size();
+  for (size_t i = 0; i < n; ++i)
   {
-    Vector3 e1 = (*vi0)->getPosition() - (*vi1)->getPosition();
-    Vector3 e2 = (*vi2)->getPosition() - (*vi1)->getPosition();
-    setNormal(e2.cross(e1).unit());  // counter-clockwise
+    Vector3 const & p1 = vertices[(i + 1) % n]->getPosition();
+    Vector3 e1 = vertices[i]->getPosition() - p1;
+    Vector3 e2 = vertices[(i + 2) % n]->getPosition() - p1;
+    sum_cross += e2.cross(e1);
   }
+
+  return sum_cross.unit();
 }
 
 bool
@@ -76,3 +85,27 @@ MeshFace::contains(Vector3 const & p) const
 
   return (count % 2 == 1);
 }
+
+void
+MeshFace::serialize(BinaryOutputStream & output) const
+{
+#if A2_MESH_ATTRIBUTES == A2_MESH_ATTRIBUTES_FULL
+  output.writeVector3(normal);
+  output.writeBool8(normal_dirty);
+  output.writeColorRGBA(color);
+#else
+  (void)output;  // nothing is stored with the face but its references
+#endif
+}
+
+void
+MeshFace::deserialize(BinaryInputStream & input)
+{
+#if A2_MESH_ATTRIBUTES == A2_MESH_ATTRIBUTES_FULL
+  normal = input.readVector3();
+  normal_dirty = input.readBool8();
+  color = input.readColorRGBA();
+#else
+  (void)input;
+#endif
+}
@@ -2,15 +2,21 @@
 #define __A2_MeshFace_hpp__
 
 #include "Common.hpp"
+#include "DGP/BinaryInputStream.hpp"
+#include "DGP/BinaryOutputStream.hpp"
 #include "DGP/Colors.hpp"
+#include "DGP/SmallArrayN.hpp"
 #include "DGP/Vector3.hpp"
-#include <list>
 
 // Forward declarations
 class MeshVertex;
 class MeshEdge;
+class FacePlanes;
 
-/** Face of a mesh. */
+/**
+ * Face of a mesh. The loops of vertices and edges around the face are stored within the face itself if it is a triangle, and
+ * on the heap only if it is a larger polygon, so that triangle meshes (the common case) pay nothing for the generality.
+ */
 class MeshFace
 {
   public:
@@ -18,8 +24,8 @@ class MeshFace
     typedef MeshEdge    Edge;    ///< Edge of the mesh.
 
   private:
-    typedef std::list<Vertex *>  VertexList;
-    typedef std::list<Edge *  >  EdgeList;
+    typedef SmallArrayN<3, Vertex *>  VertexList;
+    typedef SmallArrayN<3, Edge *  >  EdgeList;
 
   public:
     typedef typename VertexList::iterator                VertexIterator;              ///< Iterator over vertices.
@@ -31,8 +37,20 @@ class MeshFace
     typedef typename EdgeList::reverse_iterator          EdgeReverseIterator;         ///< Reverse iterator over edges.
     typedef typename EdgeList::const_reverse_iterator    EdgeConstReverseIterator;    ///< Const reverse iterator over edges.
 
+#if A2_MESH_ATTRIBUTES == A2_MESH_ATTRIBUTES_FULL
+
+    /** Default constructor. The normal is computed from the vertices when first requested. */
+    MeshFace() : normal(Vector3::zero()), normal_dirty(true) {}
+
     /** Construct with the given normal. */
-    MeshFace(Vector3 const & normal_ = Vector3::zero()) : normal(normal_) {}
+    explicit MeshFace(Vector3 const & normal_) : normal(normal_), normal_dirty(false) {}
+
+#else
+
+    /** Default constructor. */
+    MeshFace() {}
+
+#endif
 
     /** Check if the face has a given vertex. */
     bool hasVertex(Vertex const * vertex) const
@@ -250,6 +268,12 @@ class MeshFace
     /** Check if the face is a triangle. */
     bool isTriangle() const { return  vertices.size() == 3; }
 
+    /** Check if the face is a triangle with three distinct vertices. */
+    bool isProperTriangle() const
+    {
+      return vertices.size() == 3 && vertices[0] != vertices[1] && vertices[1] != vertices[2] && vertices[2] != vertices[0];
+    }
+
     /** Check if the face is a quad. */
     bool isQuad() const { return vertices.size() == 4; }
 
@@ -260,14 +284,32 @@ class MeshFace
       edges.reverse();
     }
 
-    /** Get the face normal. */
-    Vector3 const & getNormal() const { return normal; }
+#if A2_MESH_ATTRIBUTES == A2_MESH_ATTRIBUTES_FULL
+
+    /**
+     * Get the face normal. If the normal is out of date, it is recomputed from the vertices first. This lazy update is not
+     * threadsafe: to read normals from multiple threads, first bring them all up to date with Mesh::updateNormals().
+     */
+    Vector3 const & getNormal() const
+    {
+      if (normal_dirty) recomputeNormal();
+      return normal;
+    }
 
     /** Set the face normal. */
-    void setNormal(Vector3 const & normal_) { normal = normal_; }
+    void setNormal(Vector3 const & normal_) { normal = normal_; normal_dirty = false; }
 
     /** Update the face normal by recomputing it from vertex data. */
-    void updateNormal();
+    void updateNormal() { recomputeNormal(); }
+
+    /** Check if the face normal is out of date and will be recomputed when next requested. */
+    bool isNormalDirty() const { return normal_dirty; }
+
+    /**
+     * Mark the face normal as out of date, so that it is recomputed from vertex data when next requested. The normals of the
+     * vertices of the face, which depend on it, are also marked as out of date.
+     */
+    void invalidateNormal();
 
     /** Get the color of the face. */
     ColorRGBA const & getColor() const { return color; }
@@ -275,15 +317,46 @@ class MeshFace
     /** Set the color of the face. */
     void setColor(ColorRGBA const & color_) { color = color_; }
 
+#else
+
+    /** Get the face normal, computed from the vertices (the normal is not stored). Threadsafe. */
+    Vector3 getNormal() const { return computeNormal(); }
+
+    /** Does nothing, since normals are not stored. */
+    void invalidateNormal() {}
+
+    /** Get the color of the face, which is always white (colors are not stored). */
+    ColorRGBA const & getColor() const { static ColorRGBA const WHITE(1, 1, 1, 1); return WHITE; }
+
+#endif
+
     /**
      * Test if the face contains a point (which is assumed to lie on the plane of the face -- for efficiency the function does
      * <b>not</b> explicitly verify that this holds).
      */
     bool contains(Vector3 const & p) const;
 
+    /** Write the attributes of the face, but not its references to vertices and edges, to a binary stream. Values are exact. */
+    void serialize(BinaryOutputStream & output) const;
+
+    /** Read the attributes of the face, but not its references to vertices and edges, from a binary stream. */
+    void deserialize(BinaryInputStream & input);
+
   private:
     friend class Mesh;
     friend class MeshEdge;
+    friend class MeshVertex;
+    friend class FacePlanes;
+
+    /** Compute the face normal from vertex data. */
+    Vector3 computeNormal() const;
+
+#if A2_MESH_ATTRIBUTES == A2_MESH_ATTRIBUTES_FULL
+
+    /** Recompute the face normal from vertex data. */
+    void recomputeNormal() const { normal = computeNormal(); normal_dirty = false; }
+
+#endif
 
     /** Add a reference to a vertex of this face. */
     void addVertex(Vertex * vertex) { vertices.push_back(vertex); }
@@ -337,11 +410,15 @@ class MeshFace
           *ei = new_edge;
     }
 
-    Vector3 normal;
-    ColorRGBA color;
     VertexList vertices;
     EdgeList edges;
 
+#if A2_MESH_ATTRIBUTES == A2_MESH_ATTRIBUTES_FULL
+    mutable Vector3 normal;
+    mutable bool normal_dirty;
+    ColorRGBA color;
+#endif
+
 }; // class MeshFace
 
 #endif
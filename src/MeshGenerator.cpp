@@ -0,0 +1,498 @@
+#include "MeshGenerator.hpp"
+#include "DGP/Math.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+
+namespace MeshGeneratorInternal {
+
+// Largest mesh we can index with 32-bit vertex indices, with some headroom.
+long const MAX_ELEMENTS = 0x7FFFFFFFL;
+
+// Integer square root of a non-negative quantity, at least 1.
+long
+rootAtLeastOne(double x)
+{
+  return std::max(1L, (long)std::floor(std::sqrt(std::max(x, 0.0)) + 0.5));
+}
+
+// Hash a lattice point to a pseudorandom value in [-1, 1].
+Real
+latticeNoise(long x, long y, uint32 seed)
+{
+  uint32 h = seed * 0x9E3779B9u;
+  h ^= (uint32)x * 0x85EBCA6Bu;  h = (h << 13) | (h >> 19);
+  h ^= (uint32)y * 0xC2B2AE35u;  h = (h << 17) | (h >> 15);
+  h ^= h >> 16;  h *= 0x7FEB352Du;
+  h ^= h >> 15;  h *= 0x846CA68Bu;
+  h ^= h >> 16;
+
+  return (Real)(h / (double)0xFFFFFFFFu) * 2 - 1;
+}
+
+// Smoothly interpolated value noise at a point.
+Real
+valueNoise(Real x, Real y, uint32 seed)
+{
+  long ix = (long)std::floor(x), iy = (long)std::floor(y);
+  Real fx = x - ix, fy = y - iy;
+  fx = fx * fx * (3 - 2 * fx);
+  fy = fy * fy * (3 - 2 * fy);
+
+  Real n00 = latticeNoise(ix, iy, seed),     n10 = latticeNoise(ix + 1, iy, seed);
+  Real n01 = latticeNoise(ix, iy + 1, seed), n11 = latticeNoise(ix + 1, iy + 1, seed);
+
+  return (1 - fy) * ((1 - fx) * n00 + fx * n10) + fy * ((1 - fx) * n01 + fx * n11);
+}
+
+// Fractal sum of several octaves of value noise, in roughly [-1, 1].
+Real
+fractalNoise(Real x, Real y, uint32 seed)
+{
+  static int const NUM_OCTAVES = 6;
+
+  Real sum = 0, amplitude = 0.5f, frequency = 4;
+  for (int i = 0; i < NUM_OCTAVES; ++i)
+  {
+    sum += amplitude * valueNoise(frequency * x, frequency * y, seed + (uint32)i);
+    amplitude *= 0.5f;
+    frequency *= 2;
+  }
+
+  return sum;
+}
+
+} // namespace MeshGeneratorInternal
+
+bool
+MeshGenerator::generate(Shape shape, long target_num_faces, Options const & options)
+{
+  using namespace MeshGeneratorInternal;
+
+  clear();
+
+  if (target_num_faces < 1 || target_num_faces > MAX_ELEMENTS / 2)
+  {
+    DGP_ERROR << "MeshGenerator: Target number of faces " << target_num_faces << " is out of range";
+    return false;
+  }
+
+  switch (shape)
+  {
+    case Shape::SPHERE:       generateSphere(target_num_faces); break;
+    case Shape::TORUS:        generateTorus(target_num_faces); break;
+    case Shape::TERRAIN:      generateTerrain(target_num_faces, options); break;
+    case Shape::FAN:          generateFan(target_num_faces, options); break;
+    case Shape::SLIVERS:      generateSlivers(target_num_faces, options); break;
+    case Shape::NONMANIFOLD:  generateNonManifold(target_num_faces, options); break;
+    case Shape::GENUS:        generateGenus(target_num_faces, options); break;
+    default:
+    {
+      DGP_ERROR << "MeshGenerator: Unsupported shape";
+      return false;
+    }
+  }
+
+  if (numVertices() <= 0 || numFaces() <= 0)
+  {
+    DGP_ERROR << "MeshGenerator: Could not generate shape '" << shape.toString() << "' with the given parameters";
+    clear();
+    return false;
+  }
+
+  return true;
+}
+
+void
+MeshGenerator::generateSphere(long target_num_faces)
+{
+  // Each face of an icosahedron is split into n^2 triangles by a regular lattice of frequency n. Lattice points are indexed
+  // in three contiguous blocks -- the 12 original corners, then n - 1 points on each of the 30 edges, then the interior
+  // points of each of the 20 faces -- so that points shared by adjacent faces get the same index without any lookup table.
+
+  static Real const T = (Real)((1 + std::sqrt(5.0)) / 2);
+  static Real const CORNERS[12][3] = { { -1,  T,  0 }, {  1,  T,  0 }, { -1, -T,  0 }, {  1, -T,  0 },
+                                       {  0, -1,  T }, {  0,  1,  T }, {  0, -1, -T }, {  0,  1, -T },
+                                       {  T,  0, -1 }, {  T,  0,  1 }, { -T,  0, -1 }, { -T,  0,  1 } };
+  static int const FACES[20][3] = { { 0, 11,  5 }, { 0,  5,  1 }, {  0,  1,  7 }, {  0,  7, 10 }, { 0, 10, 11 },
+                                    { 1,  5,  9 }, { 5, 11,  4 }, { 11, 10,  2 }, { 10,  7,  6 }, { 7,  1,  8 },
+                                    { 3,  9,  4 }, { 3,  4,  2 }, {  3,  2,  6 }, {  3,  6,  8 }, { 3,  8,  9 },
+                                    { 4,  9,  5 }, { 2,  4, 11 }, {  6,  2, 10 }, {  8,  6,  7 }, { 9,  8,  1 } };
+
+  long n = MeshGeneratorInternal::rootAtLeastOne(target_num_faces / 20.0);
+
+  // Number the edges of the icosahedron
+  int edges[30][2];
+  int num_edges = 0;
+  for (int f = 0; f < 20; ++f)
+    for (int k = 0; k < 3; ++k)
+    {
+      int a = std::min(FACES[f][k], FACES[f][(k + 1) % 3]);
+      int b = std::max(FACES[f][k], FACES[f][(k + 1) % 3]);
+
+      int e = 0;
+      while (e < num_edges && !(edges[e][0] == a && edges[e][1] == b)) ++e;
+      if (e == num_edges)
+      {
+        edges[e][0] = a;
+        edges[e][1] = b;
+        num_edges++;
+      }
+    }
+
+  alwaysAssertM(num_edges == 30, "MeshGenerator: Icosahedron does not have 30 edges");
+
+  long const EDGE_BASE = 12;
+  long const INTERIOR_BASE = EDGE_BASE + 30 * (n - 1);
+  long const NUM_INTERIOR = (n - 1) * (n - 2) / 2;
+  vertices.resize((size_t)(INTERIOR_BASE + 20 * NUM_INTERIOR));
+
+  // Index of the point at lattice distance k from corner p along the edge to corner q
+  struct EdgeIndexer
+  {
+    int const (*edges)[2];
+    long n, base;
+
+    long operator()(int p, int q, long k) const
+    {
+      int e = 0;
+      while (!((edges[e][0] == p && edges[e][1] == q) || (edges[e][0] == q && edges[e][1] == p))) ++e;
+      return base + e * (n - 1) + (p < q ? k : n - k) - 1;
+    }
+  };
+
+  EdgeIndexer edge_index = { edges, n, EDGE_BASE };
+
+  // Positions of corners and edge points
+  for (int c = 0; c < 12; ++c)
+    vertices[(size_t)c] = Vector3(CORNERS[c][0], CORNERS[c][1], CORNERS[c][2]);
+
+  for (int e = 0; e < 30; ++e)
+  {
+    Vector3 const & p = vertices[(size_t)edges[e][0]];
+    Vector3 const & q = vertices[(size_t)edges[e][1]];
+    for (long k = 1; k < n; ++k)
+      vertices[(size_t)(EDGE_BASE + e * (n - 1) + k - 1)] = p + (k / (Real)n) * (q - p);
+  }
+
+  // Positions of face-interior points, and triangles
+  indices.reserve((size_t)(3 * 20 * n * n));
+  std::vector<uint32> lattice((size_t)((n + 1) * (n + 1)));
+  for (int f = 0; f < 20; ++f)
+  {
+    int a = FACES[f][0], b = FACES[f][1], c = FACES[f][2];
+    Vector3 pa = vertices[(size_t)a], pb = vertices[(size_t)b], pc = vertices[(size_t)c];
+
+    long next_interior = INTERIOR_BASE + f * NUM_INTERIOR;
+    for (long j = 0; j <= n; ++j)
+      for (long i = 0; i + j <= n; ++i)
+      {
+        long index;
+        if (i == 0 && j == 0)  index = a;
+        else if (i == n)       index = b;
+        else if (j == n)       index = c;
+        else if (j == 0)       index = edge_index(a, b, i);
+        else if (i == 0)       index = edge_index(a, c, j);
+        else if (i + j == n)   index = edge_index(b, c, j);
+        else
+        {
+          index = next_interior++;
+          vertices[(size_t)index] = pa + (i / (Real)n) * (pb - pa) + (j / (Real)n) * (pc - pa);
+        }
+
+        lattice[(size_t)(j * (n + 1) + i)] = (uint32)index;
+      }
+
+    for (long j = 0; j < n; ++j)
+      for (long i = 0; i + j < n; ++i)
+      {
+        uint32 p00 = lattice[(size_t)(j * (n + 1) + i)];
+        uint32 p10 = lattice[(size_t)(j * (n + 1) + i + 1)];
+        uint32 p01 = lattice[(size_t)((j + 1) * (n + 1) + i)];
+        addTriangle(p00, p10, p01);
+
+        if (i + j + 1 < n)
+        {
+          uint32 p11 = lattice[(size_t)((j + 1) * (n + 1) + i + 1)];
+          addTriangle(p10, p11, p01);
+        }
+      }
+  }
+
+  // Project onto the unit sphere
+  for (size_t i = 0; i < vertices.size(); ++i)
+    vertices[i].unitize();
+}
+
+void
+MeshGenerator::generateTorus(long target_num_faces)
+{
+  static Real const MAJOR_RADIUS = 1.0f;
+  static Real const MINOR_RADIUS = 0.4f;
+
+  // The major circle is twice as finely divided as the minor one, to keep the quads roughly square
+  long nv = MeshGeneratorInternal::rootAtLeastOne(target_num_faces / 4.0);
+  long nu = 2 * nv;
+  nv = std::max(nv, 3L);
+  nu = std::max(nu, 3L);
+
+  vertices.resize((size_t)(nu * nv));
+  for (long i = 0; i < nu; ++i)
+  {
+    Real u = (Real)(2 * Math::pi() * i / nu);
+    for (long j = 0; j < nv; ++j)
+    {
+      Real v = (Real)(2 * Math::pi() * j / nv);
+      Real r = MAJOR_RADIUS + MINOR_RADIUS * std::cos(v);
+      vertices[(size_t)(i * nv + j)] = Vector3(r * std::cos(u), r * std::sin(u), MINOR_RADIUS * std::sin(v));
+    }
+  }
+
+  indices.reserve((size_t)(6 * nu * nv));
+  for (long i = 0; i < nu; ++i)
+    for (long j = 0; j < nv; ++j)
+    {
+      long i1 = (i + 1) % nu, j1 = (j + 1) % nv;
+      addQuad((uint32)(i * nv + j), (uint32)(i1 * nv + j), (uint32)(i1 * nv + j1), (uint32)(i * nv + j1));
+    }
+}
+
+void
+MeshGenerator::generateTerrain(long target_num_faces, Options const & options)
+{
+  long n = MeshGeneratorInternal::rootAtLeastOne(target_num_faces / 2.0);
+
+  vertices.resize((size_t)((n + 1) * (n + 1)));
+  for (long j = 0; j <= n; ++j)
+    for (long i = 0; i <= n; ++i)
+    {
+      Real x = i / (Real)n, y = j / (Real)n;
+      Real z = options.noise * MeshGeneratorInternal::fractalNoise(x, y, options.seed);
+      vertices[(size_t)(j * (n + 1) + i)] = Vector3(x, y, z);
+    }
+
+  indices.reserve((size_t)(6 * n * n));
+  for (long j = 0; j < n; ++j)
+    for (long i = 0; i < n; ++i)
+    {
+      uint32 p00 = (uint32)(j * (n + 1) + i);
+      addQuad(p00, p00 + 1, p00 + 1 + (uint32)(n + 1), p00 + (uint32)(n + 1));
+    }
+}
+
+void
+MeshGenerator::generateFan(long target_num_faces, Options const & options)
+{
+  // A surface of revolution around the z axis with a pole at each end. Each pole is joined to a ring of k vertices, and
+  // r - 1 bands of quads connect r rings in between, for a total of 2kr faces.
+
+  long k = (options.valence > 0 ? options.valence : std::max(target_num_faces / 2, 3L));
+  k = std::max(k, 3L);
+  long r = std::max(target_num_faces / (2 * k), 1L);
+
+  vertices.resize((size_t)(2 + r * k));
+  vertices[0] = Vector3(0, 0, 1);
+  vertices[1] = Vector3(0, 0, -1);
+  for (long ring = 0; ring < r; ++ring)
+  {
+    Real phi = (Real)(Math::pi() * (ring + 1) / (r + 1));
+    Real z = std::cos(phi), rad = std::sin(phi);
+    for (long i = 0; i < k; ++i)
+    {
+      Real theta = (Real)(2 * Math::pi() * i / k);
+      vertices[(size_t)(2 + ring * k + i)] = Vector3(rad * std::cos(theta), rad * std::sin(theta), z);
+    }
+  }
+
+  indices.reserve((size_t)(6 * r * k));
+  for (long i = 0; i < k; ++i)
+  {
+    long i1 = (i + 1) % k;
+    addTriangle(0, (uint32)(2 + i), (uint32)(2 + i1));
+    addTriangle(1, (uint32)(2 + (r - 1) * k + i1), (uint32)(2 + (r - 1) * k + i));
+
+    for (long ring = 0; ring + 1 < r; ++ring)
+    {
+      uint32 a = (uint32)(2 + ring * k), b = (uint32)(2 + (ring + 1) * k);
+      addQuad(a + (uint32)i, b + (uint32)i, b + (uint32)i1, a + (uint32)i1);
+    }
+  }
+}
+
+void
+MeshGenerator::generateSlivers(long target_num_faces, Options const & options)
+{
+  // A square grid of cells, stretched along x by the aspect ratio and bent about the x axis so that it is not planar
+  long n = MeshGeneratorInternal::rootAtLeastOne(target_num_faces / 2.0);
+  Real aspect = std::max(options.aspect_ratio, (Real)1);
+
+  vertices.resize((size_t)((n + 1) * (n + 1)));
+  for (long j = 0; j <= n; ++j)
+  {
+    Real angle = (Real)(0.5 * Math::pi() * (j / (double)n - 0.5));
+    for (long i = 0; i <= n; ++i)
+      vertices[(size_t)(j * (n + 1) + i)] = Vector3(aspect * i / (Real)n, std::sin(angle), std::cos(angle));
+  }
+
+  indices.reserve((size_t)(6 * n * n));
+  for (long j = 0; j < n; ++j)
+    for (long i = 0; i < n; ++i)
+    {
+      uint32 p00 = (uint32)(j * (n + 1) + i);
+      addQuad(p00, p00 + 1, p00 + 1 + (uint32)(n + 1), p00 + (uint32)(n + 1));
+    }
+}
+
+void
+MeshGenerator::generateNonManifold(long target_num_faces, Options const & options)
+{
+  // Each page is a grid of m x m cells in a half-plane bounded by the z axis. The m + 1 vertices on the axis (the spine) are
+  // shared by all pages, so every spine edge has one incident face per page.
+
+  long p = std::max(options.num_pages, 3L);
+  long m = MeshGeneratorInternal::rootAtLeastOne(target_num_faces / (2.0 * p));
+
+  vertices.resize((size_t)((m + 1) + p * m * (m + 1)));
+  for (long z = 0; z <= m; ++z)
+    vertices[(size_t)z] = Vector3(0, 0, z / (Real)m);
+
+  for (long page = 0; page < p; ++page)
+  {
+    Real theta = (Real)(2 * Math::pi() * page / p);
+    Vector3 dir(std::cos(theta), std::sin(theta), 0);
+    for (long r = 1; r <= m; ++r)
+      for (long z = 0; z <= m; ++z)
+        vertices[(size_t)((m + 1) + page * m * (m + 1) + (r - 1) * (m + 1) + z)] = (r / (Real)m) * dir
+                                                                                 + Vector3(0, 0, z / (Real)m);
+  }
+
+  indices.reserve((size_t)(6 * p * m * m));
+  for (long page = 0; page < p; ++page)
+    for (long r = 0; r < m; ++r)
+      for (long z = 0; z < m; ++z)
+      {
+        uint32 a = (uint32)(r == 0 ? z : (m + 1) + page * m * (m + 1) + (r - 1) * (m + 1) + z);
+        uint32 b = (uint32)((m + 1) + page * m * (m + 1) + r * (m + 1) + z);
+        addQuad(a, b, b + 1, a + 1);
+      }
+}
+
+void
+MeshGenerator::generateGenus(long target_num_faces, Options const & options)
+{
+  // The slab is the extrusion of a 2D region of X x Y cells, with g square holes of m x m cells in a row, through Z layers of
+  // cells. Its boundary is emitted directly: top and bottom faces of every cell of the region, and walls along every cell
+  // side that borders a hole or the outside. Vertices on the top and bottom layers, and columns of vertices on the walls, are
+  // created on demand and indexed through dense 2D tables.
+
+  static uint32 const NONE = std::numeric_limits<uint32>::max();
+
+  long g = std::max(options.genus, 0L);
+  long m = MeshGeneratorInternal::rootAtLeastOne(target_num_faces / (4.0 * (5 * g + 3)));
+  long X = (2 * g + 1) * m, Y = 3 * m, Z = std::max(m / 8, 1L);
+
+  struct Region
+  {
+    long g, m, X, Y;
+
+    bool solid(long x, long y) const
+    {
+      if (x < 0 || y < 0 || x >= X || y >= Y)
+        return false;
+
+      if (y >= m && y < 2 * m && (x / m) % 2 == 1 && x / m < 2 * g + 1)
+        return false;
+
+      return true;
+    }
+  };
+
+  Region region = { g, m, X, Y };
+
+  std::vector<uint32> bottom((size_t)((X + 1) * (Y + 1)), NONE);
+  std::vector<uint32> top((size_t)((X + 1) * (Y + 1)), NONE);
+  std::vector<uint32> wall((size_t)((X + 1) * (Y + 1)), NONE);
+
+  struct Indexer
+  {
+    MeshGenerator * gen;
+    std::vector<uint32> * bottom, * top, * wall;
+    long m, Y, Z;
+
+    uint32 operator()(long x, long y, long z)
+    {
+      size_t i = (size_t)(x * (Y + 1) + y);
+      uint32 * slot = (z == 0 ? &(*bottom)[i] : (z == Z ? &(*top)[i] : &(*wall)[i]));
+      if (*slot == NONE)
+      {
+        *slot = (uint32)gen->vertices.size();
+        if (z == 0 || z == Z)
+          gen->vertices.push_back(Vector3(x / (Real)m, y / (Real)m, z / (Real)m));
+        else
+          for (long k = 1; k < Z; ++k)
+            gen->vertices.push_back(Vector3(x / (Real)m, y / (Real)m, k / (Real)m));
+      }
+
+      return (z == 0 || z == Z) ? *slot : *slot + (uint32)(z - 1);
+    }
+  };
+
+  Indexer vtx = { this, &bottom, &top, &wall, m, Y, Z };
+
+  for (long x = 0; x < X; ++x)
+    for (long y = 0; y < Y; ++y)
+    {
+      if (!region.solid(x, y))
+        continue;
+
+      addQuad(vtx(x, y, Z), vtx(x + 1, y, Z), vtx(x + 1, y + 1, Z), vtx(x, y + 1, Z));
+      addQuad(vtx(x, y, 0), vtx(x, y + 1, 0), vtx(x + 1, y + 1, 0), vtx(x + 1, y, 0));
+
+      for (long z = 0; z < Z; ++z)
+      {
+        if (!region.solid(x - 1, y))
+          addQuad(vtx(x, y, z), vtx(x, y, z + 1), vtx(x, y + 1, z + 1), vtx(x, y + 1, z));
+
+        if (!region.solid(x + 1, y))
+          addQuad(vtx(x + 1, y, z), vtx(x + 1, y + 1, z), vtx(x + 1, y + 1, z + 1), vtx(x + 1, y, z + 1));
+
+        if (!region.solid(x, y - 1))
+          addQuad(vtx(x, y, z), vtx(x + 1, y, z), vtx(x + 1, y, z + 1), vtx(x, y, z + 1));
+
+        if (!region.solid(x, y + 1))
+          addQuad(vtx(x, y + 1, z), vtx(x, y + 1, z + 1), vtx(x + 1, y + 1, z + 1), vtx(x + 1, y + 1, z));
+      }
+    }
+}
+
+bool
+MeshGenerator::saveOFF(std::string const & path) const
+{
+  std::ofstream out(path.c_str(), std::ios::binary);
+  if (!out)
+  {
+    DGP_ERROR << "Could not open '" << path << "' for writing";
+    return false;
+  }
+
+  out << "OFF\n";
+  out << numVertices() << ' ' << numFaces() << " 0\n";
+
+  for (size_t i = 0; i < vertices.size(); ++i)
+  {
+    Vector3 const & p = vertices[i];
+    out << p[0] << ' ' << p[1] << ' ' << p[2] << '\n';
+  }
+
+  for (size_t i = 0; i < indices.size(); i += 3)
+    out << "3 " << indices[i] << ' ' << indices[i + 1] << ' ' << indices[i + 2] << '\n';
+
+  if (!out)
+  {
+    DGP_ERROR << "Could not write mesh to '" << path << '\'';
+    return false;
+  }
+
+  return true;
+}
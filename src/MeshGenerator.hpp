@@ -0,0 +1,118 @@
+#ifndef __A2_MeshGenerator_hpp__
+#define __A2_MeshGenerator_hpp__
+
+#include "Common.hpp"
+#include "DGP/Vector3.hpp"
+#include <string>
+#include <vector>
+
+/**
+ * Procedural generator of synthetic triangle meshes of (approximately) a requested size, for scaling and stress benchmarks.
+ * Meshes are produced in a compact indexed form -- single-precision positions and 32-bit indices -- so that instances with
+ * tens of millions of faces can be written straight to disk without building a Mesh.
+ */
+class MeshGenerator
+{
+  public:
+    /** Supported shapes. */
+    struct Shape
+    {
+      /** Supported values. */
+      enum Value
+      {
+        SPHERE,       ///< Geodesic sphere, obtained by uniformly subdividing the faces of an icosahedron.
+        TORUS,        ///< Regularly tessellated torus (genus 1).
+        TERRAIN,      ///< Open height field over a regular grid, displaced by fractal noise.
+        FAN,          ///< Closed spindle whose two poles are fans of very high valence.
+        SLIVERS,      ///< Gently curved open sheet made of long, thin triangles.
+        NONMANIFOLD,  ///< Several sheets ("pages") meeting at a common spine of non-manifold edges and vertices.
+        GENUS         ///< Voxelized slab pierced by a row of holes, of arbitrary genus.
+      };
+
+      DGP_ENUM_CLASS_BODY(Shape)
+
+      DGP_ENUM_CLASS_STRINGS_BEGIN(Shape)
+        DGP_ENUM_CLASS_STRING(SPHERE,       "sphere")
+        DGP_ENUM_CLASS_STRING(TORUS,        "torus")
+        DGP_ENUM_CLASS_STRING(TERRAIN,      "terrain")
+        DGP_ENUM_CLASS_STRING(FAN,          "fan")
+        DGP_ENUM_CLASS_STRING(SLIVERS,      "slivers")
+        DGP_ENUM_CLASS_STRING(NONMANIFOLD,  "nonmanifold")
+        DGP_ENUM_CLASS_STRING(GENUS,        "genus")
+      DGP_ENUM_CLASS_STRINGS_END(Shape)
+    };
+
+    /** Shape-specific generation options. Options that do not apply to the selected shape are ignored. */
+    struct Options
+    {
+      /** Constructor. Sets default values. */
+      Options() : valence(-1), aspect_ratio(100), num_pages(4), genus(3), noise(0.05f), seed(0) {}
+
+      long    valence;       ///< Valence of the two poles of FAN. If non-positive, a single double cone is generated.
+      Real    aspect_ratio;  ///< Ratio of the long side to the short side of each SLIVERS triangle.
+      long    num_pages;     ///< Number of pages meeting at the spine of NONMANIFOLD.
+      long    genus;         ///< Number of holes through the GENUS slab.
+      Real    noise;         ///< Amplitude of the TERRAIN displacement, relative to the size of the grid.
+      uint32  seed;          ///< Seed for the noise of TERRAIN.
+    };
+
+    /**
+     * Generate a shape with approximately \a target_num_faces triangles, replacing any previously generated mesh. The actual
+     * number of faces depends on the granularity with which the shape can be tessellated.
+     *
+     * @return True on success, false if the shape could not be generated with the given parameters.
+     */
+    bool generate(Shape shape, long target_num_faces, Options const & options = Options());
+
+    /** Get the number of vertices of the generated mesh. */
+    long numVertices() const { return (long)vertices.size(); }
+
+    /** Get the number of (triangular) faces of the generated mesh. */
+    long numFaces() const { return (long)(indices.size() / 3); }
+
+    /** Get the position of a vertex. */
+    Vector3 const & getVertex(long i) const { return vertices[(size_t)i]; }
+
+    /** Get the index of the \a j'th corner (0, 1 or 2) of the \a i'th face. */
+    uint32 getFaceVertex(long i, int j) const { return indices[3 * (size_t)i + (size_t)j]; }
+
+    /** Deletes all data in the mesh. */
+    void clear()
+    {
+      vertices.clear();
+      indices.clear();
+    }
+
+    /** Save the generated mesh to an OFF file. */
+    bool saveOFF(std::string const & path) const;
+
+  private:
+    /** Add a triangle to the mesh. */
+    void addTriangle(uint32 i0, uint32 i1, uint32 i2)
+    {
+      indices.push_back(i0);
+      indices.push_back(i1);
+      indices.push_back(i2);
+    }
+
+    /** Add a quadrilateral to the mesh, as two triangles. */
+    void addQuad(uint32 i0, uint32 i1, uint32 i2, uint32 i3)
+    {
+      addTriangle(i0, i1, i2);
+      addTriangle(i0, i2, i3);
+    }
+
+    void generateSphere(long target_num_faces);
+    void generateTorus(long target_num_faces);
+    void generateTerrain(long target_num_faces, Options const & options);
+    void generateFan(long target_num_faces, Options const & options);
+    void generateSlivers(long target_num_faces, Options const & options);
+    void generateNonManifold(long target_num_faces, Options const & options);
+    void generateGenus(long target_num_faces, Options const & options);
+
+    std::vector<Vector3> vertices;  ///< Vertex positions.
+    std::vector<uint32> indices;    ///< Vertex indices of the faces, three per face.
+
+}; // class MeshGenerator
+
+#endif
@@ -0,0 +1,178 @@
+#include "MeshPicker.hpp"
+#include "DGP/LineSegment3.hpp"
+#include "DGP/Triangle3.hpp"
+#include <algorithm>
+#include <vector>
+
+bool
+MeshPicker::Triangle::getVertices(Vector3 & p0, Vector3 & p1, Vector3 & p2) const
+{
+  if (!face || face->numVertices() < (int)index + 3)
+    return false;
+
+  Mesh::Face::VertexConstIterator vi = face->verticesBegin();
+  p0 = (*vi)->getPosition();
+  std::advance(vi, index + 1);
+  p1 = (*vi)->getPosition(); ++vi;
+  p2 = (*vi)->getPosition();
+
+  return true;
+}
+
+AxisAlignedBox3
+MeshPicker::Triangle::getBounds() const
+{
+  Vector3 p0, p1, p2;
+  if (!getVertices(p0, p1, p2))
+    return AxisAlignedBox3(anchor, anchor);
+
+  AxisAlignedBox3 bounds(p0, p0);
+  bounds.merge(p1);
+  bounds.merge(p2);
+  return bounds;
+}
+
+Real
+MeshPicker::Triangle::rayIntersectionTime(Ray3 const & ray, Real max_time) const
+{
+  Vector3 p0, p1, p2;
+  if (!getVertices(p0, p1, p2))
+    return -1;
+
+  Real t = Triangle3Internal::rayTriangleIntersectionTime(ray, p0, p1 - p0, p2 - p0);
+  return (max_time >= 0 && t > max_time) ? -1 : t;
+}
+
+void
+MeshPicker::clear()
+{
+  mesh = NULL;
+  bvh.clear();
+  face_triangles.clear();
+}
+
+void
+MeshPicker::build(Mesh const & mesh_, long num_threads)
+{
+  clear();
+
+  mesh = &mesh_;
+  face_triangles.reserve((size_t)mesh->numFaces());
+
+  std::vector<Triangle> tris;
+  tris.reserve((size_t)mesh->numFaces());
+  for (Mesh::FaceConstIterator fi = mesh->facesBegin(); fi != mesh->facesEnd(); ++fi)
+  {
+    uint32 num_tris = (uint32)std::max(fi->numVertices() - 2, 0);
+    face_triangles[&(*fi)] = TriangleRange((uint32)tris.size(), num_tris);
+
+    for (uint32 i = 0; i < num_tris; ++i)
+    {
+      tris.push_back(Triangle(&(*fi), i));
+      tris.back().anchor = (*fi->verticesBegin())->getPosition();
+    }
+  }
+
+  bvh.add(tris.begin(), tris.end());
+  bvh.init(num_threads);
+}
+
+void
+MeshPicker::update(Mesh::Changes const & changes)
+{
+  if (!mesh)
+    return;
+
+  std::vector<long> changed;
+
+  // Triangles of removed faces stay in the hierarchy (which cannot shrink without a rebuild), but can no longer be hit
+  for (std::unordered_set<Mesh::Face const *>::const_iterator fi = changes.removed_faces.begin();
+       fi != changes.removed_faces.end(); ++fi)
+  {
+    std::unordered_map<Mesh::Face const *, TriangleRange>::iterator existing = face_triangles.find(*fi);
+    if (existing == face_triangles.end())
+      continue;
+
+    TriangleRange range = existing->second;
+    for (uint32 i = range.first; i < range.first + range.second; ++i)
+    {
+      Triangle tri = bvh.getElement((long)i);
+      tri.face = NULL;
+      bvh.setElement((long)i, tri);
+      changed.push_back((long)i);
+    }
+
+    face_triangles.erase(existing);
+  }
+
+  // Faces that were modified, or that contain a vertex that was moved
+  std::vector<Mesh::Face const *> faces(changes.touched_faces.begin(), changes.touched_faces.end());
+  for (std::unordered_set<Mesh::Vertex const *>::const_iterator vi = changes.touched_vertices.begin();
+       vi != changes.touched_vertices.end(); ++vi)
+    faces.insert(faces.end(), (*vi)->facesBegin(), (*vi)->facesEnd());
+
+  std::sort(faces.begin(), faces.end());
+  faces.erase(std::unique(faces.begin(), faces.end()), faces.end());
+
+  for (size_t j = 0; j < faces.size(); ++j)
+  {
+    std::unordered_map<Mesh::Face const *, TriangleRange>::const_iterator existing = face_triangles.find(faces[j]);
+    if (existing == face_triangles.end() || faces[j]->numVertices() <= 0)
+      continue;
+
+    TriangleRange range = existing->second;
+    Vector3 anchor = (*faces[j]->verticesBegin())->getPosition();
+    for (uint32 i = range.first; i < range.first + range.second; ++i)
+    {
+      Triangle tri = bvh.getElement((long)i);
+      tri.anchor = anchor;
+      bvh.setElement((long)i, tri);
+      changed.push_back((long)i);
+    }
+  }
+
+  if (!changed.empty())
+    bvh.refit(changed.begin(), changed.end());
+}
+
+bool
+MeshPicker::pick(Ray3 const & ray, Hit & hit) const
+{
+  if (!mesh)
+    return false;
+
+  Real time = -1;
+  long index = bvh.rayIntersection(ray, -1, &time);
+  if (index < 0)
+    return false;
+
+  hit = Hit();
+  hit.face = bvh.getElement(index).face;
+  hit.time = time;
+  hit.point = ray.getPoint(time);
+
+  Real min_sqdist = -1;
+  for (Mesh::Face::VertexConstIterator vi = hit.face->verticesBegin(); vi != hit.face->verticesEnd(); ++vi)
+  {
+    Real sqdist = ((*vi)->getPosition() - hit.point).squaredLength();
+    if (min_sqdist < 0 || sqdist < min_sqdist)
+    {
+      hit.vertex = *vi;
+      min_sqdist = sqdist;
+    }
+  }
+
+  min_sqdist = -1;
+  for (Mesh::Face::EdgeConstIterator ei = hit.face->edgesBegin(); ei != hit.face->edgesEnd(); ++ei)
+  {
+    LineSegment3 seg((*ei)->getEndpoint(0)->getPosition(), (*ei)->getEndpoint(1)->getPosition());
+    Real sqdist = seg.squaredDistance(hit.point);
+    if (min_sqdist < 0 || sqdist < min_sqdist)
+    {
+      hit.edge = *ei;
+      min_sqdist = sqdist;
+    }
+  }
+
+  return true;
+}
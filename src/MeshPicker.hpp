@@ -0,0 +1,95 @@
+#ifndef __A2_MeshPicker_hpp__
+#define __A2_MeshPicker_hpp__
+
+#include "Common.hpp"
+#include "Mesh.hpp"
+#include "DGP/AxisAlignedBox3.hpp"
+#include "DGP/BVH3.hpp"
+#include "DGP/Noncopyable.hpp"
+#include "DGP/Ray3.hpp"
+#include <unordered_map>
+#include <utility>
+
+/**
+ * Finds the faces, vertices and edges of a mesh under a ray (e.g. the mouse pointer), using a bounding volume hierarchy over the
+ * triangles of the mesh. Faces are split into triangle fans. As the mesh is edited, the hierarchy is refitted to just the
+ * changed faces instead of being rebuilt, so that picking stays fast during interactive decimation.
+ */
+class MeshPicker : private Noncopyable
+{
+  public:
+    /** The result of a pick. */
+    struct Hit
+    {
+      /** Constructor. */
+      Hit() : face(NULL), vertex(NULL), edge(NULL), point(Vector3::zero()), time(-1) {}
+
+      Mesh::Face const * face;      ///< The face hit by the ray.
+      Mesh::Vertex const * vertex;  ///< The vertex of the face closest to the hit point.
+      Mesh::Edge const * edge;      ///< The edge of the face closest to the hit point.
+      Vector3 point;                ///< The hit point.
+      Real time;                    ///< The time at which the ray hits the face.
+    };
+
+    /** Constructor. */
+    MeshPicker() : mesh(NULL) {}
+
+    /** Clear all data. */
+    void clear();
+
+    /**
+     * Build the hierarchy over the faces of a mesh. The mesh must not be destroyed, or edited without the changes being passed
+     * to update(), while the picker is in use.
+     *
+     * @param mesh The mesh to pick from.
+     * @param num_threads The number of threads to use. If non-positive, all available hardware threads are used.
+     */
+    void build(Mesh const & mesh, long num_threads = -1);
+
+    /** Get the mesh the hierarchy was built for, or null if it has not been built. */
+    Mesh const * getMesh() const { return mesh; }
+
+    /**
+     * Update the hierarchy after the mesh has been edited, given the changes made (see Mesh::decimateQuadricEdgeCollapse()).
+     * Removed faces are dropped and the boxes of modified faces, and of the nodes above them, are recomputed. Faces must not have
+     * been added. Passing the same changes more than once is harmless.
+     */
+    void update(Mesh::Changes const & changes);
+
+    /**
+     * Find the first face hit by a ray, with its nearest vertex and edge.
+     *
+     * @return True if the ray hits the mesh, in which case \a hit is filled in.
+     */
+    bool pick(Ray3 const & ray, Hit & hit) const;
+
+  private:
+    /** A triangle of the fan of a face, with vertices 0, index + 1 and index + 2 of the face. */
+    struct Triangle
+    {
+      Triangle(Mesh::Face const * face_ = NULL, uint32 index_ = 0) : face(face_), index(index_), anchor(Vector3::zero()) {}
+
+      /** Get the vertices of the triangle, returning false if the face has been removed or no longer has this triangle. */
+      bool getVertices(Vector3 & p0, Vector3 & p1, Vector3 & p2) const;
+
+      /** Get the bounding box of the triangle, which is a point at the anchor if the triangle no longer exists. */
+      AxisAlignedBox3 getBounds() const;
+
+      /** Get the time at which a ray hits the triangle, or a negative value if it does not. */
+      Real rayIntersectionTime(Ray3 const & ray, Real max_time) const;
+
+      Mesh::Face const * face;  ///< The face, or null if it has been removed.
+      uint32 index;             ///< Index of the triangle in the fan of the face.
+      Vector3 anchor;           ///< Some point of the face when it last existed, to keep the box of a removed triangle in place.
+    };
+
+    /** Range of triangles of a face, as the index of the first triangle and the number of triangles. */
+    typedef std::pair<uint32, uint32> TriangleRange;
+
+    Mesh const * mesh;                                                   ///< The mesh.
+    BVH3<Triangle> bvh;                                                  ///< Hierarchy over the triangles.
+    std::unordered_map<Mesh::Face const *, TriangleRange> face_triangles;  ///< Triangles of each face.
+
+}; // class MeshPicker
+
+#endif
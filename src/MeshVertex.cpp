@@ -1,26 +1,58 @@
 #include "MeshVertex.hpp"
+#include "FacePlanes.hpp"
 #include "MeshEdge.hpp"
 #include "MeshFace.hpp"
 
+namespace MeshVertexInternal {
+
+// Add the quadric of the plane ax + by + cz + d = 0 to a sum
+inline void
+addPlaneQuadric(DMat4 & sum, Real a, Real b, Real c, Real d)
+{
+  sum += DMat4(a*a, a*b, a*c, a*d,
+               b*a, b*b, b*c, b*d,
+               c*a, c*b, c*c, c*d,
+               d*a, d*b, d*c, d*d);
+}
+
+} // namespace MeshVertexInternal
+
 void
-MeshVertex::updateQuadric()
+MeshVertex::updateQuadric(QuadricFrame const & frame)
 {
-  quadric = DMat4::zero();
+  using namespace MeshVertexInternal;
+
+  DMat4 sum = DMat4::zero();  // accumulate in double precision whatever the storage precision
   for (FaceConstIterator fi = facesBegin(); fi != facesEnd(); ++fi)
   {
     Face const * face = *fi;
     if (face->numVertices() <= 0)
       continue;
 
-    Vector3 abc = face->getNormal().unit();
-    Real a = abc[0], b = abc[1], c = abc[2];
-    Real d = -abc.dot((*face->verticesBegin())->getPosition());
+    // One plane per face, through its first vertex, as in FacePlanes::compute()
+    Vector3 abc = face->getNormal();  // unit length, or zero for a degenerate face
+    addPlaneQuadric(sum, abc[0], abc[1], abc[2], -abc.dot(frame.toLocal((*face->verticesBegin())->getPosition())));
+  }
+
+  quadric = quadricCast<QuadricReal>(sum);
+}
+
+void
+MeshVertex::updateQuadric(FacePlanes const & planes, long index)
+{
+  using namespace MeshVertexInternal;
+
+  debugAssertM(planes.beginRow(index + 1) - planes.beginRow(index) == numFaces(),
+               "MeshVertex: Table of planes is out of date");
 
-    quadric += DMat4(a*a, a*b, a*c, a*d,
-                     b*a, b*b, b*c, b*d,
-                     c*a, c*b, c*c, c*d,
-                     d*a, d*b, d*c, d*d);
+  DMat4 sum = DMat4::zero();
+  for (long i = planes.beginRow(index); i < planes.beginRow(index + 1); ++i)
+  {
+    Vector3 abc = planes.getNormal(i);
+    addPlaneQuadric(sum, abc[0], abc[1], abc[2], planes.getOffset(i));
   }
+
+  quadric = quadricCast<QuadricReal>(sum);
 }
 
 MeshEdge *
@@ -48,14 +80,6 @@ MeshVertex::isBoundary() const
   return false;
 }
 
-void
-MeshVertex::addFace(Face * face, bool update_normal)
-{
-  faces.push_back(face);
-  if (update_normal && !has_precomputed_normal)
-    addFaceNormal(face->getNormal());
-}
-
 void
 MeshVertex::removeFace(Face * face)
 {
@@ -64,7 +88,7 @@ MeshVertex::removeFace(Face * face)
     if (*fi == face)
     {
       fi = faces.erase(fi);
-      if (!has_precomputed_normal) removeFaceNormal(face->getNormal());
+      invalidateNormal();
 
       // Keep going, just in case the face somehow got added twice
     }
@@ -74,22 +98,74 @@ MeshVertex::removeFace(Face * face)
 }
 
 void
-MeshVertex::updateNormal()
+MeshVertex::setPosition(Vector3 const & position_)
 {
-  if (!faces.empty())
-  {
-    Vector3 sum_normals = Vector3::zero();
-    for (FaceConstIterator fi = faces.begin(); fi != faces.end(); ++fi)
-      sum_normals += (*fi)->getNormal();  // weight by face area?
+  position = position_;
 
-    normal_normalization_factor = sum_normals.length();
-    setNormal(normal_normalization_factor < 1e-20f ? Vector3::zero() : sum_normals / normal_normalization_factor);
-  }
-  else
-  {
-    setNormal(Vector3::zero());
-    normal_normalization_factor = 0;
-  }
+#if A2_MESH_ATTRIBUTES == A2_MESH_ATTRIBUTES_FULL
+  for (FaceIterator fi = faces.begin(); fi != faces.end(); ++fi)
+    (*fi)->invalidateNormal();
+#endif
+}
+
+#if A2_MESH_ATTRIBUTES == A2_MESH_ATTRIBUTES_FULL
 
+void
+MeshVertex::updateNormal()
+{
   has_precomputed_normal = false;
+  recomputeNormal();
+}
+
+#endif
+
+Vector3
+MeshVertex::computeNormal() const
+{
+  Vector3 sum_normals = Vector3::zero();
+  for (FaceConstIterator fi = faces.begin(); fi != faces.end(); ++fi)
+    sum_normals += (*fi)->getNormal();  // weight by face area?
+
+  Real len = sum_normals.length();
+  return (len < 1e-20f ? Vector3::zero() : sum_normals / len);
+}
+
+void
+MeshVertex::serialize(BinaryOutputStream & output) const
+{
+  output.writeVector3(position);
+
+#if A2_MESH_ATTRIBUTES == A2_MESH_ATTRIBUTES_FULL
+  output.writeVector3(normal);
+  output.writeColorRGBA(color);
+  output.writeBool8(has_precomputed_normal);
+  output.writeBool8(normal_dirty);
+#endif
+
+  for (int i = 0; i < 4; ++i)
+    for (int j = 0; j < 4; ++j)
+    {
+      if (sizeof(QuadricReal) == sizeof(float32))
+        output.writeFloat32((float32)quadric(i, j));
+      else
+        output.writeFloat64((float64)quadric(i, j));
+    }
+}
+
+void
+MeshVertex::deserialize(BinaryInputStream & input)
+{
+  position = input.readVector3();
+
+#if A2_MESH_ATTRIBUTES == A2_MESH_ATTRIBUTES_FULL
+  normal = input.readVector3();
+  color = input.readColorRGBA();
+  has_precomputed_normal = input.readBool8();
+  normal_dirty = input.readBool8();
+#endif
+
+  for (int i = 0; i < 4; ++i)
+    for (int j = 0; j < 4; ++j)
+      quadric(i, j) = (sizeof(QuadricReal) == sizeof(float32) ? (QuadricReal)input.readFloat32()
+                                                               : (QuadricReal)input.readFloat64());
 }
@@ -13,11 +13,16 @@
 #define __A2_MeshVertex_hpp__
 
 #include "Common.hpp"
+#include "DGP/BinaryInputStream.hpp"
+#include "DGP/BinaryOutputStream.hpp"
+#include "QuadricFrame.hpp"
 #include "DGP/Colors.hpp"
+#include "DGP/Spinlock.hpp"
 #include "DGP/Vector3.hpp"
 #include <list>
 
 // Forward declarations
+class FacePlanes;
 class MeshEdge;
 class MeshFace;
 
@@ -38,22 +43,34 @@ class MeshVertex
     typedef typename FaceList::iterator        FaceIterator;       ///< Iterator over faces.
     typedef typename FaceList::const_iterator  FaceConstIterator;  ///< Const iterator over faces.
 
+#if A2_MESH_ATTRIBUTES == A2_MESH_ATTRIBUTES_FULL
+
     /** Default constructor. */
     MeshVertex()
     : position(Vector3::zero()), normal(Vector3::zero()), color(ColorRGBA(1, 1, 1, 1)), has_precomputed_normal(false),
-      normal_normalization_factor(0), quadric(DMat4::zero()) {}
+      normal_dirty(true), quadric(QuadricMatrix::zero()) {}
 
     /** Sets the vertex to have a given location. */
     explicit MeshVertex(Vector3 const & p)
-    : position(p), normal(Vector3::zero()), color(ColorRGBA(1, 1, 1, 1)), has_precomputed_normal(false),
-      normal_normalization_factor(0), quadric(DMat4::zero())
+    : position(p), normal(Vector3::zero()), color(ColorRGBA(1, 1, 1, 1)), has_precomputed_normal(false), normal_dirty(true),
+      quadric(QuadricMatrix::zero())
     {}
 
     /** Sets the vertex to have a location, normal and color. */
     MeshVertex(Vector3 const & p, Vector3 const & n, ColorRGBA const & c = ColorRGBA(1, 1, 1, 1))
-    : position(p), normal(n), color(c), has_precomputed_normal(true), normal_normalization_factor(0), quadric(DMat4::zero())
+    : position(p), normal(n), color(c), has_precomputed_normal(true), normal_dirty(false), quadric(QuadricMatrix::zero())
     {}
 
+#else
+
+    /** Default constructor. */
+    MeshVertex() : position(Vector3::zero()), quadric(QuadricMatrix::zero()) {}
+
+    /** Sets the vertex to have a given location. */
+    explicit MeshVertex(Vector3 const & p) : position(p), quadric(QuadricMatrix::zero()) {}
+
+#endif
+
     /**
      * Get the number of edges incident on the vertex. Equivalent to degree().
      *
@@ -131,14 +148,27 @@ class MeshVertex
     /** Get the position of the vertex. */
     Vector3 const & getPosition() const { return position; }
 
-    /** Set the position of the vertex. */
-    void setPosition(Vector3 const & position_) { position = position_; }
+    /**
+     * Set the position of the vertex. The normals of all incident faces, and of the vertices of these faces, are marked as
+     * needing recomputation.
+     */
+    void setPosition(Vector3 const & position_);
+
+#if A2_MESH_ATTRIBUTES == A2_MESH_ATTRIBUTES_FULL
 
-    /** Get the normal at the vertex. */
-    Vector3 const & getNormal() const { return normal; }
+    /**
+     * Get the normal at the vertex. If the normal is out of date, it is recomputed from the incident faces first. This lazy
+     * update is not threadsafe: to read normals from multiple threads, first bring them all up to date with
+     * Mesh::updateNormals().
+     */
+    Vector3 const & getNormal() const
+    {
+      if (normal_dirty) recomputeNormal();
+      return normal;
+    }
 
     /** Set the normal at the vertex. */
-    void setNormal(Vector3 const & normal_) { normal = normal_; }
+    void setNormal(Vector3 const & normal_) { normal = normal_; normal_dirty = false; }
 
     /** Check if the vertex has a precomputed normal. */
     bool hasPrecomputedNormal() const { return has_precomputed_normal; }
@@ -149,20 +179,58 @@ class MeshVertex
      */
     void updateNormal();
 
+    /** Check if the vertex normal is out of date and will be recomputed when next requested. */
+    bool isNormalDirty() const { return normal_dirty; }
+
+    /**
+     * Mark the vertex normal as out of date, so that it is recomputed from face data when next requested. Has no effect if the
+     * vertex has a precomputed normal.
+     */
+    void invalidateNormal() { if (!has_precomputed_normal) normal_dirty = true; }
+
     /** Get the color of the vertex. */
     ColorRGBA const & getColor() const { return color; }
 
     /** Set the color of the vertex. */
     void setColor(ColorRGBA const & color_) { color = color_; }
 
-    /** Get the quadric error matrix for this vertex. */
-    DMat4 const & getQuadric() const { return quadric; }
+#else
+
+    /** Get the normal at the vertex, computed from the incident faces (the normal is not stored). Threadsafe. */
+    Vector3 getNormal() const { return computeNormal(); }
+
+    /** Does nothing, since the normal is not stored. */
+    void invalidateNormal() {}
+
+    /** Get the color of the vertex, which is always white (colors are not stored). */
+    ColorRGBA const & getColor() const { static ColorRGBA const WHITE(1, 1, 1, 1); return WHITE; }
+
+#endif
+
+    /** Get the quadric error matrix for this vertex, in the frame it was computed in (see Mesh::getQuadricFrame()). */
+    QuadricMatrix const & getQuadric() const { return quadric; }
 
     /** Manually set the quadric error matrix for this vertex. */
-    void setQuadric(DMat4 const & q) { quadric = q; }
+    void setQuadric(QuadricMatrix const & q) { quadric = q; }
+
+    /** Recompute the quadric error matrix for this vertex, in a given coordinate frame. */
+    void updateQuadric(QuadricFrame const & frame = QuadricFrame());
 
-    /** Recompute the quadric error matrix for this vertex. */
-    void updateQuadric();
+    /**
+     * Recompute the quadric error matrix for this vertex from a table of the planes of its faces, which must be up to date.
+     * The quadric is in the frame the table was computed in, and is the same as that computed by updateQuadric() in that
+     * frame, without recomputing the planes.
+     *
+     * @param planes The table of planes.
+     * @param index The position of this vertex in the sequence the table was computed for (see FacePlanes::compute()).
+     */
+    void updateQuadric(FacePlanes const & planes, long index);
+
+    /** Write the attributes of the vertex, but not its references to edges and faces, to a binary stream. Values are exact. */
+    void serialize(BinaryOutputStream & output) const;
+
+    /** Read the attributes of the vertex, but not its references to edges and faces, from a binary stream. */
+    void deserialize(BinaryInputStream & input);
 
   private:
     friend class Mesh;
@@ -194,7 +262,7 @@ class MeshVertex
     }
 
     /** Add a reference to a face incident at this vertex. */
-    void addFace(Face * face, bool update_normal = true);
+    void addFace(Face * face) { faces.push_back(face); invalidateNormal(); }
 
     /** Remove all references to a face incident at this vertex. */
     void removeFace(Face * face);
@@ -207,46 +275,30 @@ class MeshVertex
           *fi = new_face;
     }
 
-    /**
-     * Add (accumulate) normal information from a new face at this vertex, unless the vertex has a precomputed normal.
-     *
-     * @param n Unit (or weighted) normal of the new face.
-     */
-    void addFaceNormal(Vector3 const & n)
-    {
-      if (!has_precomputed_normal)
-      {
-        Vector3 sum_normals = normal_normalization_factor * getNormal() + n;
-        normal_normalization_factor = sum_normals.length();
-        setNormal(normal_normalization_factor < 1e-20f ? Vector3::zero() : sum_normals / normal_normalization_factor);
-      }
-    }
+    /** Compute the normal from the incident faces. */
+    Vector3 computeNormal() const;
 
-    /**
-     * Remove (subtract) normal information from a new face at this vertex, unless the vertex has a precomputed normal.
-     *
-     * @param n Unit (or weighted) normal of the face to be removed.
-     */
-    void removeFaceNormal(Vector3 const & n)
-    {
-      if (!has_precomputed_normal)
-      {
-        Vector3 sum_normals = normal_normalization_factor * getNormal() - n;
-        normal_normalization_factor = sum_normals.length();
-        setNormal(normal_normalization_factor < 1e-20f ? Vector3::zero() : sum_normals / normal_normalization_factor);
-      }
-    }
+#if A2_MESH_ATTRIBUTES == A2_MESH_ATTRIBUTES_FULL
+
+    /** Recompute the normal from the incident faces, without changing whether the vertex has a precomputed normal. */
+    void recomputeNormal() const { normal = computeNormal(); normal_dirty = false; }
+
+#endif
 
     Vector3 position;
-    Vector3 normal;
-    ColorRGBA color;
+    Spinlock collapse_lock;  // held by a thread of Mesh::decimateConcurrent() while it edits this vertex or its neighborhood
     EdgeList edges;
     FaceList faces;
+
+#if A2_MESH_ATTRIBUTES == A2_MESH_ATTRIBUTES_FULL
+    mutable Vector3 normal;
+    ColorRGBA color;
     bool has_precomputed_normal;
-    float normal_normalization_factor;
+    mutable bool normal_dirty;
+#endif
 
     // Quadric error-specific
-    DMat4 quadric;
+    QuadricMatrix quadric;
 
 }; // class MeshVertex
 
@@ -0,0 +1,108 @@
+#ifndef __A2_MultiQueue_hpp__
+#define __A2_MultiQueue_hpp__
+
+#include "Common.hpp"
+#include "DGP/Noncopyable.hpp"
+#include "DGP/Random.hpp"
+#include "DGP/Spinlock.hpp"
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <vector>
+
+/**
+ * A relaxed priority queue that many threads can push to and pop from at once: the MultiQueue of Rihani, Sanders and Dementiev.
+ * Values are kept in several binary heaps, each behind its own spinlock. A value is pushed onto a random heap, and popped from
+ * whichever of two random heaps has the smaller top. With a few heaps per thread, threads rarely wait for each other, at the
+ * cost of values coming out only roughly in order of priority. Smaller priorities come out first.
+ *
+ * Each thread should use its own random number generator, created with <code>threadsafe = false</code>.
+ */
+template <typename T>
+class MultiQueue : private Noncopyable
+{
+  public:
+    /** Constructor. About twice as many heaps as threads is usually enough. */
+    explicit MultiQueue(long num_heaps) : heaps((size_t)std::max(num_heaps, 2L)), num_values(0) {}
+
+    /** Get the number of values in the queue. This is only a snapshot if other threads are using the queue. */
+    long size() const { return num_values.load(); }
+
+    /** Check if the queue is empty. This is only a snapshot if other threads are using the queue. */
+    bool empty() const { return size() <= 0; }
+
+    /** Add a value with a given priority. */
+    void push(T const & value, double priority, Random & rng)
+    {
+      Heap & heap = heaps[(size_t)rng.integer(0, (int32)heaps.size() - 1)];
+      Entry entry = { priority, value };
+
+      ++num_values;
+
+      heap.lock.lock();
+      heap.entries.push_back(entry);
+      std::push_heap(heap.entries.begin(), heap.entries.end());
+      heap.top = heap.entries.front().priority;
+      heap.lock.unlock();
+    }
+
+    /**
+     * Remove a value with a small priority, namely the smaller of the top values of two random heaps.
+     *
+     * @return True if a value was removed, false if the queue is empty.
+     */
+    bool pop(T & value, double & priority, Random & rng)
+    {
+      while (!empty())
+      {
+        Heap & h0 = heaps[(size_t)rng.integer(0, (int32)heaps.size() - 1)];
+        Heap & h1 = heaps[(size_t)rng.integer(0, (int32)heaps.size() - 1)];
+        Heap & heap = (h1.top.load() < h0.top.load() ? h1 : h0);
+
+        heap.lock.lock();
+        if (heap.entries.empty())  // emptied since its top was read, or was empty all along
+        {
+          heap.lock.unlock();
+          continue;
+        }
+
+        std::pop_heap(heap.entries.begin(), heap.entries.end());
+        value = heap.entries.back().value;
+        priority = heap.entries.back().priority;
+        heap.entries.pop_back();
+        heap.top = (heap.entries.empty() ? std::numeric_limits<double>::infinity() : heap.entries.front().priority);
+        heap.lock.unlock();
+
+        --num_values;
+        return true;
+      }
+
+      return false;
+    }
+
+  private:
+    /** A value with its priority, ordered so that std::push_heap() and std::pop_heap() keep the smallest priority on top. */
+    struct Entry
+    {
+      double priority;  ///< Priority of the value.
+      T value;          ///< The value.
+
+      bool operator<(Entry const & rhs) const { return priority > rhs.priority; }
+    };
+
+    /** One of the heaps. */
+    struct Heap
+    {
+      Heap() : top(std::numeric_limits<double>::infinity()) {}
+
+      Spinlock lock;               ///< Protects the entries.
+      std::vector<Entry> entries;  ///< The entries, as a binary heap.
+      std::atomic<double> top;     ///< Smallest priority in the heap, or infinity if the heap is empty.
+    };
+
+    std::vector<Heap> heaps;        ///< The heaps.
+    std::atomic<long> num_values;   ///< Number of values in all heaps.
+
+}; // class MultiQueue
+
+#endif
@@ -0,0 +1,758 @@
+#include "ProgressiveMesh.hpp"
+#include "Mesh.hpp"
+#include "DGP/Graphics/GLCaps.hpp"
+#include "DGP/Triangle3.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <unordered_map>
+
+uint32 const ProgressiveMesh::NONE = (uint32)(-1);
+
+ProgressiveMesh::ProgressiveMesh()
+: level(0), num_faces(0), uniform(true)
+{}
+
+void
+ProgressiveMesh::clear()
+{
+  positions.clear();
+  face_offsets.clear();
+  face_sizes.clear();
+  face_vertices.clear();
+  collapses.clear();
+  face_changes.clear();
+  change_vertices.clear();
+  vertex_changes.clear();
+  collapse_parents.clear();
+  collapse_children.clear();
+  level_num_faces.clear();
+  level = 0;
+  num_faces = 0;
+  uniform = true;
+
+  applied.clear();
+  num_applied_children.clear();
+  num_undone_parents.clear();
+  front.clear();
+  front_position.clear();
+
+  changed_vertices.clear();
+  changed_faces.clear();
+  render_cache.valid = false;
+}
+
+void
+ProgressiveMesh::build(Mesh & mesh, long min_num_faces, ProgressReporter * progress)
+{
+  clear();
+
+  // Number the vertices and faces of the original mesh. Decimation only modifies and removes elements, so pointers stay unique.
+  std::unordered_map<Mesh::Vertex const *, uint32> vertex_ids;
+  vertex_ids.reserve((size_t)mesh.numVertices());
+  positions.reserve((size_t)mesh.numVertices());
+  for (Mesh::VertexConstIterator vi = mesh.verticesBegin(); vi != mesh.verticesEnd(); ++vi)
+  {
+    vertex_ids[&(*vi)] = (uint32)positions.size();
+    positions.push_back(vi->getPosition());
+  }
+
+  std::unordered_map<Mesh::Face const *, uint32> face_ids;
+  face_ids.reserve((size_t)mesh.numFaces());
+  for (Mesh::FaceConstIterator fi = mesh.facesBegin(); fi != mesh.facesEnd(); ++fi)
+  {
+    face_ids[&(*fi)] = (uint32)face_sizes.size();
+    face_offsets.push_back((uint32)face_vertices.size());
+    face_sizes.push_back((uint32)fi->numVertices());
+
+    for (Mesh::Face::VertexConstIterator fvi = fi->verticesBegin(); fvi != fi->verticesEnd(); ++fvi)
+      face_vertices.push_back(vertex_ids[*fvi]);
+  }
+
+  level_num_faces.push_back(mesh.numFaces());
+
+  // Decimate, recording how each collapse changes the faces and vertices. The current state (positions, face_vertices etc.) is
+  // kept in sync with the mesh, and gives the "before" state of each change.
+  long initial_num_faces = mesh.numFaces();
+  if (progress)
+    progress->begin(std::max(initial_num_faces - min_num_faces, 0L));
+
+  // The last collapse to change each face and vertex, on which the next collapse to change it depends
+  std::vector<uint32> last_face_collapse(face_sizes.size(), NONE);
+  std::vector<uint32> last_vertex_collapse(positions.size(), NONE);
+
+  Mesh::Changes changes;
+  std::vector<uint32> new_vertices, collapse_vertices;
+  std::vector<Vector3> region;
+  std::vector<LocalTriangle3> tris;
+  while (mesh.numFaces() > min_num_faces)
+  {
+    // A collapse that removed the last faces of a component leaves no retained vertex, but is recorded like any other
+    changes.clear();
+    Mesh::CollapseStatus status;
+    Mesh::Vertex const * retained = mesh.decimateQuadricEdgeCollapse(&changes, &status);
+    if (status == Mesh::NO_EDGES_LEFT)
+      break;
+    else if (status == Mesh::EDGE_SKIPPED || changes.isEmpty())
+      continue;
+
+    Collapse collapse;
+    collapse.faces_begin = (uint32)face_changes.size();
+    collapse.vertices_begin = (uint32)vertex_changes.size();
+
+    // Faces that were modified, followed by faces that were removed (which now have no vertices)
+    std::vector<std::pair<uint32, Mesh::Face const *> > changed;
+    for (std::unordered_set<Mesh::Face const *>::const_iterator fi = changes.touched_faces.begin();
+         fi != changes.touched_faces.end(); ++fi)
+      changed.push_back(std::make_pair(face_ids[*fi], *fi));
+
+    for (std::unordered_set<Mesh::Face const *>::const_iterator fi = changes.removed_faces.begin();
+         fi != changes.removed_faces.end(); ++fi)
+      changed.push_back(std::make_pair(face_ids[*fi], (Mesh::Face const *)NULL));
+
+    // Process faces in index order so that the recorded sequence does not depend on hash table iteration order
+    std::sort(changed.begin(), changed.end());
+
+    for (size_t i = 0; i < changed.size(); ++i)
+    {
+      uint32 f = changed[i].first;
+      Mesh::Face const * face = changed[i].second;
+
+      new_vertices.clear();
+      if (face)
+      {
+        for (Mesh::Face::VertexConstIterator fvi = face->verticesBegin(); fvi != face->verticesEnd(); ++fvi)
+          new_vertices.push_back(vertex_ids[*fvi]);
+      }
+
+      uint32 * current = &face_vertices[face_offsets[f]];
+      if (new_vertices.size() == face_sizes[f] && std::equal(new_vertices.begin(), new_vertices.end(), current))
+        continue;
+
+      FaceChange fc;
+      fc.face = f;
+      fc.old_begin = (uint32)change_vertices.size();
+      fc.old_size = face_sizes[f];
+      change_vertices.insert(change_vertices.end(), current, current + face_sizes[f]);
+      fc.new_begin = (uint32)change_vertices.size();
+      fc.new_size = (uint32)new_vertices.size();
+      change_vertices.insert(change_vertices.end(), new_vertices.begin(), new_vertices.end());
+      face_changes.push_back(fc);
+
+      std::copy(new_vertices.begin(), new_vertices.end(), current);
+      face_sizes[f] = (uint32)new_vertices.size();
+    }
+
+    // Region covered by the faces before the collapse
+    region.clear();
+    for (uint32 i = collapse.faces_begin; i < (uint32)face_changes.size(); ++i)
+    {
+      FaceChange const & fc = face_changes[i];
+      for (uint32 j = 0; j < fc.old_size; ++j)
+        region.push_back(positions[change_vertices[fc.old_begin + j]]);
+    }
+
+    // Vertices that were moved, also in index order
+    std::vector<std::pair<uint32, Mesh::Vertex const *> > moved;
+    for (std::unordered_set<Mesh::Vertex const *>::const_iterator vi = changes.touched_vertices.begin();
+         vi != changes.touched_vertices.end(); ++vi)
+    {
+      uint32 v = vertex_ids[*vi];
+      if ((*vi)->getPosition() != positions[v])
+        moved.push_back(std::make_pair(v, *vi));
+    }
+
+    std::sort(moved.begin(), moved.end());
+
+    for (size_t i = 0; i < moved.size(); ++i)
+    {
+      VertexChange vc;
+      vc.vertex = moved[i].first;
+      vc.old_position = positions[vc.vertex];
+      vc.new_position = moved[i].second->getPosition();
+      vertex_changes.push_back(vc);
+
+      positions[vc.vertex] = vc.new_position;
+    }
+
+    collapse.faces_end = (uint32)face_changes.size();
+    collapse.vertices_end = (uint32)vertex_changes.size();
+
+    // The collapse depends on the last collapses to change its faces and vertices, including vertices it removes and the
+    // retained vertex even if it did not move
+    uint32 index = (uint32)collapses.size();
+    collapse_vertices.clear();
+    for (uint32 i = collapse.vertices_begin; i < collapse.vertices_end; ++i)
+      collapse_vertices.push_back(vertex_changes[i].vertex);
+
+    for (std::unordered_set<Mesh::Vertex const *>::const_iterator vi = changes.removed_vertices.begin();
+         vi != changes.removed_vertices.end(); ++vi)
+      collapse_vertices.push_back(vertex_ids[*vi]);
+
+    if (retained)
+      collapse_vertices.push_back(vertex_ids[retained]);
+
+    collapse.parents_begin = (uint32)collapse_parents.size();
+    for (uint32 i = collapse.faces_begin; i < collapse.faces_end; ++i)
+    {
+      uint32 & last = last_face_collapse[face_changes[i].face];
+      if (last != NONE) collapse_parents.push_back(last);
+      last = index;
+    }
+
+    for (size_t i = 0; i < collapse_vertices.size(); ++i)
+    {
+      // The retained vertex may also be listed as moved
+      uint32 & last = last_vertex_collapse[collapse_vertices[i]];
+      if (last != NONE && last != index) collapse_parents.push_back(last);
+      last = index;
+    }
+
+    std::sort(collapse_parents.begin() + collapse.parents_begin, collapse_parents.end());
+    collapse_parents.erase(std::unique(collapse_parents.begin() + collapse.parents_begin, collapse_parents.end()),
+                           collapse_parents.end());
+    collapse.parents_end = (uint32)collapse_parents.size();
+
+    // Region covered by the faces after the collapse, and the simplified surface as triangles
+    tris.clear();
+    for (uint32 i = collapse.faces_begin; i < collapse.faces_end; ++i)
+    {
+      FaceChange const & fc = face_changes[i];
+      uint32 const * fv = &change_vertices[0] + fc.new_begin;
+      for (uint32 j = 0; j < fc.new_size; ++j)
+      {
+        region.push_back(positions[fv[j]]);
+        if (j >= 2)
+          tris.push_back(LocalTriangle3(positions[fv[0]], positions[fv[j - 1]], positions[fv[j]]));
+      }
+    }
+
+    collapse.bounds = AxisAlignedBox3();
+    for (size_t i = 0; i < region.size(); ++i)
+      collapse.bounds.merge(region[i]);
+
+    Vector3 center = (retained ? positions[vertex_ids[retained]] : collapse.bounds.getCenter());
+
+    // The error is the largest distance from a vertex that was removed or moved, at its old position, to the simplified surface
+    // (or to the retained vertex, if the collapse left no surface)
+    collapse.error = 0;
+    for (size_t i = 0; i < collapse_vertices.size(); ++i)
+    {
+      uint32 v = collapse_vertices[i];
+      Vector3 p = positions[v];
+      for (uint32 j = collapse.vertices_begin; j < collapse.vertices_end; ++j)
+        if (vertex_changes[j].vertex == v)
+          p = vertex_changes[j].old_position;
+
+      Real dist = (p - center).length();
+      for (size_t j = 0; j < tris.size(); ++j)
+        dist = std::min(dist, tris[j].distance(p));
+
+      collapse.error = std::max(collapse.error, dist);
+    }
+
+    collapse.num_removed = 0;
+    for (uint32 i = collapse.faces_begin; i < collapse.faces_end; ++i)
+      if (face_changes[i].old_size >= 3 && face_changes[i].new_size < 3)
+        collapse.num_removed++;
+    collapses.push_back(collapse);
+    level_num_faces.push_back(mesh.numFaces());
+
+    if (progress)
+      progress->update(initial_num_faces - mesh.numFaces());
+  }
+
+  if (progress)
+    progress->end(initial_num_faces - mesh.numFaces());
+
+  level = (long)collapses.size();
+  num_faces = level_num_faces.back();
+  uniform = true;
+  buildHierarchy();
+
+  render_cache.valid = false;
+}
+
+void
+ProgressiveMesh::buildHierarchy()
+{
+  size_t n = collapses.size();
+
+  // Dependents of each collapse, by counting sort of the dependencies
+  std::vector<uint32> num_children(n + 1, 0);
+  for (size_t i = 0; i < collapse_parents.size(); ++i)
+    num_children[collapse_parents[i]]++;
+
+  uint32 offset = 0;
+  for (size_t i = 0; i < n; ++i)
+  {
+    collapses[i].children_begin = collapses[i].children_end = offset;
+    offset += num_children[i];
+  }
+
+  collapse_children.resize(collapse_parents.size());
+  for (size_t i = 0; i < n; ++i)
+    for (uint32 j = collapses[i].parents_begin; j < collapses[i].parents_end; ++j)
+      collapse_children[collapses[collapse_parents[j]].children_end++] = (uint32)i;
+
+  // A collapse must bound, and be at least as coarse as, the collapses it depends on. Otherwise refinement could stop at a
+  // coarse collapse that looks accurate enough even though finer ones below it do not.
+  for (size_t i = 0; i < n; ++i)
+  {
+    Collapse & c = collapses[i];
+    for (uint32 j = c.parents_begin; j < c.parents_end; ++j)
+    {
+      Collapse const & p = collapses[collapse_parents[j]];
+      c.bounds.merge(p.bounds);
+      c.error = std::max(c.error, p.error);
+    }
+  }
+
+  // All collapses are applied, and those that nothing depends on can be undone
+  applied.assign(n, 1);
+  num_undone_parents.assign(n, 0);
+  num_applied_children.resize(n);
+  front.clear();
+  front_position.assign(n, NONE);
+  for (size_t i = 0; i < n; ++i)
+  {
+    num_applied_children[i] = collapses[i].children_end - collapses[i].children_begin;
+    updateFront((uint32)i);
+  }
+}
+
+long
+ProgressiveMesh::levelForNumFaces(long num_faces) const
+{
+  if (level_num_faces.empty())
+    return 0;
+
+  // The number of faces does not increase from one level to the next
+  std::vector<long>::const_iterator loc = std::lower_bound(level_num_faces.begin(), level_num_faces.end(), num_faces,
+                                                           std::greater<long>());
+  if (loc == level_num_faces.end())
+    return numLevels() - 1;
+
+  return (long)(loc - level_num_faces.begin());
+}
+
+void
+ProgressiveMesh::setLevel(long new_level)
+{
+  new_level = std::max(0L, std::min(new_level, numLevels() - 1));
+
+  if (uniform)
+  {
+    while (level < new_level)
+      applyCollapse((uint32)level);
+
+    while (level > new_level)
+      undoCollapse((uint32)(level - 1));
+  }
+  else
+  {
+    // Undoing collapses in reverse order, and applying them in order, never leaves a collapse without its dependencies
+    for (long i = (long)collapses.size() - 1; i >= new_level; --i)
+      if (applied[(size_t)i]) undoCollapse((uint32)i);
+
+    for (long i = 0; i < new_level; ++i)
+      if (!applied[(size_t)i]) applyCollapse((uint32)i);
+
+    uniform = true;
+  }
+}
+
+void
+ProgressiveMesh::applyCollapse(uint32 index)
+{
+  Collapse const & c = collapses[index];
+  replay(c, true);
+  applied[index] = 1;
+  level++;
+
+  for (uint32 i = c.parents_begin; i < c.parents_end; ++i)
+  {
+    num_applied_children[collapse_parents[i]]++;
+    updateFront(collapse_parents[i]);
+  }
+
+  for (uint32 i = c.children_begin; i < c.children_end; ++i)
+  {
+    num_undone_parents[collapse_children[i]]--;
+    updateFront(collapse_children[i]);
+  }
+}
+
+void
+ProgressiveMesh::undoCollapse(uint32 index)
+{
+  Collapse const & c = collapses[index];
+  replay(c, false);
+  applied[index] = 0;
+  level--;
+
+  for (uint32 i = c.parents_begin; i < c.parents_end; ++i)
+  {
+    num_applied_children[collapse_parents[i]]--;
+    updateFront(collapse_parents[i]);
+  }
+
+  for (uint32 i = c.children_begin; i < c.children_end; ++i)
+  {
+    num_undone_parents[collapse_children[i]]++;
+    updateFront(collapse_children[i]);
+  }
+}
+
+void
+ProgressiveMesh::updateFront(uint32 index)
+{
+  bool on_front = (applied[index] ? num_applied_children[index] == 0 : num_undone_parents[index] == 0);
+  if (on_front == (front_position[index] != NONE))
+    return;
+
+  if (on_front)
+  {
+    front_position[index] = (uint32)front.size();
+    front.push_back(index);
+  }
+  else
+  {
+    uint32 last = front.back();
+    front[front_position[index]] = last;
+    front_position[last] = front_position[index];
+    front.pop_back();
+    front_position[index] = NONE;
+  }
+}
+
+namespace ProgressiveMeshInternal {
+
+// Measures how large an error in some region of space appears on the screen.
+class ViewErrorMetric
+{
+  public:
+    ViewErrorMetric(Camera const & camera, int viewport_height)
+    : eye(camera.getPosition()), look(camera.getLookDirection().unit()), up(camera.getUpDirection().unit()),
+      right(camera.getRightDirection().unit()), perspective(camera.isPerspective()),
+      near_dist(camera.getNearDistance()), far_dist(camera.getFarDistance()),
+      left_margin(camera.getLeftMargin()), right_margin(camera.getRightMargin()),
+      bottom_margin(camera.getBottomMargin()), top_margin(camera.getTopMargin()),
+      pixels_per_unit(viewport_height / std::max(camera.getHeight(), (Real)1.0e-30))
+    {
+      // Lengths of the normals of the side planes of the frustum, in the form used by projectedError()
+      left_norm   = std::sqrt(near_dist * near_dist + left_margin   * left_margin);
+      right_norm  = std::sqrt(near_dist * near_dist + right_margin  * right_margin);
+      bottom_norm = std::sqrt(near_dist * near_dist + bottom_margin * bottom_margin);
+      top_norm    = std::sqrt(near_dist * near_dist + top_margin    * top_margin);
+    }
+
+    // Get the size in pixels of an error anywhere within a ball, or zero if the ball is outside the view frustum.
+    Real projectedError(Vector3 const & center, Real radius, Real error) const
+    {
+      Vector3 d = center - eye;
+      Real x = d.dot(right), y = d.dot(up), z = d.dot(look);
+
+      if (z + radius < near_dist || z - radius > far_dist)
+        return 0;
+
+      if (perspective)
+      {
+        // The side planes of the frustum pass through the eye and the edges of the view window on the near plane
+        if (x * near_dist - left_margin * z < -radius * left_norm
+         || right_margin * z - x * near_dist < -radius * right_norm
+         || y * near_dist - bottom_margin * z < -radius * bottom_norm
+         || top_margin * z - y * near_dist < -radius * top_norm)
+          return 0;
+
+        // The error looks largest at the nearest point of the ball
+        return error * pixels_per_unit * near_dist / std::max(z - radius, near_dist);
+      }
+      else
+      {
+        if (x < left_margin - radius || x > right_margin + radius || y < bottom_margin - radius || y > top_margin + radius)
+          return 0;
+
+        return error * pixels_per_unit;
+      }
+    }
+
+  private:
+    Vector3 eye, look, up, right;
+    bool perspective;
+    Real near_dist, far_dist, left_margin, right_margin, bottom_margin, top_margin;
+    Real left_norm, right_norm, bottom_norm, top_norm;
+    Real pixels_per_unit;
+
+}; // class ViewErrorMetric
+
+} // namespace ProgressiveMeshInternal
+
+long
+ProgressiveMesh::adaptToView(Camera const & camera, int viewport_height, Real pixel_tolerance, long max_faces, long max_changes)
+{
+  using namespace ProgressiveMeshInternal;
+
+  if (collapses.empty() || viewport_height <= 0)
+    return 0;
+
+  // Each pass works on the current front, which changes as collapses are applied and undone, so passes are repeated until
+  // nothing changes or the limit is reached
+  ViewErrorMetric metric(camera, viewport_height);
+  std::vector< std::pair<Real, uint32> > refinements, coarsenings;
+  long num_changes = 0;
+  for (long pass_changes = -1; pass_changes != 0 && (max_changes < 0 || num_changes < max_changes); )
+  {
+    pass_changes = 0;
+
+    // Split the front into collapses that could be undone to refine the mesh, and collapses that could be applied to coarsen it
+    refinements.clear();
+    coarsenings.clear();
+    for (size_t i = 0; i < front.size(); ++i)
+    {
+      Collapse const & c = collapses[front[i]];
+      Real e = metric.projectedError(c.bounds.getCenter(), (Real)0.5 * c.bounds.getExtent().length(), c.error);
+      if (!applied[front[i]])
+        coarsenings.push_back(std::make_pair(e, front[i]));
+      else if (e > pixel_tolerance)
+        refinements.push_back(std::make_pair(e, front[i]));
+    }
+
+    std::sort(coarsenings.begin(), coarsenings.end());
+    std::sort(refinements.begin(), refinements.end(), std::greater< std::pair<Real, uint32> >());
+
+    // Coarsen where the error is small enough, and wherever needed to get within the budget, starting with the smallest error
+    for (size_t i = 0; i < coarsenings.size(); ++i)
+    {
+      if (max_changes >= 0 && num_changes + pass_changes >= max_changes)
+        break;
+
+      if (coarsenings[i].first > pixel_tolerance && num_faces <= max_faces)
+        break;
+
+      uint32 index = coarsenings[i].second;
+      if (applied[index] || num_undone_parents[index] != 0)
+        continue;
+
+      applyCollapse(index);
+      pass_changes++;
+    }
+
+    // Refine where the error is too large, starting with the largest error, as long as the budget allows
+    for (size_t i = 0; i < refinements.size(); ++i)
+    {
+      if (max_changes >= 0 && num_changes + pass_changes >= max_changes)
+        break;
+
+      uint32 index = refinements[i].second;
+      if (num_faces + (long)collapses[index].num_removed > max_faces)
+        break;
+
+      if (!applied[index] || num_applied_children[index] != 0)
+        continue;
+
+      undoCollapse(index);
+      pass_changes++;
+    }
+
+    num_changes += pass_changes;
+  }
+
+  if (num_changes > 0)
+    uniform = false;
+
+  return num_changes;
+}
+
+void
+ProgressiveMesh::replay(Collapse const & collapse, bool forward)
+{
+  for (uint32 i = collapse.faces_begin; i < collapse.faces_end; ++i)
+  {
+    FaceChange const & fc = face_changes[i];
+    uint32 begin = (forward ? fc.new_begin : fc.old_begin);
+    uint32 size = (forward ? fc.new_size : fc.old_size);
+
+    std::copy(change_vertices.begin() + begin, change_vertices.begin() + begin + size,
+              face_vertices.begin() + face_offsets[fc.face]);
+
+    num_faces += (size >= 3 ? 1 : 0) - (face_sizes[fc.face] >= 3 ? 1 : 0);
+    face_sizes[fc.face] = size;
+
+    changed_faces.push_back((long)fc.face);
+  }
+
+  for (uint32 i = collapse.vertices_begin; i < collapse.vertices_end; ++i)
+  {
+    VertexChange const & vc = vertex_changes[i];
+    positions[vc.vertex] = (forward ? vc.new_position : vc.old_position);
+
+    changed_vertices.push_back((long)vc.vertex);
+  }
+}
+
+void
+ProgressiveMesh::extract(Mesh & mesh) const
+{
+  mesh.clear();
+
+  std::vector<Mesh::Vertex *> vertex_map(positions.size(), NULL);
+  std::vector<Mesh::Vertex *> face;
+  for (long f = 0; f < numFaceSlots(); ++f)
+  {
+    if (face_sizes[(size_t)f] < 3)
+      continue;
+
+    face.clear();
+    for (long i = 0; i < faceSize(f); ++i)
+    {
+      long v = faceVertex(f, i);
+      if (!vertex_map[(size_t)v])
+        vertex_map[(size_t)v] = mesh.addVertex(positions[(size_t)v]);
+
+      face.push_back(vertex_map[(size_t)v]);
+    }
+
+    mesh.addFace(face.begin(), face.end());
+  }
+
+  mesh.updateQuadrics();
+}
+
+namespace ProgressiveMeshInternal {
+
+// Upload the changed items of an array to a VAR, where item i occupies elements [first[i], first[i + 1]). Runs of nearby items
+// are sent in a single update.
+template <typename T, typename UpdateFuncT>
+void
+uploadChanged(Graphics::VAR * var, std::vector<T> const & data, std::vector<long> & changed, std::vector<uint32> const * first,
+              UpdateFuncT update)
+{
+  static long const MAX_GAP = 8;
+
+  if (!var || changed.empty())
+    return;
+
+  std::sort(changed.begin(), changed.end());
+
+  size_t i = 0;
+  while (i < changed.size())
+  {
+    long begin = changed[i], end = changed[i] + 1;
+    while (++i < changed.size() && changed[i] - end < MAX_GAP)
+      end = changed[i] + 1;
+
+    long start = (first ? (long)(*first)[(size_t)begin] : begin);
+    long stop  = (first ? (long)(*first)[(size_t)end] : end);
+    if (stop > start)
+      (var->*update)(start, stop - start, &data[(size_t)start]);
+  }
+}
+
+} // namespace ProgressiveMeshInternal
+
+void
+ProgressiveMesh::writeFaceTriangles(long face) const
+{
+  RenderCache & rc = render_cache;
+
+  // Unused slots get degenerate triangles
+  uint32 * tri = &rc.tri_index_data[0] + rc.first_tri_index[(size_t)face];
+  uint32 * end = &rc.tri_index_data[0] + rc.first_tri_index[(size_t)face + 1];
+  long n = faceSize(face);
+  for (long i = 2; i < n; ++i, tri += 3)
+  {
+    tri[0] = (uint32)faceVertex(face, 0);
+    tri[1] = (uint32)faceVertex(face, i - 1);
+    tri[2] = (uint32)faceVertex(face, i);
+  }
+
+  std::fill(tri, end, 0);
+}
+
+void
+ProgressiveMesh::releaseRenderCache() const
+{
+  if (render_cache.render_system)
+    render_cache.render_system->destroyVARArea(render_cache.area);
+
+  delete render_cache.positions;
+  delete render_cache.tri_indices;
+
+  render_cache = RenderCache();
+}
+
+void
+ProgressiveMesh::draw(Graphics::RenderSystem & render_system) const
+{
+  using namespace ProgressiveMeshInternal;
+
+  typedef void (Graphics::VAR::*VectorUpdate)(long, long, Vector3 const *);
+  typedef void (Graphics::VAR::*IndexUpdate)(long, long, uint32 const *);
+
+  RenderCache & rc = render_cache;
+
+  if (positions.empty())
+    return;
+
+  if (!rc.valid || rc.render_system != &render_system)
+  {
+    releaseRenderCache();
+
+    // Each face gets enough triangle slots for its original size, which it can never exceed
+    rc.first_tri_index.resize(face_sizes.size() + 1);
+    rc.first_tri_index[0] = 0;
+    for (size_t f = 0; f < face_sizes.size(); ++f)
+    {
+      uint32 max_size = (f + 1 < face_offsets.size() ? face_offsets[f + 1] : (uint32)face_vertices.size()) - face_offsets[f];
+      rc.first_tri_index[f + 1] = rc.first_tri_index[f] + (max_size >= 3 ? 3 * (max_size - 2) : 0);
+    }
+
+    rc.tri_index_data.resize((size_t)rc.first_tri_index.back());
+    for (long f = 0; f < numFaceSlots(); ++f)
+      writeFaceTriangles(f);
+
+    long position_bytes = (long)(positions.size() * sizeof(Vector3));
+    long index_bytes = (long)(rc.tri_index_data.size() * sizeof(uint32));
+
+    rc.render_system = &render_system;
+    rc.area = render_system.createVARArea("Progressive mesh buffer", position_bytes + index_bytes + 1024,
+                                          Graphics::VARArea::Usage::WRITE_OCCASIONALLY,
+                                          /* gpu_memory = */ DGP_SUPPORTS(ARB_vertex_buffer_object));
+
+    rc.positions = rc.area->createArray(position_bytes);
+    rc.positions->updateVectors(0, (long)positions.size(), &positions[0]);
+
+    if (!rc.tri_index_data.empty())
+    {
+      rc.tri_indices = rc.area->createArray(index_bytes);
+      rc.tri_indices->updateIndices(0, (long)rc.tri_index_data.size(), &rc.tri_index_data[0]);
+    }
+
+    rc.valid = true;
+    changed_vertices.clear();
+    changed_faces.clear();
+  }
+  else
+  {
+    // Patch the buffers for the vertices and faces changed since the last call
+    for (size_t i = 0; i < changed_faces.size(); ++i)
+      writeFaceTriangles(changed_faces[i]);
+
+    uploadChanged(rc.positions, positions, changed_vertices, NULL, (VectorUpdate)&Graphics::VAR::updateVectors);
+    uploadChanged(rc.tri_indices, rc.tri_index_data, changed_faces, &rc.first_tri_index,
+                  (IndexUpdate)&Graphics::VAR::updateIndices);
+
+    changed_vertices.clear();
+    changed_faces.clear();
+  }
+
+  if (!rc.tri_indices)
+    return;
+
+  render_system.beginIndexedPrimitives();
+    render_system.setVertexArray(rc.positions);
+    render_system.setIndexArray(rc.tri_indices);
+    render_system.sendIndicesFromArray(Graphics::RenderSystem::Primitive::TRIANGLES, 0, (long)rc.tri_index_data.size());
+  render_system.endIndexedPrimitives();
+}
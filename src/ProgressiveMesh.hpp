@@ -0,0 +1,231 @@
+#ifndef __A2_ProgressiveMesh_hpp__
+#define __A2_ProgressiveMesh_hpp__
+
+#include "Common.hpp"
+#include "DGP/AxisAlignedBox3.hpp"
+#include "DGP/Camera.hpp"
+#include "DGP/Graphics/RenderSystem.hpp"
+#include "DGP/Noncopyable.hpp"
+#include "DGP/ProgressReporter.hpp"
+#include "DGP/Vector3.hpp"
+#include <vector>
+
+// Forward declaration
+class Mesh;
+
+/**
+ * A mesh that can be switched quickly to any level of detail along a precomputed sequence of edge collapses, in the spirit of
+ * Hoppe's progressive meshes. Each collapse is stored as the changes it makes to the vertex lists of faces and to vertex
+ * positions, so that it can be applied, or undone as a vertex split, in time proportional to the size of its neighborhood.
+ *
+ * Level 0 is the original mesh and level i is the mesh after the first i collapses. Faces keep their original indices at all
+ * levels: a face removed by a collapse simply has no vertices. Vertex indices are likewise those of the original mesh.
+ *
+ * Collapses also form a hierarchy, as in Hoppe's view-dependent refinement: a collapse depends on the earlier collapses that last
+ * changed the faces and vertices it changes. Any set of collapses that includes the dependencies of its members gives a valid
+ * mesh, so different parts of the mesh can be shown at different levels of detail (see adaptToView()).
+ */
+class ProgressiveMesh : private Noncopyable
+{
+  public:
+    /** Constructor. */
+    ProgressiveMesh();
+
+    /** Destructor. Releases any GPU buffers created by draw(). */
+    ~ProgressiveMesh() { releaseRenderCache(); }
+
+    /** Clear all data. */
+    void clear();
+
+    /**
+     * Record the sequence of collapses made by quadric edge collapse decimation of a mesh. Assumes the quadrics and collapse
+     * errors of the mesh have been initialized, as for Mesh::decimateQuadricEdgeCollapse(). The mesh is decimated in the
+     * process, and the progressive mesh is left at the coarsest level.
+     *
+     * @param mesh The mesh to decimate.
+     * @param min_num_faces Decimation stops when the mesh has at most this many faces (or no edge can be collapsed).
+     * @param progress If non-null, used to report progress, measured in faces removed.
+     */
+    void build(Mesh & mesh, long min_num_faces = 0, ProgressReporter * progress = NULL);
+
+    /** Get the number of vertices of the original mesh. */
+    long numVertices() const { return (long)positions.size(); }
+
+    /** Get the number of face slots, i.e. the number of faces of the original mesh. */
+    long numFaceSlots() const { return (long)face_sizes.size(); }
+
+    /** Get the number of levels, i.e. one more than the number of recorded collapses. */
+    long numLevels() const { return (long)level_num_faces.size(); }
+
+    /** Get the current level. If the mesh has been refined selectively, this is the number of collapses currently applied. */
+    long getLevel() const { return level; }
+
+    /** Check if the mesh is at a single level of detail, i.e. has not been refined selectively since the last setLevel(). */
+    bool isUniform() const { return uniform; }
+
+    /** Get the number of faces at a level. */
+    long numFacesAtLevel(long lvl) const { return level_num_faces[(size_t)lvl]; }
+
+    /** Get the number of faces of the current mesh. */
+    long numFaces() const { return num_faces; }
+
+    /** Get the smallest level with at most a given number of faces, or the coarsest level if there is none. */
+    long levelForNumFaces(long num_faces) const;
+
+    /**
+     * Switch to a level, by applying collapses or undoing them (vertex splits) one at a time from the current level. The GPU
+     * buffers used by draw() are updated for just the changed vertices and faces when the mesh is next drawn.
+     */
+    void setLevel(long new_level);
+
+    /**
+     * Refine the mesh where it is coarse and coarsen it where it is fine, as seen by a camera, so that the error of each part of
+     * the mesh projects to about a given number of pixels on the screen, subject to a budget on the number of faces. Parts outside
+     * the view frustum are coarsened as far as possible. Only collapses on the boundary between applied and undone collapses are
+     * considered, so the work done is proportional to the size of the current mesh and to the changes made, and a mesh adapted
+     * to the previous frame is cheap to adapt to the next. With a limit on the number of changes, the mesh converges to the
+     * desired state over successive calls.
+     *
+     * @param camera The camera viewing the mesh.
+     * @param viewport_height The height of the viewport in pixels.
+     * @param pixel_tolerance The largest acceptable error, in pixels.
+     * @param max_faces The largest acceptable number of faces.
+     * @param max_changes The maximum number of collapses to apply or undo in this call, or a negative number for no limit.
+     *
+     * @return The number of collapses applied or undone. Zero means the mesh has converged for this view.
+     */
+    long adaptToView(Camera const & camera, int viewport_height, Real pixel_tolerance, long max_faces, long max_changes = -1);
+
+    /** Get the position of a vertex at the current level. */
+    Vector3 const & getPosition(long vertex) const { return positions[(size_t)vertex]; }
+
+    /** Get the number of vertices of a face at the current level (zero if the face has been removed). */
+    long faceSize(long face) const { return (long)face_sizes[(size_t)face]; }
+
+    /** Get the index of the i'th vertex of a face at the current level. */
+    long faceVertex(long face, long i) const { return (long)face_vertices[(size_t)(face_offsets[(size_t)face] + i)]; }
+
+    /**
+     * Replace the contents of a mesh with the current level. Only vertices that belong to a face are copied. Quadrics and
+     * collapse errors are initialized, so the mesh can be decimated further.
+     */
+    void extract(Mesh & mesh) const;
+
+    /**
+     * Draw the current level on a render_system, as triangles without normals or colors. Faces are split into triangle fans.
+     * The GPU buffers are created on first use and afterwards only patched where the level changes have affected them.
+     *
+     * @param render_system The rendersystem to draw on. It must outlive this object or a call to releaseRenderCache().
+     */
+    void draw(Graphics::RenderSystem & render_system) const;
+
+    /** Get the number of triangles sent to the GPU by draw(), including degenerate triangles in unused slots. */
+    long numDrawnTriangles() const { return render_cache.tri_indices ? (long)render_cache.tri_index_data.size() / 3 : 0; }
+
+    /** Release the GPU buffers used by draw(). */
+    void releaseRenderCache() const;
+
+  private:
+    /** The changes to a face made by a collapse. */
+    struct FaceChange
+    {
+      uint32 face;       ///< Index of the face.
+      uint32 old_begin;  ///< Start of the vertex list before the collapse, in change_vertices.
+      uint32 old_size;   ///< Number of vertices before the collapse.
+      uint32 new_begin;  ///< Start of the vertex list after the collapse, in change_vertices.
+      uint32 new_size;   ///< Number of vertices after the collapse.
+    };
+
+    /** The change to the position of a vertex made by a collapse. */
+    struct VertexChange
+    {
+      uint32 vertex;         ///< Index of the vertex.
+      Vector3 old_position;  ///< Position before the collapse.
+      Vector3 new_position;  ///< Position after the collapse.
+    };
+
+    /**
+     * A recorded collapse, as ranges of the face and vertex change arrays, with its place in the hierarchy of collapses and the
+     * extent and error of the region of the mesh it simplifies.
+     */
+    struct Collapse
+    {
+      uint32 faces_begin;     ///< First face change.
+      uint32 faces_end;       ///< One past the last face change.
+      uint32 vertices_begin;  ///< First vertex change.
+      uint32 vertices_end;    ///< One past the last vertex change.
+      uint32 parents_begin;   ///< First collapse this one depends on, in collapse_parents.
+      uint32 parents_end;     ///< One past the last collapse this one depends on.
+      uint32 children_begin;  ///< First collapse that depends on this one, in collapse_children.
+      uint32 children_end;    ///< One past the last collapse that depends on this one.
+      uint32 num_removed;     ///< Number of faces removed by the collapse.
+      AxisAlignedBox3 bounds; ///< Bounds of the affected faces, before and after this and the collapses it depends on.
+      Real error;             ///< Distance from removed vertices to the simplified surface, at least that of the dependencies.
+    };
+
+    /**
+     * GPU buffers for drawing the mesh. Each face has a fixed range of triangle slots, enough for its original size, with
+     * degenerate triangles in the slots it does not currently need.
+     */
+    struct RenderCache
+    {
+      RenderCache() : render_system(NULL), area(NULL), positions(NULL), tri_indices(NULL), valid(false) {}
+
+      Graphics::RenderSystem * render_system;  ///< The rendersystem that owns the buffers.
+      Graphics::VARArea * area;                ///< Storage for the buffers.
+      Graphics::VAR * positions;               ///< Vertex positions.
+      Graphics::VAR * tri_indices;             ///< Triangle indices.
+      std::vector<uint32> tri_index_data;      ///< Contents of the triangle index array.
+      std::vector<uint32> first_tri_index;     ///< Start of the triangle indices of each face, followed by the total number.
+      bool valid;                              ///< False if the buffers need to be rebuilt.
+    };
+
+    /** Apply (if \a forward is true) or undo a collapse, and mark the affected vertices and faces as changed. */
+    void replay(Collapse const & collapse, bool forward);
+
+    /** Apply a collapse whose dependencies are all applied, and update the hierarchy. */
+    void applyCollapse(uint32 index);
+
+    /** Undo a collapse that no applied collapse depends on, and update the hierarchy. */
+    void undoCollapse(uint32 index);
+
+    /** Add a collapse to, or remove it from, the front of collapses that can be applied or undone on their own. */
+    void updateFront(uint32 index);
+
+    /** Compute the dependencies, bounds and errors of the collapses, once they have all been recorded. */
+    void buildHierarchy();
+
+    /** Write the triangles of a face to its slots. */
+    void writeFaceTriangles(long face) const;
+
+    std::vector<Vector3> positions;             ///< Vertex positions at the current level.
+    std::vector<uint32> face_offsets;           ///< Start of the vertex list of each face in face_vertices.
+    std::vector<uint32> face_sizes;             ///< Number of vertices of each face at the current level.
+    std::vector<uint32> face_vertices;          ///< Vertex lists of faces, with room for the original number of vertices.
+
+    std::vector<Collapse> collapses;            ///< Recorded collapses.
+    std::vector<FaceChange> face_changes;       ///< Face changes of all collapses.
+    std::vector<uint32> change_vertices;        ///< Vertex lists before and after face changes.
+    std::vector<VertexChange> vertex_changes;   ///< Vertex changes of all collapses.
+    std::vector<uint32> collapse_parents;       ///< Dependencies of all collapses.
+    std::vector<uint32> collapse_children;      ///< Dependents of all collapses.
+    std::vector<long> level_num_faces;          ///< Number of faces at each level.
+    long level;                                 ///< Current level, or number of collapses applied.
+    long num_faces;                             ///< Current number of faces.
+    bool uniform;                               ///< Is the current mesh a single level?
+
+    std::vector<uint8> applied;                 ///< Is each collapse currently applied?
+    std::vector<uint32> num_applied_children;   ///< Number of applied collapses that depend on each collapse.
+    std::vector<uint32> num_undone_parents;     ///< Number of dependencies of each collapse that are not applied.
+    std::vector<uint32> front;                  ///< Collapses that can be applied or undone without changing any other.
+    std::vector<uint32> front_position;         ///< Position of each collapse in the front, or NONE.
+
+    static uint32 const NONE;                   ///< Marks a missing index.
+
+    mutable std::vector<long> changed_vertices;  ///< Vertices changed since the mesh was last drawn.
+    mutable std::vector<long> changed_faces;     ///< Faces changed since the mesh was last drawn.
+    mutable RenderCache render_cache;            ///< GPU buffers for drawing the mesh.
+
+}; // class ProgressiveMesh
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef __A2_QuadricFrame_hpp__
+#define __A2_QuadricFrame_hpp__
+
+#include "Common.hpp"
+#include "DGP/AxisAlignedBox3.hpp"
+#include "DGP/Vector3.hpp"
+#include <algorithm>
+
+/**
+ * The coordinate frame in which quadrics are computed: mesh positions are translated by -center and then multiplied by scale.
+ * Quadric errors measured in this frame are scale^2 times the errors in mesh coordinates.
+ */
+struct QuadricFrame
+{
+  /** Default constructor. The frame is the identity. */
+  QuadricFrame() : center(Vector3::zero()), scale(1) {}
+
+  /** Construct with a given center and scale. */
+  QuadricFrame(Vector3 const & center_, Real scale_) : center(center_), scale(scale_) {}
+
+  /**
+   * Get the frame for a mesh with given bounds. With double-precision quadrics this is the identity. With single-precision
+   * quadrics the box is mapped to [-1, 1] along its longest side, which keeps the plane offsets in quadrics small and so
+   * preserves their precision.
+   */
+  static QuadricFrame forBounds(AxisAlignedBox3 const & bounds)
+  {
+    if (sizeof(QuadricReal) >= sizeof(double) || bounds.isNull())
+      return QuadricFrame();
+
+    Vector3 ext = bounds.getExtent();
+    Real half_size = 0.5f * std::max(std::max(ext.x(), ext.y()), ext.z());
+    return QuadricFrame(bounds.getCenter(), half_size > 0 ? 1 / half_size : 1);
+  }
+
+  /** Map a point from mesh coordinates to this frame. */
+  Vector3 toLocal(Vector3 const & p) const { return (p - center) * scale; }
+
+  /** Map a point from this frame to mesh coordinates. */
+  Vector3 toWorld(Vector3 const & p) const { return p / scale + center; }
+
+  /** Convert a quadric error measured in this frame to mesh coordinates. */
+  double toWorldError(double error) const { return error / ((double)scale * scale); }
+
+  Vector3 center;  ///< The point mapped to the origin.
+  Real scale;      ///< Scale factor applied after translation.
+
+}; // struct QuadricFrame
+
+#endif
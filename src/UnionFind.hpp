@@ -0,0 +1,73 @@
+#ifndef __A2_UnionFind_hpp__
+#define __A2_UnionFind_hpp__
+
+#include "Common.hpp"
+#include "DGP/Noncopyable.hpp"
+#include <atomic>
+#include <utility>
+#include <vector>
+
+/**
+ * Disjoint sets of the integers 0 to n - 1 (union-find), which many threads can merge and query at once without locks. Each set
+ * is a tree of parent links, updated with compare-and-swap. A root is always linked under a root with a smaller index, so no
+ * cycles can form however the threads interleave, and finding a root halves the path to it on the way.
+ *
+ * Once all merges are done, find() returns the smallest element of each set, so the result does not depend on the order of
+ * the merges.
+ */
+class UnionFind : private Noncopyable
+{
+  public:
+    /** Constructor. Each element starts in a set of its own. */
+    explicit UnionFind(long n) : parent((size_t)n)
+    {
+      for (size_t i = 0; i < parent.size(); ++i)
+        parent[i].store((uint32)i, std::memory_order_relaxed);
+    }
+
+    /** Get the number of elements. */
+    long size() const { return (long)parent.size(); }
+
+    /** Get the representative (root) of the set containing an element. */
+    uint32 find(uint32 i)
+    {
+      while (true)
+      {
+        uint32 p = parent[i].load();
+        if (p == i)
+          return i;
+
+        uint32 gp = parent[p].load();
+        if (gp != p)
+          parent[i].compare_exchange_weak(p, gp);  // path halving: fine to fail, another thread changed the link
+
+        i = gp;
+      }
+    }
+
+    /** Merge the sets containing two elements. */
+    void unite(uint32 i, uint32 j)
+    {
+      while (true)
+      {
+        i = find(i);
+        j = find(j);
+        if (i == j)
+          return;
+
+        if (i < j)
+          std::swap(i, j);
+
+        // Link the root with the larger index under the other, unless another thread has just linked it elsewhere
+        uint32 expected = i;
+        if (parent[i].compare_exchange_strong(expected, j))
+          return;
+      }
+    }
+
+  private:
+    std::vector< std::atomic<uint32> > parent;  ///< Parent of each element, or the element itself for roots.
+
+}; // class UnionFind
+
+#endif
@@ -1,7 +1,10 @@
 #include "Viewer.hpp"
 #include "Mesh.hpp"
+#include "ProgressiveMesh.hpp"
+#include "DGP/Graphics/GLCaps.hpp"
 #include "DGP/Graphics/RenderSystem.hpp"
 #include "DGP/Graphics/Shader.hpp"
+#include "DGP/System.hpp"
 
 #ifdef DGP_OSX
 #  include <GLUT/glut.h>
@@ -24,11 +27,143 @@ int Viewer::drag_start_y = -1;
 bool Viewer::show_bbox = false;
 bool Viewer::show_edges = false;
 MeshVertex const * Viewer::highlighted_vertex = NULL;
+bool Viewer::decimating = false;
+Mesh::Changes Viewer::mesh_changes;
+DecimationWorker Viewer::decimation_worker;
+DecimationWorker::SnapshotPtr Viewer::displayed_snapshot;
+Graphics::VARArea * Viewer::snapshot_area = NULL;
+Graphics::VAR * Viewer::snapshot_positions = NULL;
+Graphics::VAR * Viewer::snapshot_normals = NULL;
+Graphics::VAR * Viewer::snapshot_indices = NULL;
+double Viewer::last_frame_time = 0;
+ProgressiveMesh * Viewer::lod_mesh = NULL;
+bool Viewer::dragging_slider = false;
+bool Viewer::view_dependent_lod = false;
+long Viewer::lod_face_budget = 0;
+MeshPicker Viewer::picker;
+MeshPicker::Hit Viewer::picked;
+double Viewer::pick_seconds = 0;
+bool Viewer::show_hud = false;
+Stopwatch Viewer::frame_stopwatch("Frame");
+long Viewer::frame_triangles = 0;
+
+namespace ViewerInternal {
+
+// Layout of overlays, in pixels
+int const OVERLAY_MARGIN = 10;
+int const BAR_HEIGHT = 8;
+int const SLIDER_HIT_HEIGHT = 24;
+
+// View-dependent refinement aims for errors of at most this many pixels
+Real const LOD_PIXEL_TOLERANCE = 1;
+
+// Limit on the number of collapses applied or undone per frame during view-dependent refinement, to keep frames short while the
+// mesh converges to a new view
+long const LOD_CHANGES_PER_FRAME = 20000;
+
+// A click that moves the mouse by at most this many pixels picks instead of rotating the view
+int const MAX_CLICK_DISTANCE = 2;
+
+// Measures how often something happens, over windows of about a second. Cheap enough to update every frame.
+class RateMeter
+{
+  public:
+    RateMeter() : count(0), window_start(-1), rate(0) {}
+
+    // Record some number of events.
+    void add(long n) { count += n; }
+
+    // Get the number of events per second in the last complete window.
+    double getRate()
+    {
+      static double const WINDOW = 1.0;
+
+      double now = System::time();
+      if (window_start < 0)
+        window_start = now;
+      else if (now - window_start >= WINDOW)
+      {
+        rate = count / (now - window_start);
+        count = 0;
+        window_start = now;
+      }
+
+      return rate;
+    }
+
+  private:
+    long count;
+    double window_start;
+    double rate;
+
+}; // class RateMeter
+
+// Collapses made by any means (interactive or background decimation, or changing the level of detail)
+RateMeter collapse_meter;
+
+// Get the error of a vertex's quadric at the position of the vertex, in mesh coordinates.
+double
+quadricError(Mesh const & mesh, MeshVertex const & v)
+{
+  QuadricFrame const & frame = mesh.getQuadricFrame();
+  Vector4 p(frame.toLocal(v.getPosition()), 1);
+  return frame.toWorldError(p.dot(quadricCast<double>(v.getQuadric()) * p));
+}
+
+// Get the quadric error of collapsing an edge, in mesh coordinates.
+double
+collapseCost(Mesh const & mesh, MeshEdge const & e)
+{
+  return mesh.getQuadricFrame().toWorldError(e.getQuadricCollapseError());
+}
+
+} // namespace ViewerInternal
 
 void
 Viewer::setObject(Mesh * o)
 {
   mesh = o;
+  resetMeshState();
+}
+
+void
+Viewer::decimateInBackground(long target_num_faces)
+{
+  if (!mesh || lod_mesh || decimation_worker.isActive() || mesh->numFaces() <= target_num_faces)
+    return;
+
+  // The worker takes over the mesh, so anything referring to its current state is discarded
+  decimating = false;
+  resetMeshState();
+
+  decimation_worker.start(mesh, target_num_faces);
+
+  if (render_system)  // else the idle callback is set up when the viewer is launched
+    glutIdleFunc(idle);
+}
+
+bool
+Viewer::updateBackgroundDecimation()
+{
+  if (!decimation_worker.isActive())
+    return false;
+
+  if (decimation_worker.isRunning())
+    return true;
+
+  // Done: take back the mesh and release the snapshot buffers
+  decimation_worker.wait();
+  displayed_snapshot.reset();
+
+  delete snapshot_positions; snapshot_positions = NULL;
+  delete snapshot_normals; snapshot_normals = NULL;
+  delete snapshot_indices; snapshot_indices = NULL;
+  render_system->destroyVARArea(snapshot_area); snapshot_area = NULL;
+
+  DGP_CONSOLE << "Decimated mesh has " << mesh->numVertices() << " vertices, " << mesh->numEdges() << " edges and "
+              << mesh->numFaces() << " faces";
+
+  return false;
 }
 
 void
@@ -48,9 +183,14 @@ Viewer::launch(int argc, char * argv[])
   glutDisplayFunc(draw);
   glutReshapeFunc(reshape);
   glutKeyboardFunc(keyPress);
+  glutKeyboardUpFunc(keyRelease);
+  glutIgnoreKeyRepeat(1);  // held keys are tracked with keyPress/keyRelease pairs
   glutMouseFunc(mousePress);
   glutMotionFunc(mouseMotion);
 
+  if (decimation_worker.isActive())
+    glutIdleFunc(idle);
+
   // Start event processing loop
   glutMainLoop();
 }
@@ -100,17 +240,21 @@ Viewer::fitCameraToObject()
              Camera::ProjectedYDirection::UP);
 }
 
+// If derive_normals is true, the shader ignores vertex normals and shades each triangle with its own normal, computed from the
+// screen-space derivatives of the position.
 bool
-initMeshShader(Graphics::Shader & shader)
+initMeshShader(Graphics::Shader & shader, bool derive_normals = false)
 {
   static std::string const VERTEX_SHADER =
-"varying vec3 normal;  // normal in camera space\n"
+"varying vec3 normal;    // normal in camera space\n"
+"varying vec3 position;  // position in camera space\n"
 "\n"
 "void main()\n"
 "{\n"
 "  gl_Position = ftransform();\n"
 "\n"
 "  normal = gl_NormalMatrix * gl_Normal;\n"
+"  position = vec3(gl_ModelViewMatrix * gl_Vertex);\n"
 "\n"
 "  gl_FrontColor = gl_Color;\n"
 "  gl_BackColor = gl_Color;\n"
@@ -123,11 +267,16 @@ initMeshShader(Graphics::Shader & shader)
 "uniform vec4 material;  // [ka, kl, <ignored>, <ignored>]\n"
 "uniform float two_sided;\n"
 "\n"
-"varying vec3 normal;  // normal in camera space\n"
+"varying vec3 normal;    // normal in camera space\n"
+"varying vec3 position;  // position in camera space\n"
 "\n"
 "void main()\n"
 "{\n"
+"#ifdef DERIVE_NORMALS\n"
+"  vec3 N = normalize(cross(dFdx(position), dFdy(position)));\n"
+"#else\n"
 "  vec3 N = normalize(normal);\n"
+"#endif\n"
 "  vec3 L = normalize(light_dir);\n"
 "\n"
 "  vec3 ambt_color = material[0] * gl_Color.rgb * ambient_color;\n"
@@ -140,8 +289,9 @@ initMeshShader(Graphics::Shader & shader)
 
   try
   {
-    shader.attachModuleFromString(Graphics::Shader::ModuleType::VERTEX, VERTEX_SHADER.c_str());
-    shader.attachModuleFromString(Graphics::Shader::ModuleType::FRAGMENT, FRAGMENT_SHADER.c_str());
+    std::string defines = (derive_normals ? "#define DERIVE_NORMALS\n" : "");
+    shader.attachModuleFromString(Graphics::Shader::ModuleType::VERTEX, (defines + VERTEX_SHADER).c_str());
+    shader.attachModuleFromString(Graphics::Shader::ModuleType::FRAGMENT, (defines + FRAGMENT_SHADER).c_str());
   }
   DGP_STANDARD_CATCH_BLOCKS(return false;, ERROR, "%s", "Could not attach mesh shader module")
 
@@ -159,10 +309,18 @@ Viewer::draw()
 {
   alwaysAssertM(render_system, "Rendersystem not created");
 
+  last_frame_time = System::time();
+  frame_stopwatch.tick();
+  frame_triangles = 0;
+
   render_system->setColorClearValue(ColorRGB(0, 0, 0));
   render_system->clear();
 
-  if (mesh)
+  if (updateBackgroundDecimation())
+    drawSnapshot();
+  else if (lod_mesh)
+    drawLOD();
+  else if (mesh)
   {
     // Initialize the shader
     static Graphics::Shader * mesh_shader = NULL;  // Ok since Viewer fns are all static. Else should have a shader per Viewer.
@@ -185,7 +343,24 @@ Viewer::draw()
 
         render_system->setShader(mesh_shader);
         render_system->setColor(ColorRGB(1, 1, 1));
+
+        // Send just the parts of the mesh changed by decimation to the GPU (if this fails, draw() rebuilds the buffers), and
+        // refit the picking hierarchy to them
+        if (!mesh_changes.isEmpty())
+        {
+          mesh->patchRenderCache(mesh_changes);
+          picker.update(mesh_changes);
+
+          if (mesh_changes.removed_faces.count(picked.face) > 0
+           || mesh_changes.removed_vertices.count(picked.vertex) > 0
+           || mesh_changes.removed_edges.count(picked.edge) > 0)
+            picked = MeshPicker::Hit();
+
+          mesh_changes.clear();
+        }
+
         mesh->draw(*render_system, /* draw_edges = */ show_edges, /* use_vertex_data = */ false, /* send_colors = */ false);
+        frame_triangles += mesh->numDrawnTriangles();
 
         if (show_bbox)
         {
@@ -205,12 +380,48 @@ Viewer::draw()
           render_system->endPrimitive();
         }
 
+        if (picked.vertex)
+        {
+          // Drawn over the mesh, so that the selection is visible even where it is slightly occluded
+          render_system->setShader(NULL);
+          render_system->pushDepthFlags();
+          render_system->setDepthTest(Graphics::RenderSystem::DepthTest::ALWAYS_PASS);
+          render_system->setColor(ColorRGB(0, 1, 0));
+
+          render_system->beginPrimitive(Graphics::RenderSystem::Primitive::LINES);
+            render_system->sendVertex(picked.edge->getEndpoint(0)->getPosition());
+            render_system->sendVertex(picked.edge->getEndpoint(1)->getPosition());
+          render_system->endPrimitive();
+
+          render_system->setPointSize(10);
+          render_system->beginPrimitive(Graphics::RenderSystem::Primitive::POINTS);
+            render_system->sendVertex(picked.vertex->getPosition());
+          render_system->endPrimitive();
+
+          render_system->popDepthFlags();
+        }
+
       render_system->popShader();
 
     render_system->setMatrixMode(Graphics::RenderSystem::MatrixMode::PROJECTION); render_system->popMatrix();
     render_system->setMatrixMode(Graphics::RenderSystem::MatrixMode::MODELVIEW); render_system->popMatrix();
+
+    if (picked.vertex)
+    {
+      beginOverlay();
+        render_system->setColor(ColorRGB(1, 1, 1));
+        drawOverlayText(ViewerInternal::OVERLAY_MARGIN, ViewerInternal::OVERLAY_MARGIN,
+                        format("Vertex: valence %d, quadric error %g   Edge: collapse cost %g   (picked in %.1f us)",
+                               picked.vertex->degree(), ViewerInternal::quadricError(*mesh, *picked.vertex),
+                               ViewerInternal::collapseCost(*mesh, *picked.edge), 1.0e6 * pick_seconds));
+      endOverlay();
+    }
   }
 
+  if (show_hud)
+    drawHUD();
+
+  frame_stopwatch.tock();
   glutSwapBuffers();
 }
 
@@ -279,6 +490,11 @@ Viewer::keyPress(unsigned char key, int x, int y)
     show_bbox = !show_bbox;
     glutPostRedisplay();
   }
+  else if (key == 'i' || key == 'I')
+  {
+    show_hud = !show_hud;
+    glutPostRedisplay();
+  }
   else if (key == 'e' || key == 'E')
   {
     show_edges = !show_edges;
@@ -289,13 +505,121 @@ Viewer::keyPress(unsigned char key, int x, int y)
     fitCameraToObject();
     glutPostRedisplay();
   }
-  else if (key == 'd' || key == 'd')
+  else if (key == 'h' || key == 'H')
+  {
+    if (mesh)
+      decimateInBackground(mesh->numFaces() / 2);
+  }
+  else if (decimation_worker.isActive())
+  {
+    // The mesh belongs to the background decimation, so keys that edit it are ignored
+  }
+  else if (key == 'l' || key == 'L')
+  {
+    toggleLOD();
+    glutPostRedisplay();
+  }
+  else if (lod_mesh)
+  {
+    // Each step changes the number of faces by this factor
+    static double const LOD_STEP = 1.25;
+
+    long num_faces = (view_dependent_lod ? lod_face_budget : lod_mesh->numFaces());
+    if (key == '+' || key == '=')
+      setLODNumFaces(std::max((long)(num_faces * LOD_STEP), num_faces + 1));
+    else if (key == '-' || key == '_')
+      setLODNumFaces(std::min((long)(num_faces / LOD_STEP), num_faces - 1));
+    else if (key == 'v' || key == 'V')
+    {
+      // Switching back to a single level keeps about the same number of faces
+      view_dependent_lod = !view_dependent_lod;
+      if (view_dependent_lod)
+        lod_face_budget = lod_mesh->numFaces();
+      else
+        lod_mesh->setLevel(lod_mesh->levelForNumFaces(lod_mesh->numFaces()));
+
+      glutPostRedisplay();
+    }
+  }
+  else if (key == 'd' || key == 'D')
   {
-    highlighted_vertex = mesh->decimateQuadricEdgeCollapse();
+    // Collapse one edge immediately, then keep decimating while the key is held down
+    decimate(0);
+    decimating = true;
+    glutIdleFunc(idle);
     glutPostRedisplay();
   }
 }
 
+void
+Viewer::keyRelease(unsigned char key, int x, int y)
+{
+  if (key == 'd' || key == 'D')
+  {
+    decimating = false;
+
+    // The idle callback also polls background decimation, which must go on
+    if (!decimation_worker.isActive())
+      glutIdleFunc(NULL);
+  }
+}
+
+void
+Viewer::idle()
+{
+  // Leave enough of each frame for drawing
+  static double const DECIMATION_TIME_PER_FRAME = 0.010;
+
+  // Frame rate while decimating in the background. Redrawing more often would just take time away from the worker.
+  static double const BACKGROUND_FRAME_TIME = 1.0 / 60;
+
+  if (decimation_worker.isActive())
+  {
+    double wait_time = last_frame_time + BACKGROUND_FRAME_TIME - System::time();
+    if (wait_time > 0)
+    {
+      System::sleep(std::max((long)(1000 * wait_time), 1L));
+      return;
+    }
+  }
+  else if (!decimating || decimate(DECIMATION_TIME_PER_FRAME) <= 0)
+  {
+    decimating = false;
+    glutIdleFunc(NULL);
+  }
+
+  glutPostRedisplay();
+}
+
+long
+Viewer::decimate(double max_seconds)
+{
+  if (!mesh)
+    return 0;
+
+  double start_time = System::time();
+  long num_collapsed = 0;
+  do
+  {
+    Mesh::CollapseStatus status;
+    MeshVertex const * v = mesh->decimateQuadricEdgeCollapse(&mesh_changes, &status);
+    if (status == Mesh::NO_EDGES_LEFT)
+      break;
+    else if (status == Mesh::EDGE_SKIPPED)
+      continue;
+
+    // Null if the collapse removed a whole component, which may have held the previous highlighted vertex
+    highlighted_vertex = v;
+
+    num_collapsed++;
+
+  } while (System::time() - start_time < max_seconds);
+
+  ViewerInternal::collapse_meter.add(num_collapsed);
+
+  return num_collapsed;
+}
+
 void
 Viewer::incrementViewTransform(AffineTransform3 const & tr)
 {
@@ -310,6 +634,20 @@ Viewer::incrementViewTransform(AffineTransform3 const & tr)
 void
 Viewer::mousePress(int button, int state, int x, int y)
 {
+  dragging_slider = (button == GLUT_LEFT_BUTTON && state == GLUT_DOWN && isOnSlider(x, y));
+  if (dragging_slider)
+  {
+    dragging = false;
+    setLODFromSlider(x);
+    return;
+  }
+
+  // A click without a drag picks a vertex
+  if (dragging && button == GLUT_LEFT_BUTTON && state == GLUT_UP
+   && std::abs(x - drag_start_x) <= ViewerInternal::MAX_CLICK_DISTANCE
+   && std::abs(y - drag_start_y) <= ViewerInternal::MAX_CLICK_DISTANCE)
+    pick(x, y);
+
   dragging = (button == GLUT_LEFT_BUTTON && state == GLUT_DOWN);
   modifier_keys = glutGetModifiers();
 
@@ -326,6 +664,12 @@ Viewer::mousePress(int button, int state, int x, int y)
 void
 Viewer::mouseMotion(int x, int y)
 {
+  if (dragging_slider)
+  {
+    setLODFromSlider(x);
+    return;
+  }
+
   if (!dragging)
     return;
 
@@ -359,6 +703,394 @@ Viewer::mouseMotion(int x, int y)
   glutPostRedisplay();
 }
 
+void
+Viewer::drawSnapshot()
+{
+  // Upload the latest snapshot if it has not been seen yet
+  DecimationWorker::SnapshotPtr snapshot = decimation_worker.getSnapshot();
+  if (snapshot && snapshot != displayed_snapshot)
+  {
+    long vertex_bytes = (long)(snapshot->positions.size() * 2 * sizeof(Vector3));
+    long index_bytes = (long)(snapshot->tri_indices.size() * sizeof(uint32));
+
+    delete snapshot_positions; snapshot_positions = NULL;
+    delete snapshot_normals; snapshot_normals = NULL;
+    delete snapshot_indices; snapshot_indices = NULL;
+
+    // Snapshots only get smaller, so the area allocated for the first one can be reused for the rest
+    if (snapshot_area && snapshot_area->getCapacity() >= vertex_bytes + index_bytes)
+      snapshot_area->reset();
+    else
+    {
+      render_system->destroyVARArea(snapshot_area);
+      snapshot_area = render_system->createVARArea("Snapshot buffer", std::max(vertex_bytes + index_bytes, 1024L),
+                                                   Graphics::VARArea::Usage::WRITE_OCCASIONALLY,
+                                                   /* gpu_memory = */ DGP_SUPPORTS(ARB_vertex_buffer_object));
+    }
+
+    if (!snapshot->tri_indices.empty())
+    {
+      long num_vertices = (long)snapshot->positions.size();
+      long num_indices = (long)snapshot->tri_indices.size();
+
+      snapshot_positions = snapshot_area->createArray(num_vertices * (long)sizeof(Vector3));
+      snapshot_positions->updateVectors(0, num_vertices, &snapshot->positions[0]);
+
+      snapshot_normals = snapshot_area->createArray(num_vertices * (long)sizeof(Vector3));
+      snapshot_normals->updateVectors(0, num_vertices, &snapshot->normals[0]);
+
+      snapshot_indices = snapshot_area->createArray(num_indices * (long)sizeof(uint32));
+      snapshot_indices->updateIndices(0, num_indices, &snapshot->tri_indices[0]);
+    }
+
+    ViewerInternal::collapse_meter.add(snapshot->num_collapses - (displayed_snapshot ? displayed_snapshot->num_collapses : 0));
+    displayed_snapshot = snapshot;
+  }
+
+  if (!displayed_snapshot)
+    return;
+
+  static Graphics::Shader * snapshot_shader = NULL;
+  if (!snapshot_shader)
+  {
+    snapshot_shader = render_system->createShader("Snapshot shader");
+    if (!snapshot_shader || !initMeshShader(*snapshot_shader))
+      return;
+  }
+
+  if (snapshot_indices)
+  {
+    render_system->setMatrixMode(Graphics::RenderSystem::MatrixMode::MODELVIEW); render_system->pushMatrix();
+    render_system->setMatrixMode(Graphics::RenderSystem::MatrixMode::PROJECTION); render_system->pushMatrix();
+
+      render_system->setCamera(camera);
+
+      render_system->pushShader();
+
+        render_system->setShader(snapshot_shader);
+        render_system->setColor(ColorRGB(1, 1, 1));
+
+        render_system->beginIndexedPrimitives();
+          render_system->setVertexArray(snapshot_positions);
+          render_system->setNormalArray(snapshot_normals);
+          render_system->setIndexArray(snapshot_indices);
+          render_system->sendIndicesFromArray(Graphics::RenderSystem::Primitive::TRIANGLES, 0,
+                                              (long)displayed_snapshot->tri_indices.size());
+        render_system->endIndexedPrimitives();
+        frame_triangles += (long)displayed_snapshot->tri_indices.size() / 3;
+
+      render_system->popShader();
+
+    render_system->setMatrixMode(Graphics::RenderSystem::MatrixMode::PROJECTION); render_system->popMatrix();
+    render_system->setMatrixMode(Graphics::RenderSystem::MatrixMode::MODELVIEW); render_system->popMatrix();
+  }
+
+  // Progress bar along the bottom of the window, with a summary above it
+  using namespace ViewerInternal;
+  int const MARGIN = OVERLAY_MARGIN;
+
+  double progress = displayed_snapshot->progress();
+  Real bar_right = (Real)(MARGIN + progress * (width - 2 * MARGIN));
+
+  beginOverlay();
+
+    render_system->setColor(ColorRGB(0.3f, 0.3f, 0.3f));
+    render_system->beginPrimitive(Graphics::RenderSystem::Primitive::QUADS);
+      render_system->sendVertex(Vector2(MARGIN, MARGIN));
+      render_system->sendVertex(Vector2(width - MARGIN, MARGIN));
+      render_system->sendVertex(Vector2(width - MARGIN, MARGIN + BAR_HEIGHT));
+      render_system->sendVertex(Vector2(MARGIN, MARGIN + BAR_HEIGHT));
+    render_system->endPrimitive();
+
+    render_system->setColor(ColorRGB(0.2f, 0.8f, 0.3f));
+    render_system->beginPrimitive(Graphics::RenderSystem::Primitive::QUADS);
+      render_system->sendVertex(Vector2(MARGIN, MARGIN));
+      render_system->sendVertex(Vector2(bar_right, MARGIN));
+      render_system->sendVertex(Vector2(bar_right, MARGIN + BAR_HEIGHT));
+      render_system->sendVertex(Vector2(MARGIN, MARGIN + BAR_HEIGHT));
+    render_system->endPrimitive();
+
+    render_system->setColor(ColorRGB(1, 1, 1));
+    drawOverlayText(MARGIN, MARGIN + BAR_HEIGHT + 8,
+                    format("Decimating: %.1f%%, %ld faces, %.1fs elapsed (showing snapshot, press Esc to quit)",
+                           100 * progress, displayed_snapshot->num_faces, displayed_snapshot->elapsed_time));
+
+  endOverlay();
+}
+
+void
+Viewer::pick(int x, int y)
+{
+  if (!mesh || lod_mesh || decimation_worker.isActive() || width <= 0 || height <= 0)
+    return;
+
+  // The hierarchy is built on first use, and afterwards kept up to date with the edits made by decimation
+  if (picker.getMesh() != mesh)
+  {
+    double start_time = System::time();
+    picker.build(*mesh);
+    DGP_CONSOLE << "Built picking hierarchy over " << mesh->numFaces() << " faces in " << System::time() - start_time << "s";
+  }
+
+  double start_time = System::time();
+  picker.update(mesh_changes);
+
+  Vector2 screen_pos(2 * x / (Real)width - 1, 1 - 2 * y / (Real)height);
+  if (!picker.pick(camera.computePickRay(screen_pos), picked))
+    picked = MeshPicker::Hit();
+
+  pick_seconds = System::time() - start_time;
+
+  if (picked.vertex)
+  {
+    DGP_CONSOLE << "Picked vertex at " << picked.vertex->getPosition().toString() << ": valence " << picked.vertex->degree()
+                << ", quadric error " << ViewerInternal::quadricError(*mesh, *picked.vertex)
+                << "; nearest edge has collapse cost " << ViewerInternal::collapseCost(*mesh, *picked.edge)
+                << " (" << 1.0e6 * pick_seconds << "us)";
+  }
+
+  glutPostRedisplay();
+}
+
+void
+Viewer::resetMeshState()
+{
+  mesh_changes.clear();
+  highlighted_vertex = NULL;
+  picker.clear();
+  picked = MeshPicker::Hit();
+}
+
+void
+Viewer::toggleLOD()
+{
+  if (!mesh)
+    return;
+
+  decimating = false;
+  resetMeshState();
+
+  if (lod_mesh)
+  {
+    lod_mesh->extract(*mesh);
+    mesh->updateBounds();
+
+    delete lod_mesh;
+    lod_mesh = NULL;
+
+    DGP_CONSOLE << "Selected level of detail has " << mesh->numVertices() << " vertices, " << mesh->numEdges()
+                << " edges and " << mesh->numFaces() << " faces";
+  }
+  else
+  {
+    long num_faces = mesh->numFaces();
+
+    lod_mesh = new ProgressiveMesh;
+    ProgressReporter progress("Precomputing levels of detail", 0, 500);
+    lod_mesh->build(*mesh, 0, &progress);
+    lod_mesh->setLevel(0);
+    view_dependent_lod = false;
+
+    DGP_CONSOLE << "Precomputed " << lod_mesh->numLevels() << " levels of detail, with " << num_faces << " to "
+                << lod_mesh->numFacesAtLevel(lod_mesh->numLevels() - 1) << " faces";
+  }
+}
+
+void
+Viewer::setLODNumFaces(long num_faces)
+{
+  if (!lod_mesh)
+    return;
+
+  if (view_dependent_lod)
+    lod_face_budget = std::max(std::min(num_faces, lod_mesh->numFacesAtLevel(0)), 1L);
+  else
+  {
+    long old_level = lod_mesh->getLevel();
+    lod_mesh->setLevel(lod_mesh->levelForNumFaces(num_faces));
+    ViewerInternal::collapse_meter.add(std::abs(lod_mesh->getLevel() - old_level));
+  }
+
+  glutPostRedisplay();
+}
+
+bool
+Viewer::isOnSlider(int x, int y)
+{
+  using namespace ViewerInternal;
+
+  // GLUT measures y from the top of the window, overlays from the bottom
+  return lod_mesh
+      && height - y < OVERLAY_MARGIN + SLIDER_HIT_HEIGHT
+      && x >= OVERLAY_MARGIN / 2 && x <= width - OVERLAY_MARGIN / 2;
+}
+
+void
+Viewer::setLODFromSlider(int x)
+{
+  using namespace ViewerInternal;
+
+  if (!lod_mesh || width <= 2 * OVERLAY_MARGIN)
+    return;
+
+  // The slider has a logarithmic scale, from the coarsest level at the left to the original mesh at the right
+  double max_faces = std::max(lod_mesh->numFacesAtLevel(0), 1L);
+  double min_faces = std::max(lod_mesh->numFacesAtLevel(lod_mesh->numLevels() - 1), 1L);
+  double t = Math::clamp((x - OVERLAY_MARGIN) / (double)(width - 2 * OVERLAY_MARGIN), 0.0, 1.0);
+
+  setLODNumFaces((long)std::floor(min_faces * std::pow(max_faces / min_faces, t) + 0.5));
+}
+
+void
+Viewer::drawLOD()
+{
+  using namespace ViewerInternal;
+
+  static Graphics::Shader * lod_shader = NULL;
+  if (!lod_shader)
+  {
+    lod_shader = render_system->createShader("LOD shader");
+    if (!lod_shader || !initMeshShader(*lod_shader, /* derive_normals = */ true))
+      return;
+  }
+
+  // Refine the mesh incrementally for the current view, and keep redrawing until it has converged
+  if (view_dependent_lod)
+  {
+    long num_changes = lod_mesh->adaptToView(camera, height, LOD_PIXEL_TOLERANCE, lod_face_budget, LOD_CHANGES_PER_FRAME);
+    if (num_changes > 0)
+    {
+      collapse_meter.add(num_changes);
+      glutPostRedisplay();
+    }
+  }
+
+  render_system->setMatrixMode(Graphics::RenderSystem::MatrixMode::MODELVIEW); render_system->pushMatrix();
+  render_system->setMatrixMode(Graphics::RenderSystem::MatrixMode::PROJECTION); render_system->pushMatrix();
+
+    render_system->setCamera(camera);
+
+    render_system->pushShader();
+      render_system->setShader(lod_shader);
+      render_system->setColor(ColorRGB(1, 1, 1));
+      lod_mesh->draw(*render_system);
+      frame_triangles += lod_mesh->numDrawnTriangles();
+    render_system->popShader();
+
+  render_system->setMatrixMode(Graphics::RenderSystem::MatrixMode::PROJECTION); render_system->popMatrix();
+  render_system->setMatrixMode(Graphics::RenderSystem::MatrixMode::MODELVIEW); render_system->popMatrix();
+
+  // Slider along the bottom of the window, with the position of the current level (or face budget) marked
+  double max_faces = std::max(lod_mesh->numFacesAtLevel(0), 1L);
+  double min_faces = std::max(lod_mesh->numFacesAtLevel(lod_mesh->numLevels() - 1), 1L);
+  double knob_faces = std::max(view_dependent_lod ? lod_face_budget : lod_mesh->numFaces(), 1L);
+  double t = (max_faces > min_faces ? Math::clamp(std::log(knob_faces / min_faces) / std::log(max_faces / min_faces), 0.0, 1.0)
+                                    : 1.0);
+  Real knob_x = (Real)(OVERLAY_MARGIN + t * (width - 2 * OVERLAY_MARGIN));
+
+  beginOverlay();
+
+    render_system->setColor(ColorRGB(0.3f, 0.3f, 0.3f));
+    render_system->beginPrimitive(Graphics::RenderSystem::Primitive::QUADS);
+      render_system->sendVertex(Vector2(OVERLAY_MARGIN, OVERLAY_MARGIN));
+      render_system->sendVertex(Vector2(width - OVERLAY_MARGIN, OVERLAY_MARGIN));
+      render_system->sendVertex(Vector2(width - OVERLAY_MARGIN, OVERLAY_MARGIN + BAR_HEIGHT));
+      render_system->sendVertex(Vector2(OVERLAY_MARGIN, OVERLAY_MARGIN + BAR_HEIGHT));
+    render_system->endPrimitive();
+
+    render_system->setColor(ColorRGB(1, 0.8f, 0.2f));
+    render_system->beginPrimitive(Graphics::RenderSystem::Primitive::QUADS);
+      render_system->sendVertex(Vector2(knob_x - 3, OVERLAY_MARGIN - 4));
+      render_system->sendVertex(Vector2(knob_x + 3, OVERLAY_MARGIN - 4));
+      render_system->sendVertex(Vector2(knob_x + 3, OVERLAY_MARGIN + BAR_HEIGHT + 4));
+      render_system->sendVertex(Vector2(knob_x - 3, OVERLAY_MARGIN + BAR_HEIGHT + 4));
+    render_system->endPrimitive();
+
+    render_system->setColor(ColorRGB(1, 1, 1));
+    if (view_dependent_lod)
+      drawOverlayText(OVERLAY_MARGIN, OVERLAY_MARGIN + BAR_HEIGHT + 8,
+                      format("View-dependent level of detail: %ld faces, budget %ld (drag or press +/- to change, V for "
+                             "uniform, L to keep)", lod_mesh->numFaces(), lod_face_budget));
+    else
+      drawOverlayText(OVERLAY_MARGIN, OVERLAY_MARGIN + BAR_HEIGHT + 8,
+                      format("Level of detail: %ld faces (level %ld of %ld; drag or press +/- to change, V for view-dependent, "
+                             "L to keep)", lod_mesh->numFaces(), lod_mesh->getLevel(), lod_mesh->numLevels() - 1));
+
+  endOverlay();
+}
+
+void
+Viewer::drawHUD()
+{
+  using namespace ViewerInternal;
+
+  double fps = frame_stopwatch.smoothFPS();
+
+  std::vector<std::string> lines;
+  lines.push_back(format("Frame: %.2f ms to draw, %.1f fps", 1000 * frame_stopwatch.smoothElapsedTime(), fps));
+  lines.push_back(format("Triangles: %ld per frame, %.2fM per second", frame_triangles, frame_triangles * fps / 1.0e6));
+  lines.push_back(format("Collapses: %.0f per second", collapse_meter.getRate()));
+
+  if (decimation_worker.isActive())
+  {
+    if (displayed_snapshot)
+      lines.push_back(format("Mesh (snapshot): %ld faces, %ld vertices", displayed_snapshot->num_faces,
+                             displayed_snapshot->num_vertices));
+  }
+  else if (lod_mesh)
+    lines.push_back(format("Level of detail: %ld faces, %ld collapses applied", lod_mesh->numFaces(), lod_mesh->getLevel()));
+  else if (mesh)
+    lines.push_back(format("Mesh: %ld faces, %ld vertices, %ld edges, %ld edges in collapse heap", mesh->numFaces(),
+                           mesh->numVertices(), mesh->numEdges(), mesh->edgeHeapSize()));
+
+  // Lines run down from the top left corner
+  static int const LINE_HEIGHT = 16;
+
+  beginOverlay();
+
+    render_system->setColor(ColorRGB(1, 1, 0.6f));
+    for (size_t i = 0; i < lines.size(); ++i)
+      drawOverlayText(OVERLAY_MARGIN, height - OVERLAY_MARGIN - LINE_HEIGHT * (int)(i + 1), lines[i]);
+
+  endOverlay();
+}
+
+void
+Viewer::beginOverlay()
+{
+  render_system->pushShader();
+  render_system->pushDepthFlags();
+  render_system->pushColorFlags();
+
+  render_system->setShader(NULL);
+  render_system->setDepthTest(Graphics::RenderSystem::DepthTest::ALWAYS_PASS);
+  render_system->setDepthWrite(false);
+
+  render_system->setMatrixMode(Graphics::RenderSystem::MatrixMode::PROJECTION); render_system->pushMatrix();
+  render_system->setMatrix(Matrix4::orthogonalProjection(0, (Real)width, 0, (Real)height, -1, 1));
+  render_system->setMatrixMode(Graphics::RenderSystem::MatrixMode::MODELVIEW); render_system->pushMatrix();
+  render_system->setIdentityMatrix();
+}
+
+void
+Viewer::endOverlay()
+{
+  render_system->setMatrixMode(Graphics::RenderSystem::MatrixMode::PROJECTION); render_system->popMatrix();
+  render_system->setMatrixMode(Graphics::RenderSystem::MatrixMode::MODELVIEW); render_system->popMatrix();
+
+  render_system->popColorFlags();
+  render_system->popDepthFlags();
+  render_system->popShader();
+}
+
+void
+Viewer::drawOverlayText(int x, int y, std::string const & text)
+{
+  glRasterPos2i(x, y);
+  for (size_t i = 0; i < text.length(); ++i)
+    glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, text[i]);
+}
+
 void
 Viewer::drawOutlineBox(AxisAlignedBox3 const & bbox)
 {
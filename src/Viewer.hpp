@@ -2,14 +2,17 @@
 #define __A2_Viewer_hpp__
 
 #include "Common.hpp"
+#include "DecimationWorker.hpp"
+#include "Mesh.hpp"
+#include "MeshPicker.hpp"
 #include "DGP/AxisAlignedBox3.hpp"
 #include "DGP/Camera.hpp"
 #include "DGP/Matrix3.hpp"
+#include "DGP/Stopwatch.hpp"
 #include "DGP/Graphics/RenderSystem.hpp"
 
 // Forward declaration
-class Mesh;
-class MeshVertex;
+class ProgressiveMesh;
 
 /* Displays an object using OpenGL and GLUT. */
 class Viewer
@@ -29,11 +32,36 @@ class Viewer
     static bool show_bbox;
     static bool show_edges;
     static MeshVertex const * highlighted_vertex;
+    static bool decimating;
+    static Mesh::Changes mesh_changes;
+    static DecimationWorker decimation_worker;
+    static DecimationWorker::SnapshotPtr displayed_snapshot;
+    static Graphics::VARArea * snapshot_area;
+    static Graphics::VAR * snapshot_positions;
+    static Graphics::VAR * snapshot_normals;
+    static Graphics::VAR * snapshot_indices;
+    static double last_frame_time;
+    static ProgressiveMesh * lod_mesh;
+    static bool dragging_slider;
+    static bool view_dependent_lod;
+    static long lod_face_budget;
+    static MeshPicker picker;
+    static MeshPicker::Hit picked;
+    static double pick_seconds;
+    static bool show_hud;
+    static Stopwatch frame_stopwatch;
+    static long frame_triangles;
 
   public:
     /** Set the object to be displayed. The object must persist as long as the viewer does. */
     static void setObject(Mesh * o);
 
+    /**
+     * Decimate the object to a target number of faces on a background thread, displaying intermediate results as they become
+     * available. Has no effect if a background decimation is already in progress.
+     */
+    static void decimateInBackground(long target_num_faces);
+
     /**
      * Call this function to launch the viewer. It will not return under normal circumstances, so make sure stuff is set up
      * before you call it!
@@ -50,12 +78,75 @@ class Viewer
     /** Callback when a key is pressed. */
     static void keyPress(unsigned char key, int x, int y);
 
+    /** Callback when a key is released. */
+    static void keyRelease(unsigned char key, int x, int y);
+
+    /** Callback when there are no events to process. Decimates the mesh while the decimation key is held down. */
+    static void idle();
+
+    /**
+     * Collapse edges of the mesh until a time limit (in seconds) is exceeded, collapsing at least one edge. The changes are
+     * recorded so that they can be sent to the GPU incrementally when the mesh is next drawn.
+     *
+     * @return The number of edges collapsed.
+     */
+    static long decimate(double max_seconds);
+
     /** Callback when a mouse button is pressed. */
     static void mousePress(int button, int state, int x, int y);
 
     /** Callback when the mouse moves with a button pressed. */
     static void mouseMotion(int x, int y);
 
+    /**
+     * Check on a background decimation, if any. If it has completed, the decimated object is reclaimed.
+     *
+     * @return True if the background decimation is still running.
+     */
+    static bool updateBackgroundDecimation();
+
+    /** Draw the latest snapshot published by the background decimation, followed by a progress overlay. */
+    static void drawSnapshot();
+
+    /**
+     * Switch to level-of-detail mode, by precomputing a sequence of collapses for the object, or back to normal mode, in which
+     * case the object is replaced by the currently selected level of detail.
+     */
+    static void toggleLOD();
+
+    /**
+     * Show the level of detail with at most a given number of faces. With view-dependent refinement, this sets the budget for the
+     * number of faces instead.
+     */
+    static void setLODNumFaces(long num_faces);
+
+    /** Check if a pixel position (in GLUT coordinates) lies on the level-of-detail slider. */
+    static bool isOnSlider(int x, int y);
+
+    /** Select the level of detail corresponding to a horizontal pixel position on the slider. */
+    static void setLODFromSlider(int x);
+
+    /** Draw the current level of detail, followed by the slider. */
+    static void drawLOD();
+
+    /** Select the vertex and edge under a pixel position (in GLUT coordinates), and print information about them. */
+    static void pick(int x, int y);
+
+    /** Forget the current selection and anything else that refers to the mesh, when the mesh is about to be changed wholesale. */
+    static void resetMeshState();
+
+    /** Draw frame statistics, decimation throughput and mesh statistics over the scene. */
+    static void drawHUD();
+
+    /** Set up the rendersystem to draw 2D overlays in pixel coordinates, with the origin at the bottom left of the window. */
+    static void beginOverlay();
+
+    /** Restore the rendersystem state after drawing overlays. */
+    static void endOverlay();
+
+    /** Draw a line of text in an overlay, with its baseline starting at a given pixel position. */
+    static void drawOverlayText(int x, int y, std::string const & text);
+
     /** Draw a bounding box as an outline. */
     static void drawOutlineBox(AxisAlignedBox3 const & bbox);
 
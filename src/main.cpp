@@ -1,49 +1,273 @@
 #include "Mesh.hpp"
+#include "MeshError.hpp"
 #include "Viewer.hpp"
+#include "DGP/FilePath.hpp"
+#include "DGP/FileSystem.hpp"
+#include "DGP/Parallel.hpp"
+#include "DGP/Stopwatch.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <numeric>
 
 int
 usage(int argc, char * argv[])
 {
   DGP_CONSOLE << "";
-  DGP_CONSOLE << "Usage: " << argv[0] << " <mesh-in> [<target-num-faces> [<mesh-out>]]";
+  DGP_CONSOLE << "Usage: " << argv[0] << " <mesh-in> [<target-num-faces> [<mesh-out>]] [options]";
+  DGP_CONSOLE << "       " << argv[0] << " -budget <total-num-faces> <mesh-in> [<mesh-in> ...] [-out <prefix>] [-threads <n>]";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "Options:";
+  DGP_CONSOLE << "  -error <n>   After decimation, measure the Hausdorff and RMS error w.r.t. the input with n samples per mesh";
+  DGP_CONSOLE << "  -background  Decimate in the background while the viewer shows progress (no output mesh or error)";
+  DGP_CONSOLE << "  -triangulate Split faces with more than three vertices into triangles after loading";
+  DGP_CONSOLE << "  -choices <k> Decimate by collapsing the cheapest of k random edges at each step, instead of the cheapest";
+  DGP_CONSOLE << "               of all edges. Faster and uses less memory, with a somewhat larger error. Not available with";
+  DGP_CONSOLE << "               -background or -checkpoint";
+  DGP_CONSOLE << "  -threads <n> Decimate by collapsing edges on n threads at once (0 for one per hardware thread), taking edges";
+  DGP_CONSOLE << "               roughly in order of cost. Not available with -background, -choices or -checkpoint";
+  DGP_CONSOLE << "  -partitions <p>";
+  DGP_CONSOLE << "               Decimate p regions of the mesh in parallel (0 for one per hardware thread), then finish across";
+  DGP_CONSOLE << "               their borders. Not available with -background, -choices, -threads or -checkpoint";
+  DGP_CONSOLE << "  -components <n>";
+  DGP_CONSOLE << "               Decimate each connected component on its own thread, n at once (0 for one per hardware thread),";
+  DGP_CONSOLE << "               sharing the target so that all reach the same error. Not available with -background, -choices,";
+  DGP_CONSOLE << "               -threads, -partitions or -checkpoint";
+  DGP_CONSOLE << "  -checkpoint <file>";
+  DGP_CONSOLE << "               Save the decimation state to this file every so often, and resume from it if it exists. The";
+  DGP_CONSOLE << "               file is deleted once the output has been saved";
+  DGP_CONSOLE << "  -checkpoint-interval <n>";
+  DGP_CONSOLE << "               Save a checkpoint every n edge collapses (default 100000)";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "With -budget, all the meshes are decimated together to a total number of faces, collapsing edges in order of";
+  DGP_CONSOLE << "error across all of them, on n threads (default: one per hardware thread). Each decimated mesh is saved as";
+  DGP_CONSOLE << "<prefix><name of mesh-in>, if -out is given. The viewer is not shown";
   DGP_CONSOLE << "";
 
   return -1;
 }
 
+// Load several meshes, decimate them together to a total number of faces and save them, returning the exit code
+int
+decimateScene(std::vector<char *> const & in_paths, long budget, long num_threads, std::string const & out_prefix)
+{
+  // Write console output from a background thread, so that progress reports don't hold up decimation
+  AsyncLogSink log_sink;
+  AsyncLogSink::setGlobal(&log_sink);
+
+  long num_meshes = (long)in_paths.size();
+  std::vector<Mesh> meshes((size_t)num_meshes);
+  std::vector<uint8> loaded((size_t)num_meshes, 0);
+  Parallel::forEach(0, num_meshes, [&](long i) { loaded[(size_t)i] = meshes[(size_t)i].load(in_paths[(size_t)i]); },
+                    Parallel::numThreads(num_meshes, num_threads));
+
+  if (std::count(loaded.begin(), loaded.end(), 0) > 0)
+    return -1;
+
+  std::vector<Mesh *> mesh_ptrs;
+  std::vector<long> initial_num_faces;
+  for (size_t i = 0; i < meshes.size(); ++i)
+  {
+    mesh_ptrs.push_back(&meshes[i]);
+    initial_num_faces.push_back(meshes[i].numFaces());
+  }
+
+  long total_num_faces = std::accumulate(initial_num_faces.begin(), initial_num_faces.end(), 0L);
+  DGP_CONSOLE << "Read " << num_meshes << " meshes with " << total_num_faces << " faces in total";
+
+  if (total_num_faces > budget)
+  {
+    ProgressReporter progress("Decimating", 0, 500);
+    Mesh::ComponentStats stats = Mesh::decimateScene(mesh_ptrs, budget, (num_threads > 0 ? num_threads : -1), &progress);
+    DGP_CONSOLE << "Decimated " << stats.num_components << " components in " << stats.num_rounds << " parallel rounds and "
+                << stats.num_final_collapses << " final collapses, up to an error of " << stats.error_threshold;
+  }
+
+  for (size_t i = 0; i < meshes.size(); ++i)
+    DGP_CONSOLE << "  " << FilePath::objectName(in_paths[i]) << ": " << initial_num_faces[i] << " -> " << meshes[i].numFaces()
+                << " faces";
+
+  if (!out_prefix.empty())
+  {
+    std::vector<uint8> saved((size_t)num_meshes, 0);
+    Parallel::forEach(0, num_meshes, [&](long i)
+    {
+      saved[(size_t)i] = meshes[(size_t)i].save(out_prefix + FilePath::objectName(in_paths[(size_t)i]));
+    }, Parallel::numThreads(num_meshes, num_threads));
+
+    if (std::count(saved.begin(), saved.end(), 0) > 0)
+      return -1;
+
+    DGP_CONSOLE << "Saved meshes to " << out_prefix << "*";
+  }
+
+  return 0;
+}
+
 int
 main(int argc, char * argv[])
 {
-  if (argc < 2)
+  // Separate positional arguments from options
+  std::vector<char *> args;
+  long num_error_samples = 0;
+  bool background = false;
+  bool triangulate = false;
+  std::string checkpoint_path;
+  long checkpoint_interval = 100000;
+  long num_choices = 0;
+  long num_threads = -1;  // not concurrent
+  long num_partitions = -1;  // not partitioned
+  long num_component_threads = -1;  // not by components
+  long budget = -1;  // no scene budget
+  std::string out_prefix;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (argv[i][0] == '-' && std::isalpha(argv[i][1]))
+    {
+      if (std::strcmp(argv[i], "-error") == 0 && i + 1 < argc)
+        num_error_samples = std::atol(argv[++i]);
+      else if (std::strcmp(argv[i], "-background") == 0)
+        background = true;
+      else if (std::strcmp(argv[i], "-triangulate") == 0)
+        triangulate = true;
+      else if (std::strcmp(argv[i], "-choices") == 0 && i + 1 < argc)
+        num_choices = std::atol(argv[++i]);
+      else if (std::strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+        num_threads = std::max(std::atol(argv[++i]), 0L);
+      else if (std::strcmp(argv[i], "-partitions") == 0 && i + 1 < argc)
+        num_partitions = std::max(std::atol(argv[++i]), 0L);
+      else if (std::strcmp(argv[i], "-components") == 0 && i + 1 < argc)
+        num_component_threads = std::max(std::atol(argv[++i]), 0L);
+      else if (std::strcmp(argv[i], "-budget") == 0 && i + 1 < argc)
+        budget = std::max(std::atol(argv[++i]), 0L);
+      else if (std::strcmp(argv[i], "-out") == 0 && i + 1 < argc)
+        out_prefix = argv[++i];
+      else if (std::strcmp(argv[i], "-checkpoint") == 0 && i + 1 < argc)
+        checkpoint_path = argv[++i];
+      else if (std::strcmp(argv[i], "-checkpoint-interval") == 0 && i + 1 < argc)
+        checkpoint_interval = std::atol(argv[++i]);
+      else
+        return usage(argc, argv);
+    }
+    else
+      args.push_back(argv[i]);
+  }
+
+  if (args.empty() || num_choices < 0 || (num_choices > 0 && (background || !checkpoint_path.empty()))
+   || (num_threads >= 0 && (background || num_choices > 0 || !checkpoint_path.empty()))
+   || (num_partitions >= 0 && (background || num_choices > 0 || num_threads >= 0 || !checkpoint_path.empty()))
+   || (num_component_threads >= 0
+    && (background || num_choices > 0 || num_threads >= 0 || num_partitions >= 0 || !checkpoint_path.empty())))
+    return usage(argc, argv);
+
+  if (budget >= 0)
+  {
+    if (background || triangulate || num_error_samples > 0 || num_choices > 0 || num_partitions >= 0
+     || num_component_threads >= 0 || !checkpoint_path.empty())
+      return usage(argc, argv);
+
+    return decimateScene(args, budget, num_threads, out_prefix);
+  }
+  else if (!out_prefix.empty())
     return usage(argc, argv);
 
-  std::string in_path = argv[1];
+  std::string in_path = args[0];
 
   long target_num_faces = -1;
   std::string out_path;
-  if (argc >= 3)
+  if (args.size() >= 2)
   {
-    target_num_faces = std::atoi(argv[2]);
+    target_num_faces = std::atoi(args[1]);
 
-    if (argc >= 4)
-      out_path = argv[3];
+    if (args.size() >= 3)
+      out_path = args[2];
   }
 
+  // Write console output from a background thread, so that progress reports don't hold up decimation
+  AsyncLogSink log_sink;
+  AsyncLogSink::setGlobal(&log_sink);
+
+  // Resume an interrupted decimation if there is a checkpoint
   Mesh mesh;
-  if (!mesh.load(in_path))
-    return -1;
+  bool resumed = false;
+  if (!checkpoint_path.empty() && FileSystem::fileExists(checkpoint_path))
+  {
+    if (!mesh.loadCheckpoint(checkpoint_path))
+      return -1;
+
+    resumed = true;
+    DGP_CONSOLE << "Resumed mesh '" << mesh.getName() << "' with " << mesh.numVertices() << " vertices, " << mesh.numEdges()
+                << " edges and " << mesh.numFaces() << " faces from checkpoint " << checkpoint_path;
+  }
+  else
+  {
+    if (!mesh.load(in_path, triangulate))
+      return -1;
 
-  DGP_CONSOLE << "Read mesh '" << mesh.getName() << "' with " << mesh.numVertices() << " vertices, " << mesh.numEdges()
-              << " edges and " << mesh.numFaces() << " faces from " << in_path;
+    DGP_CONSOLE << "Read mesh '" << mesh.getName() << "' with " << mesh.numVertices() << " vertices, " << mesh.numEdges()
+                << " edges and " << mesh.numFaces() << " faces from " << in_path;
+  }
 
-  if (target_num_faces >= 0 && mesh.numFaces() > target_num_faces)
+  Viewer viewer;
+  viewer.setObject(&mesh);
+
+  if (background && target_num_faces >= 0)
+    viewer.decimateInBackground(target_num_faces);
+  else if (target_num_faces >= 0 && mesh.numFaces() > target_num_faces)
   {
-    mesh.decimateQuadricEdgeCollapse(target_num_faces);
+    // Keep a copy of the input to measure error against, instead of loading it again (unless decimation has already started)
+    Mesh original;
+    if (num_error_samples > 0)
+    {
+      if (!resumed)
+        mesh.copyTo(original);
+      else if (!original.load(in_path, triangulate))
+        return -1;
+    }
+
+    ProgressReporter progress("Decimating", 0, 500);
+    if (num_choices > 0)
+      mesh.decimateMultipleChoice(target_num_faces, (int)num_choices, 0, &progress);
+    else if (num_component_threads >= 0)
+    {
+      Mesh::ComponentStats stats = mesh.decimateComponents(target_num_faces,
+                                                           (num_component_threads > 0 ? num_component_threads : -1), &progress);
+      DGP_CONSOLE << "Decimated " << stats.num_components << " components in " << stats.num_rounds << " parallel rounds and "
+                  << stats.num_final_collapses << " final collapses, up to an error of " << stats.error_threshold;
+    }
+    else if (num_partitions >= 0)
+    {
+      Mesh::PartitionedStats stats = mesh.decimatePartitioned(target_num_faces, (num_partitions > 0 ? num_partitions : -1),
+                                                              &progress);
+      DGP_CONSOLE << "Collapsed " << stats.num_region_collapses << " edges in " << stats.num_partitions << " regions and "
+                  << stats.num_seam_collapses << " in the final pass";
+    }
+    else if (num_threads >= 0)
+    {
+      Mesh::ConcurrentStats stats = mesh.decimateConcurrent(target_num_faces, (num_threads > 0 ? num_threads : -1), &progress);
+      DGP_CONSOLE << "Collapsed " << stats.num_collapses << " edges, with " << stats.num_conflicts
+                  << " edges put back because another thread was working nearby";
+    }
+    else
+      mesh.decimateQuadricEdgeCollapse(target_num_faces, checkpoint_path, checkpoint_path.empty() ? 0 : checkpoint_interval,
+                                       &progress);
     mesh.updateBounds();
+
+    if (num_error_samples > 0)
+    {
+      Stopwatch timer;
+      timer.tick();
+      MeshError::Result error = MeshError::compute(original, mesh, num_error_samples);
+      timer.tock();
+
+      DGP_CONSOLE << "Error of decimated mesh (input = A, output = B), measured in " << timer.elapsedTime() << "s:\n"
+                  << error.toString();
+    }
   }
 
-  if (!out_path.empty())
+  if (!out_path.empty() && !background)
   {
     if (!mesh.save(out_path))
       return -1;
@@ -51,8 +275,15 @@ main(int argc, char * argv[])
     DGP_CONSOLE << "Saved mesh to " << out_path;
   }
 
-  Viewer viewer;
-  viewer.setObject(&mesh);
+  // The result is complete, so there is nothing to resume
+  if (!checkpoint_path.empty() && !background)
+    std::remove(checkpoint_path.c_str());
+
+  // The viewer exits the process without returning, so the sink would never be destroyed and its queued messages would be
+  // lost. Write them now, and log directly from here on.
+  log_sink.flush();
+  AsyncLogSink::setGlobal(NULL);
+
   viewer.launch(argc, argv);
 
   return 0;
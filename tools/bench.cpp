@@ -0,0 +1,798 @@
+#include "Mesh.hpp"
+#include "MeshError.hpp"
+#include "MeshGenerator.hpp"
+#include "DGP/FilePath.hpp"
+#include "DGP/Parallel.hpp"
+#include "DGP/Stopwatch.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <new>
+#include <vector>
+
+#ifndef DGP_WINDOWS
+#  include <sys/wait.h>
+#  include <unistd.h>
+#endif
+
+namespace BenchInternal {
+
+// Bytes currently allocated with operator new, and the most allocated since the last call to resetPeakAllocated(). Resident
+// memory is too coarse to show the memory taken by decimation, since the allocator reuses memory freed by earlier steps.
+std::atomic<size_t> allocated(0);
+std::atomic<size_t> peak_allocated(0);
+
+// Each allocation is prefixed with its size, in a header that keeps the alignment of malloc()
+enum { HEADER_SIZE = 16 };
+
+} // namespace BenchInternal
+
+void *
+operator new(std::size_t size)
+{
+  using namespace BenchInternal;
+
+  void * block = std::malloc(size + HEADER_SIZE);
+  if (!block)
+    throw std::bad_alloc();
+
+  *static_cast<std::size_t *>(block) = size;
+
+  size_t now = (allocated += size);
+  size_t peak = peak_allocated.load();
+  while (now > peak && !peak_allocated.compare_exchange_weak(peak, now)) {}
+
+  return static_cast<char *>(block) + HEADER_SIZE;
+}
+
+void
+operator delete(void * ptr) noexcept
+{
+  using namespace BenchInternal;
+
+  if (!ptr)
+    return;
+
+  void * block = static_cast<char *>(ptr) - HEADER_SIZE;
+  allocated -= *static_cast<std::size_t *>(block);
+  std::free(block);
+}
+
+// Reset the peak of memory allocated with operator new to the current amount, and return it in MB.
+double
+resetPeakAllocated()
+{
+  BenchInternal::peak_allocated = BenchInternal::allocated.load();
+  return BenchInternal::allocated.load() / (1024.0 * 1024.0);
+}
+
+// Get the peak of memory allocated with operator new since the last call to resetPeakAllocated(), in MB.
+double
+getPeakAllocated()
+{
+  return BenchInternal::peak_allocated.load() / (1024.0 * 1024.0);
+}
+
+// Resident and peak resident memory of this process in MB, from /proc (zero where unavailable).
+void
+getMemoryUsage(double & resident_mb, double & peak_mb)
+{
+  resident_mb = peak_mb = 0;
+
+  std::ifstream in("/proc/self/status");
+  std::string key;
+  long kb;
+  while (in >> key)
+  {
+    if (key == "VmRSS:" && in >> kb)       resident_mb = kb / 1024.0;
+    else if (key == "VmHWM:" && in >> kb)  peak_mb = kb / 1024.0;
+  }
+}
+
+int
+usage(int argc, char * argv[])
+{
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "Usage: " << argv[0] << " scaling <shape> <min-faces> <max-faces> [options]";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "  Generates meshes of increasing size, and reports time and memory taken to load and decimate each.";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "  -factor <f>    Growth factor between successive sizes (default: 2)";
+  DGP_CONSOLE << "  -ratio <r>     Decimate each mesh to this fraction of its faces, or 0 to skip decimation (default: 0.5)";
+  DGP_CONSOLE << "  -dir <path>    Scratch directory for generated meshes (default: .)";
+  DGP_CONSOLE << "  -keep          Keep generated meshes instead of deleting them";
+  DGP_CONSOLE << "  -csv           Print comma-separated values instead of a table";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "  Shape options -valence, -aspect, -pages, -genus, -noise and -seed are as for 'generate'.";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "Usage: " << argv[0] << " fan <min-valence> <max-valence> [options]";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "  Generates closed fans whose two poles have increasing valence, and reports time and memory taken to load and";
+  DGP_CONSOLE << "  decimate each. Collapses at the poles are the worst case for work proportional to vertex valence.";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "  -factor <f>    Growth factor between successive valences (default: 2)";
+  DGP_CONSOLE << "  -rings <r>     Number of rings of vertices between the poles, for 2 * valence * rings faces (default: 4)";
+  DGP_CONSOLE << "  -ratio <r>     Decimate each mesh to this fraction of its faces, or 0 to skip decimation (default: 0.5)";
+  DGP_CONSOLE << "  -dir <path>    Scratch directory for generated meshes (default: .)";
+  DGP_CONSOLE << "  -keep          Keep generated meshes instead of deleting them";
+  DGP_CONSOLE << "  -csv           Print comma-separated values instead of a table";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "Usage: " << argv[0] << " precision <mesh> [<mesh> ...] [options]";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "  Decimates each mesh, and reports the time taken and the distance between the input and output, for the quadric";
+  DGP_CONSOLE << "  precision this program was built with. Build with 'make QUADRIC_PRECISION=float' and without to compare.";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "  -ratio <r>     Decimate each mesh to this fraction of its faces (default: 0.25)";
+  DGP_CONSOLE << "  -samples <n>   Number of surface samples used to measure error (default: 100000)";
+  DGP_CONSOLE << "  -csv           Print comma-separated values instead of a table";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "Usage: " << argv[0] << " choices <mesh> [<mesh> ...] [options]";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "  Decimates each mesh with the priority queue and with the multiple-choice scheme, and reports the time and";
+  DGP_CONSOLE << "  memory taken and the distance between the input and output for each.";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "  -ratio <r>     Decimate each mesh to this fraction of its faces (default: 0.25)";
+  DGP_CONSOLE << "  -choices <k>   Number of edges sampled per collapse. May be given several times (default: 8)";
+  DGP_CONSOLE << "  -samples <n>   Number of surface samples used to measure error (default: 100000)";
+  DGP_CONSOLE << "  -csv           Print comma-separated values instead of a table";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "Usage: " << argv[0] << " concurrent <mesh> [<mesh> ...] [options]";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "  Decimates each mesh with the priority queue and with concurrent collapses on several threads, and reports the";
+  DGP_CONSOLE << "  throughput in collapses per second, overall and per thread, and the distance between the input and output.";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "  -threads <n>   Number of threads. May be given several times (default: one per hardware thread)";
+  DGP_CONSOLE << "  -ratio <r>     Decimate each mesh to this fraction of its faces (default: 0.25)";
+  DGP_CONSOLE << "  -samples <n>   Number of surface samples used to measure error (default: 100000)";
+  DGP_CONSOLE << "  -csv           Print comma-separated values instead of a table";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "Usage: " << argv[0] << " partitions <mesh> [<mesh> ...] [options]";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "  Decimates each mesh with the priority queue and by regions in parallel followed by a pass across their seams,";
+  DGP_CONSOLE << "  and reports the time taken, the collapses left to the final pass and the distance between the input and output.";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "  -partitions <p> Number of regions. May be given several times (default: one per hardware thread)";
+  DGP_CONSOLE << "  -ratio <r>     Decimate each mesh to this fraction of its faces (default: 0.25)";
+  DGP_CONSOLE << "  -samples <n>   Number of surface samples used to measure error (default: 100000)";
+  DGP_CONSOLE << "  -csv           Print comma-separated values instead of a table";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "Usage: " << argv[0] << " components <mesh> [<mesh> ...] [options]";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "  Decimates each mesh with the priority queue and by connected components in parallel, and reports the time";
+  DGP_CONSOLE << "  taken, the number of components and the distance between the input and output.";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "  -threads <n>   Number of threads. May be given several times (default: one per hardware thread)";
+  DGP_CONSOLE << "  -ratio <r>     Decimate each mesh to this fraction of its faces (default: 0.25)";
+  DGP_CONSOLE << "  -samples <n>   Number of surface samples used to measure error (default: 100000)";
+  DGP_CONSOLE << "  -csv           Print comma-separated values instead of a table";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "Usage: " << argv[0] << " targets <mesh> <ratio> [<ratio> ...] [options]";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "  Loads a mesh once and decimates a copy of it to each fraction of its faces, all in parallel, reporting the time";
+  DGP_CONSOLE << "  taken to load, copy and decimate.";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "  -threads <n>   Number of decimations to run at once, or 0 for one per hardware thread (default: 0)";
+  DGP_CONSOLE << "  -out <prefix>  Save the decimated meshes as <prefix><ratio>.off";
+  DGP_CONSOLE << "";
+
+  return -1;
+}
+
+// Load a mesh and decimate it, printing one row of results.
+bool
+measure(std::string const & path, double ratio, bool csv)
+{
+  double base_mb, peak_mb, load_mb, unused_mb;
+  getMemoryUsage(base_mb, unused_mb);
+
+  Stopwatch timer;
+  Mesh mesh;
+
+  timer.tick();
+  bool loaded = mesh.load(path);
+  timer.tock();
+  if (!loaded)
+    return false;
+
+  double load_time = timer.elapsedTime();
+  getMemoryUsage(load_mb, unused_mb);
+
+  long num_faces = mesh.numFaces();
+  long num_vertices = mesh.numVertices();
+  double decimate_time = 0;
+  long num_collapses = 0;
+  if (ratio > 0)
+  {
+    long before = mesh.numVertices();
+
+    timer.tick();
+    mesh.decimateQuadricEdgeCollapse((long)(ratio * num_faces));
+    timer.tock();
+
+    decimate_time = timer.elapsedTime();
+    num_collapses = before - mesh.numVertices();
+  }
+
+  getMemoryUsage(unused_mb, peak_mb);
+
+  double load_rate = (load_time > 0 ? num_faces / load_time : 0);
+  double collapse_rate = (decimate_time > 0 ? num_collapses / decimate_time : 0);
+  double mesh_mb = load_mb - base_mb;
+
+  if (csv)
+    std::printf("%ld,%ld,%.4f,%.0f,%.4f,%ld,%.0f,%.1f,%.1f\n", num_faces, num_vertices, load_time, load_rate, decimate_time,
+                num_collapses, collapse_rate, mesh_mb, peak_mb);
+  else
+    std::printf("%12ld %12ld %10.3f %12.0f %12.3f %12ld %12.0f %10.1f %10.1f\n", num_faces, num_vertices, load_time, load_rate,
+                decimate_time, num_collapses, collapse_rate, mesh_mb, peak_mb);
+
+  std::fflush(stdout);
+  return true;
+}
+
+// Run a benchmark, in a child process where possible so that its memory measurements are not polluted by earlier runs.
+template <typename BenchmarkT>
+bool
+runIsolated(BenchmarkT benchmark)
+{
+#ifdef DGP_WINDOWS
+  return benchmark();
+#else
+  bool ok = false;
+  pid_t pid = fork();
+  if (pid == 0)
+    std::_Exit(benchmark() ? 0 : 1);
+  else if (pid > 0)
+  {
+    int status = 0;
+    waitpid(pid, &status, 0);
+    ok = (WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+
+  return ok;
+#endif
+}
+
+// Generate a mesh, save it to a file and measure() it, then delete the file unless asked to keep it.
+bool
+measureGenerated(MeshGenerator::Shape shape, long num_faces, MeshGenerator::Options const & options, std::string const & path,
+                 double ratio, bool csv, bool keep)
+{
+  {
+    MeshGenerator gen;
+    if (!gen.generate(shape, num_faces, options) || !gen.saveOFF(path))
+      return false;
+  }
+
+  bool ok = runIsolated([&]() { return measure(path, ratio, csv); });
+
+  if (!keep)
+    std::remove(path.c_str());
+
+  if (!ok)
+    DGP_ERROR << "Benchmark failed on mesh " << path;
+
+  return ok;
+}
+
+int
+scaling(int argc, char * argv[])
+{
+  if (argc < 5)
+    return usage(argc, argv);
+
+  MeshGenerator::Shape shape;
+  if (!shape.fromString(argv[2]))
+  {
+    DGP_ERROR << "Unknown shape: " << argv[2];
+    return usage(argc, argv);
+  }
+
+  long min_faces = std::atol(argv[3]);
+  long max_faces = std::atol(argv[4]);
+
+  double factor = 2;
+  double ratio = 0.5;
+  std::string dir = ".";
+  bool keep = false, csv = false;
+  MeshGenerator::Options options;
+  for (int i = 5; i < argc; ++i)
+  {
+    if (std::strcmp(argv[i], "-keep") == 0)     { keep = true; continue; }
+    else if (std::strcmp(argv[i], "-csv") == 0) { csv = true; continue; }
+
+    if (i + 1 >= argc)
+      return usage(argc, argv);
+
+    if (std::strcmp(argv[i], "-factor") == 0)       factor = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "-ratio") == 0)   ratio = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "-dir") == 0)     dir = argv[++i];
+    else if (std::strcmp(argv[i], "-valence") == 0) options.valence = std::atol(argv[++i]);
+    else if (std::strcmp(argv[i], "-aspect") == 0)  options.aspect_ratio = (Real)std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "-pages") == 0)   options.num_pages = std::atol(argv[++i]);
+    else if (std::strcmp(argv[i], "-genus") == 0)   options.genus = std::atol(argv[++i]);
+    else if (std::strcmp(argv[i], "-noise") == 0)   options.noise = (Real)std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "-seed") == 0)    options.seed = (uint32)std::atol(argv[++i]);
+    else
+      return usage(argc, argv);
+  }
+
+  if (min_faces < 1 || max_faces < min_faces || factor <= 1)
+    return usage(argc, argv);
+
+  if (csv)
+    std::printf("faces,vertices,load_s,load_faces_per_s,decimate_s,collapses,collapses_per_s,mesh_mb,peak_mb\n");
+  else
+    std::printf("%12s %12s %10s %12s %12s %12s %12s %10s %10s\n", "faces", "vertices", "load(s)", "faces/s", "decimate(s)",
+                "collapses", "collapses/s", "mesh(MB)", "peak(MB)");
+
+  std::fflush(stdout);
+
+  for (double size = (double)min_faces; size <= (double)max_faces * 1.0001; size *= factor)
+  {
+    std::string path = FilePath::concat(dir, format("bench_%s_%ld.off", shape.toString().c_str(), (long)size));
+    if (!measureGenerated(shape, (long)size, options, path, ratio, csv, keep))
+      return -1;
+  }
+
+  return 0;
+}
+
+int
+fan(int argc, char * argv[])
+{
+  if (argc < 4)
+    return usage(argc, argv);
+
+  long min_valence = std::atol(argv[2]);
+  long max_valence = std::atol(argv[3]);
+
+  double factor = 2;
+  double ratio = 0.5;
+  long num_rings = 4;
+  std::string dir = ".";
+  bool keep = false, csv = false;
+  for (int i = 4; i < argc; ++i)
+  {
+    if (std::strcmp(argv[i], "-keep") == 0)     { keep = true; continue; }
+    else if (std::strcmp(argv[i], "-csv") == 0) { csv = true; continue; }
+
+    if (i + 1 >= argc)
+      return usage(argc, argv);
+
+    if (std::strcmp(argv[i], "-factor") == 0)      factor = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "-ratio") == 0)  ratio = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "-rings") == 0)  num_rings = std::atol(argv[++i]);
+    else if (std::strcmp(argv[i], "-dir") == 0)    dir = argv[++i];
+    else
+      return usage(argc, argv);
+  }
+
+  if (min_valence < 3 || max_valence < min_valence || factor <= 1 || num_rings < 1)
+    return usage(argc, argv);
+
+  if (csv)
+    std::printf("valence,faces,vertices,load_s,load_faces_per_s,decimate_s,collapses,collapses_per_s,mesh_mb,peak_mb\n");
+  else
+    std::printf("%10s %12s %12s %10s %12s %12s %12s %12s %10s %10s\n", "valence", "faces", "vertices", "load(s)", "faces/s",
+                "decimate(s)", "collapses", "collapses/s", "mesh(MB)", "peak(MB)");
+
+  for (double valence = (double)min_valence; valence <= (double)max_valence * 1.0001; valence *= factor)
+  {
+    MeshGenerator::Options options;
+    options.valence = (long)valence;
+
+    // The row is finished by measure(), possibly in a child process, so flush the first column before that
+    if (csv) std::printf("%ld,", options.valence);
+    else     std::printf("%10ld ", options.valence);
+    std::fflush(stdout);
+
+    std::string path = FilePath::concat(dir, format("bench_fan_valence_%ld.off", options.valence));
+    if (!measureGenerated(MeshGenerator::Shape::FAN, 2 * num_rings * options.valence, options, path, ratio, csv, keep))
+      return -1;
+  }
+
+  return 0;
+}
+
+int
+precision(int argc, char * argv[])
+{
+  double ratio = 0.25;
+  long num_samples = 100000;
+  bool csv = false;
+  std::vector<std::string> paths;
+  for (int i = 2; i < argc; ++i)
+  {
+    if (std::strcmp(argv[i], "-csv") == 0)                         csv = true;
+    else if (std::strcmp(argv[i], "-ratio") == 0 && i + 1 < argc)   ratio = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "-samples") == 0 && i + 1 < argc) num_samples = std::atol(argv[++i]);
+    else if (argv[i][0] == '-')
+      return usage(argc, argv);
+    else
+      paths.push_back(argv[i]);
+  }
+
+  if (paths.empty() || ratio <= 0 || ratio >= 1 || num_samples < 1)
+    return usage(argc, argv);
+
+  // Errors are relative to the diagonal of the bounding box of the input, so that meshes of different sizes are comparable
+  char const * prec = (sizeof(QuadricReal) == sizeof(float) ? "float" : "double");
+  if (csv)
+    std::printf("mesh,precision,faces,target,decimate_s,collapses_per_s,hausdorff,rms\n");
+  else
+    std::printf("%-20s %10s %10s %10s %12s %12s %12s %12s\n", "mesh", "precision", "faces", "target", "decimate(s)",
+                "collapses/s", "hausdorff", "rms");
+
+  for (size_t i = 0; i < paths.size(); ++i)
+  {
+    Mesh original, mesh;
+    if (!original.load(paths[i]))
+    {
+      DGP_ERROR << "Could not load mesh " << paths[i];
+      return -1;
+    }
+
+    original.copyTo(mesh);
+
+    long num_faces = mesh.numFaces();
+    long target = (long)(ratio * num_faces);
+    long before = mesh.numVertices();
+
+    Stopwatch timer;
+    timer.tick();
+    mesh.decimateQuadricEdgeCollapse(target);
+    timer.tock();
+
+    double decimate_time = timer.elapsedTime();
+    double collapse_rate = (decimate_time > 0 ? (before - mesh.numVertices()) / decimate_time : 0);
+
+    mesh.updateBounds();
+    MeshError::Result error = MeshError::compute(original, mesh, num_samples);
+    double diagonal = original.getAABB().getExtent().length();
+    double hausdorff = (diagonal > 0 ? error.hausdorff() / diagonal : 0);
+    double rms = (diagonal > 0 ? error.rms() / diagonal : 0);
+
+    std::string name = FilePath::completeBaseName(paths[i]);
+    if (csv)
+      std::printf("%s,%s,%ld,%ld,%.4f,%.0f,%.6g,%.6g\n", name.c_str(), prec, num_faces, target, decimate_time, collapse_rate,
+                  hausdorff, rms);
+    else
+      std::printf("%-20s %10s %10ld %10ld %12.3f %12.0f %12.6g %12.6g\n", name.c_str(), prec, num_faces, target,
+                  decimate_time, collapse_rate, hausdorff, rms);
+
+    std::fflush(stdout);
+  }
+
+  return 0;
+}
+
+// An extra column of results in a comparison of a decimation method with the priority queue.
+struct CompareColumn
+{
+  /** Where the values of the column come from. */
+  enum Source
+  {
+    DECIMATION,        ///< Returned by the method under test (zero for the priority queue)
+    MEMORY,            ///< Peak memory allocated by decimation, on top of the loaded mesh and its copy, in MB
+    RATE_PER_SETTING,  ///< Collapses per second divided by the setting, e.g. per thread (by one for the priority queue)
+  };
+
+  char const * csv_name;    ///< Header in comma-separated output
+  char const * table_name;  ///< Header in tabular output
+  int width;                ///< Width in tabular output
+  int precision;            ///< Number of decimal places
+  Source source;            ///< Where the values come from
+};
+
+// Decimate a mesh to a target number of faces with the method under test, for a setting given on the command line. Returns
+// the name of the method, and appends the values of its DECIMATION columns to extra.
+typedef std::function<std::string (Mesh & mesh, long target, long setting, std::vector<double> & extra)> DecimateFunction;
+
+// Load a mesh and decimate it with the priority queue (if setting is zero) or the method under test, printing one row of
+// results.
+bool
+measureComparison(std::string const & path, double ratio, long setting, long num_samples, bool csv,
+                  std::vector<CompareColumn> const & columns, DecimateFunction const & decimate)
+{
+  Mesh original, mesh;
+  if (!original.load(path))
+    return false;
+
+  original.copyTo(mesh);
+
+  double base_mb = resetPeakAllocated();
+
+  long num_faces = mesh.numFaces();
+  long target = (long)(ratio * num_faces);
+  long before = mesh.numVertices();
+
+  std::string method("heap");
+  std::vector<double> extra;
+  Stopwatch timer;
+  timer.tick();
+  if (setting > 0)
+    method = decimate(mesh, target, setting, extra);
+  else
+    mesh.decimateQuadricEdgeCollapse(target);
+  timer.tock();
+
+  double peak_mb = getPeakAllocated();
+
+  double decimate_time = timer.elapsedTime();
+  double collapse_rate = (decimate_time > 0 ? (before - mesh.numVertices()) / decimate_time : 0);
+
+  mesh.updateBounds();
+  MeshError::Result error = MeshError::compute(original, mesh, num_samples);
+  double diagonal = original.getAABB().getExtent().length();
+  double hausdorff = (diagonal > 0 ? error.hausdorff() / diagonal : 0);
+  double rms = (diagonal > 0 ? error.rms() / diagonal : 0);
+
+  std::string name = FilePath::completeBaseName(path);
+  if (csv)
+    std::printf("%s,%s,%ld,%ld,%.4f,%.0f", name.c_str(), method.c_str(), num_faces, target, decimate_time, collapse_rate);
+  else
+    std::printf("%-20s %14s %10ld %10ld %12.3f %12.0f", name.c_str(), method.c_str(), num_faces, target, decimate_time,
+                collapse_rate);
+
+  size_t next_extra = 0;
+  for (size_t i = 0; i < columns.size(); ++i)
+  {
+    double value = 0;
+    switch (columns[i].source)
+    {
+      case CompareColumn::DECIMATION:       if (next_extra < extra.size()) value = extra[next_extra++]; break;
+      case CompareColumn::MEMORY:           value = peak_mb - base_mb; break;
+      case CompareColumn::RATE_PER_SETTING: value = collapse_rate / std::max(setting, 1L); break;
+    }
+
+    if (csv)
+      std::printf(",%.*f", columns[i].precision, value);
+    else
+      std::printf(" %*.*f", columns[i].width, columns[i].precision, value);
+  }
+
+  if (csv)
+    std::printf(",%.6g,%.6g\n", hausdorff, rms);
+  else
+    std::printf(" %12.6g %12.6g\n", hausdorff, rms);
+
+  std::fflush(stdout);
+  return true;
+}
+
+// Compare a decimation method with the priority queue on each mesh given on the command line, for each value of a setting of
+// the method given with the option (e.g. "-threads"). Prints the time taken, the collapses per second, the extra columns and
+// the distance between the input and output, one row per run.
+int
+compareMethods(int argc, char * argv[], char const * option, long default_setting, std::vector<CompareColumn> const & columns,
+               DecimateFunction const & decimate)
+{
+  double ratio = 0.25;
+  long num_samples = 100000;
+  bool csv = false;
+  std::vector<long> settings;
+  std::vector<std::string> paths;
+  for (int i = 2; i < argc; ++i)
+  {
+    if (std::strcmp(argv[i], "-csv") == 0)                         csv = true;
+    else if (std::strcmp(argv[i], "-ratio") == 0 && i + 1 < argc)   ratio = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], option) == 0 && i + 1 < argc)     settings.push_back(std::atol(argv[++i]));
+    else if (std::strcmp(argv[i], "-samples") == 0 && i + 1 < argc) num_samples = std::atol(argv[++i]);
+    else if (argv[i][0] == '-')
+      return usage(argc, argv);
+    else
+      paths.push_back(argv[i]);
+  }
+
+  if (settings.empty())
+    settings.push_back(default_setting);
+
+  if (paths.empty() || ratio <= 0 || ratio >= 1 || num_samples < 1 || *std::min_element(settings.begin(), settings.end()) < 1)
+    return usage(argc, argv);
+
+  // The priority queue comes first in each group, as the reference
+  settings.insert(settings.begin(), 0);
+
+  if (csv)
+  {
+    std::printf("mesh,method,faces,target,decimate_s,collapses_per_s");
+    for (size_t i = 0; i < columns.size(); ++i)
+      std::printf(",%s", columns[i].csv_name);
+
+    std::printf(",hausdorff,rms\n");
+  }
+  else
+  {
+    std::printf("%-20s %14s %10s %10s %12s %12s", "mesh", "method", "faces", "target", "decimate(s)", "collapses/s");
+    for (size_t i = 0; i < columns.size(); ++i)
+      std::printf(" %*s", columns[i].width, columns[i].table_name);
+
+    std::printf(" %12s %12s\n", "hausdorff", "rms");
+  }
+
+  std::fflush(stdout);
+
+  for (size_t i = 0; i < paths.size(); ++i)
+    for (size_t j = 0; j < settings.size(); ++j)
+    {
+      if (!runIsolated([&]() { return measureComparison(paths[i], ratio, settings[j], num_samples, csv, columns, decimate); }))
+      {
+        DGP_ERROR << "Benchmark failed on mesh " << paths[i];
+        return -1;
+      }
+    }
+
+  return 0;
+}
+
+int
+choices(int argc, char * argv[])
+{
+  std::vector<CompareColumn> columns;
+  columns.push_back({ "decimate_mb", "memory(MB)", 10, 1, CompareColumn::MEMORY });
+
+  return compareMethods(argc, argv, "-choices", 8, columns,
+                        [](Mesh & mesh, long target, long num_choices, std::vector<double> & /* extra */) -> std::string {
+                          mesh.decimateMultipleChoice(target, (int)num_choices);
+                          return format("choices-%ld", num_choices);
+                        });
+}
+
+int
+concurrent(int argc, char * argv[])
+{
+  std::vector<CompareColumn> columns;
+  columns.push_back({ "collapses_per_thread_s", "per thread", 12, 0, CompareColumn::RATE_PER_SETTING });
+  columns.push_back({ "conflicts", "conflicts", 10, 0, CompareColumn::DECIMATION });
+
+  return compareMethods(argc, argv, "-threads", System::concurrency(), columns,
+                        [](Mesh & mesh, long target, long num_threads, std::vector<double> & extra) -> std::string {
+                          Mesh::ConcurrentStats stats = mesh.decimateConcurrent(target, num_threads);
+                          extra.push_back((double)stats.num_conflicts);
+                          return format("threads-%ld", num_threads);
+                        });
+}
+
+int
+partitions(int argc, char * argv[])
+{
+  std::vector<CompareColumn> columns;
+  columns.push_back({ "seam_collapses", "seam pass", 12, 0, CompareColumn::DECIMATION });
+
+  return compareMethods(argc, argv, "-partitions", System::concurrency(), columns,
+                        [](Mesh & mesh, long target, long num_partitions, std::vector<double> & extra) -> std::string {
+                          Mesh::PartitionedStats stats = mesh.decimatePartitioned(target, num_partitions);
+                          extra.push_back((double)stats.num_seam_collapses);
+                          return format("partitions-%ld", stats.num_partitions);
+                        });
+}
+
+int
+components(int argc, char * argv[])
+{
+  std::vector<CompareColumn> columns;
+  columns.push_back({ "components", "components", 12, 0, CompareColumn::DECIMATION });
+
+  return compareMethods(argc, argv, "-threads", System::concurrency(), columns,
+                        [](Mesh & mesh, long target, long num_threads, std::vector<double> & extra) -> std::string {
+                          Mesh::ComponentStats stats = mesh.decimateComponents(target, num_threads);
+                          extra.push_back((double)stats.num_components);
+                          return format("components-%ld", num_threads);
+                        });
+}
+
+int
+targets(int argc, char * argv[])
+{
+  long num_threads = 0;
+  std::string out_prefix;
+  std::vector<std::string> args;
+  for (int i = 2; i < argc; ++i)
+  {
+    if (std::strcmp(argv[i], "-threads") == 0 && i + 1 < argc)   num_threads = std::atol(argv[++i]);
+    else if (std::strcmp(argv[i], "-out") == 0 && i + 1 < argc)  out_prefix = argv[++i];
+    else if (argv[i][0] == '-' && std::isalpha(argv[i][1]))
+      return usage(argc, argv);
+    else
+      args.push_back(argv[i]);
+  }
+
+  if (args.size() < 2)
+    return usage(argc, argv);
+
+  std::vector<double> ratios;
+  for (size_t i = 1; i < args.size(); ++i)
+  {
+    ratios.push_back(std::atof(args[i].c_str()));
+    if (ratios.back() < 0 || ratios.back() > 1)
+      return usage(argc, argv);
+  }
+
+  Stopwatch timer;
+  timer.tick();
+  Mesh source;
+  if (!source.load(args[0]))
+  {
+    DGP_ERROR << "Could not load mesh " << args[0];
+    return -1;
+  }
+  timer.tock();
+  double load_time = timer.elapsedTime();
+
+  timer.tick();
+  Mesh::Snapshot snapshot;
+  source.takeSnapshot(snapshot, num_threads);
+  timer.tock();
+  double snapshot_time = timer.elapsedTime();
+
+  // Each decimation restores the snapshot for itself, so copies are made in parallel too and only live as long as needed
+  size_t n = ratios.size();
+  std::vector<double> copy_times(n), decimate_times(n);
+  std::vector<long> num_faces(n);
+  std::vector<uint8> saved(n, 1);
+
+  timer.tick();
+  Parallel::forEach(0, (long)n, [&](long i)
+  {
+    Stopwatch local_timer;
+    Mesh mesh;
+
+    local_timer.tick();
+    mesh.restoreSnapshot(snapshot, 1);
+    local_timer.tock();
+    copy_times[(size_t)i] = local_timer.elapsedTime();
+
+    local_timer.tick();
+    mesh.decimateQuadricEdgeCollapse((long)(ratios[(size_t)i] * source.numFaces()));
+    local_timer.tock();
+    decimate_times[(size_t)i] = local_timer.elapsedTime();
+    num_faces[(size_t)i] = mesh.numFaces();
+
+    if (!out_prefix.empty() && !mesh.save(out_prefix + args[(size_t)i + 1] + ".off"))
+      saved[(size_t)i] = 0;
+  }, Parallel::numThreads((long)n, num_threads));
+  timer.tock();
+
+  std::printf("Loaded %s (%ld faces) in %.3fs\n", FilePath::objectName(args[0]).c_str(), source.numFaces(), load_time);
+  std::printf("Took snapshot in %.3fs\n", snapshot_time);
+  std::printf("%10s %10s %10s %12s\n", "ratio", "faces", "copy(s)", "decimate(s)");
+  for (size_t i = 0; i < n; ++i)
+    std::printf("%10g %10ld %10.3f %12.3f\n", ratios[i], num_faces[i], copy_times[i], decimate_times[i]);
+
+  std::printf("Copied and decimated %ld targets in %.3fs\n", (long)n, timer.elapsedTime());
+
+  return std::count(saved.begin(), saved.end(), 0) == 0 ? 0 : -1;
+}
+
+int
+main(int argc, char * argv[])
+{
+  if (argc < 2)
+    return usage(argc, argv);
+
+  std::string mode = argv[1];
+  if (mode == "scaling")
+    return scaling(argc, argv);
+  else if (mode == "fan")
+    return fan(argc, argv);
+  else if (mode == "precision")
+    return precision(argc, argv);
+  else if (mode == "choices")
+    return choices(argc, argv);
+  else if (mode == "concurrent")
+    return concurrent(argc, argv);
+  else if (mode == "partitions")
+    return partitions(argc, argv);
+  else if (mode == "components")
+    return components(argc, argv);
+  else if (mode == "targets")
+    return targets(argc, argv);
+
+  return usage(argc, argv);
+}
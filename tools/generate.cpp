@@ -0,0 +1,75 @@
+#include "MeshGenerator.hpp"
+#include "DGP/Stopwatch.hpp"
+#include <cstdlib>
+#include <cstring>
+
+int
+usage(int argc, char * argv[])
+{
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "Usage: " << argv[0] << " <shape> <target-num-faces> <mesh-out> [options]";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "Shapes: sphere, torus, terrain, fan, slivers, nonmanifold, genus";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "Options:";
+  DGP_CONSOLE << "  -valence <k>   Valence of the poles of 'fan' (default: a single double cone)";
+  DGP_CONSOLE << "  -aspect <a>    Aspect ratio of the triangles of 'slivers' (default: 100)";
+  DGP_CONSOLE << "  -pages <p>     Number of pages meeting at the spine of 'nonmanifold' (default: 4)";
+  DGP_CONSOLE << "  -genus <g>     Number of holes of 'genus' (default: 3)";
+  DGP_CONSOLE << "  -noise <n>     Relative displacement amplitude of 'terrain' (default: 0.05)";
+  DGP_CONSOLE << "  -seed <s>      Random seed of 'terrain' (default: 0)";
+  DGP_CONSOLE << "";
+
+  return -1;
+}
+
+int
+main(int argc, char * argv[])
+{
+  if (argc < 4)
+    return usage(argc, argv);
+
+  MeshGenerator::Shape shape;
+  if (!shape.fromString(argv[1]))
+  {
+    DGP_ERROR << "Unknown shape: " << argv[1];
+    return usage(argc, argv);
+  }
+
+  long target_num_faces = std::atol(argv[2]);
+  std::string out_path = argv[3];
+
+  MeshGenerator::Options options;
+  for (int i = 4; i < argc; ++i)
+  {
+    if (i + 1 >= argc)
+      return usage(argc, argv);
+
+    if (std::strcmp(argv[i], "-valence") == 0)     options.valence = std::atol(argv[++i]);
+    else if (std::strcmp(argv[i], "-aspect") == 0) options.aspect_ratio = (Real)std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "-pages") == 0)  options.num_pages = std::atol(argv[++i]);
+    else if (std::strcmp(argv[i], "-genus") == 0)  options.genus = std::atol(argv[++i]);
+    else if (std::strcmp(argv[i], "-noise") == 0)  options.noise = (Real)std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "-seed") == 0)   options.seed = (uint32)std::atol(argv[++i]);
+    else
+      return usage(argc, argv);
+  }
+
+  Stopwatch timer;
+  timer.tick();
+
+  MeshGenerator gen;
+  if (!gen.generate(shape, target_num_faces, options))
+    return -1;
+
+  timer.tock();
+  DGP_CONSOLE << "Generated " << shape.toString() << " with " << gen.numVertices() << " vertices and " << gen.numFaces()
+              << " faces in " << timer.elapsedTime() << "s";
+
+  if (!gen.saveOFF(out_path))
+    return -1;
+
+  DGP_CONSOLE << "Saved mesh to " << out_path;
+
+  return 0;
+}
@@ -0,0 +1,288 @@
+#include "DecimationWorker.hpp"
+#include "Mesh.hpp"
+#include "MeshGenerator.hpp"
+#include "ProgressiveMesh.hpp"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Add a sphere of about 2000 faces to a mesh, returning its vertices.
+bool
+addSphere(Mesh & mesh, std::vector<Mesh::Vertex *> & vertices)
+{
+  MeshGenerator generator;
+  if (!generator.generate(MeshGenerator::Shape::SPHERE, 2000))
+    return false;
+
+  vertices.clear();
+  for (long i = 0; i < generator.numVertices(); ++i)
+    vertices.push_back(mesh.addVertex(generator.getVertex(i)));
+
+  for (long i = 0; i < generator.numFaces(); ++i)
+  {
+    Mesh::Vertex * face[3] = { vertices[generator.getFaceVertex(i, 0)], vertices[generator.getFaceVertex(i, 1)],
+                               vertices[generator.getFaceVertex(i, 2)] };
+    if (!mesh.addFace(face, face + 3))
+      return false;
+  }
+
+  return true;
+}
+
+// Build a mesh of several connected components: a sphere, and a small tetrahedron away from it. The tetrahedron's edges are
+// the cheapest to collapse, so the first collapses remove it entirely, after which decimation must go on with the sphere.
+bool
+buildComponents(Mesh & mesh)
+{
+  std::vector<Mesh::Vertex *> vertices;
+  if (!addSphere(mesh, vertices))
+    return false;
+
+  Real const s = 0.01f;
+  Mesh::Vertex * tet[4] = { mesh.addVertex(Vector3(5, 5, 5)), mesh.addVertex(Vector3(5 + s, 5, 5)),
+                            mesh.addVertex(Vector3(5, 5 + s, 5)), mesh.addVertex(Vector3(5, 5, 5 + s)) };
+  int const tet_faces[4][3] = { { 0, 2, 1 }, { 0, 1, 3 }, { 0, 3, 2 }, { 1, 2, 3 } };
+  for (int i = 0; i < 4; ++i)
+  {
+    Mesh::Vertex * face[3] = { tet[tet_faces[i][0]], tet[tet_faces[i][1]], tet[tet_faces[i][2]] };
+    if (!mesh.addFace(face, face + 3))
+      return false;
+  }
+
+  mesh.updateQuadrics();
+  return true;
+}
+
+// Build a sphere with an extra degenerate face that repeats a vertex, as some files have. Its edges cannot be collapsed, so
+// decimation skips them.
+bool
+buildDegenerate(Mesh & mesh)
+{
+  std::vector<Mesh::Vertex *> vertices;
+  if (!addSphere(mesh, vertices))
+    return false;
+
+  Mesh::Vertex * face[4] = { vertices[0], vertices[1], vertices[1], vertices[2] };
+  if (!mesh.addFace(face, face + 4))
+    return false;
+
+  mesh.updateQuadrics();
+  return true;
+}
+
+// Report whether a decimation reached its target. A collapse removes at most a few faces, so it may stop just below it.
+bool
+check(char const * name, long num_faces, long target)
+{
+  static long const MAX_FACES_PER_COLLAPSE = 4;
+
+  bool ok = (num_faces <= target && num_faces > target - MAX_FACES_PER_COLLAPSE);
+  std::printf("%-40s %s (%ld faces, target %ld)\n", name, ok ? "ok" : "FAILED", num_faces, target);
+  std::fflush(stdout);
+
+  return ok;
+}
+
+int
+main()
+{
+  Mesh original;
+  if (!buildComponents(original))
+  {
+    DGP_ERROR << "Could not build the test mesh";
+    return -1;
+  }
+
+  long target = original.numFaces() / 4;
+  int num_failed = 0;
+
+  {
+    Mesh mesh;
+    original.copyTo(mesh);
+    mesh.decimateQuadricEdgeCollapse(target);
+    num_failed += !check("multi-component priority queue", mesh.numFaces(), target);
+  }
+
+  {
+    Mesh mesh;
+    original.copyTo(mesh);
+    mesh.decimateMultipleChoice(target, 8, 1);
+    num_failed += !check("multi-component multiple choice", mesh.numFaces(), target);
+  }
+
+  {
+    Mesh mesh;
+    original.copyTo(mesh);
+    mesh.decimatePartitioned(target, 2);
+    num_failed += !check("multi-component partitions", mesh.numFaces(), target);
+  }
+
+  // Reinitialize the quadrics halfway, which must skip the edges removed so far
+  {
+    Mesh mesh;
+    original.copyTo(mesh);
+    mesh.decimateQuadricEdgeCollapse(2 * target);
+    mesh.updateQuadrics();
+    mesh.decimateQuadricEdgeCollapse(target);
+    num_failed += !check("decimate again, new quadrics", mesh.numFaces(), target);
+  }
+
+  // Meshes this small are decimated as a single region, whatever the number of partitions asked for
+  for (long num_partitions = 1; num_partitions <= 2; ++num_partitions)
+  {
+    Mesh mesh;
+    original.copyTo(mesh);
+    mesh.decimateQuadricEdgeCollapse(2 * target);
+    mesh.decimatePartitioned(target, num_partitions);
+
+    std::string name = "decimate again, " + std::to_string(num_partitions) + " partition(s)";
+    num_failed += !check(name.c_str(), mesh.numFaces(), target);
+  }
+
+  {
+    Mesh mesh;
+    original.copyTo(mesh);
+    mesh.decimateConcurrent(target, 2);
+    num_failed += !check("multi-component concurrent", mesh.numFaces(), target);
+  }
+
+  {
+    Mesh mesh;
+    original.copyTo(mesh);
+    mesh.decimateQuadricEdgeCollapse(2 * target);
+    mesh.decimateConcurrent(target, 2);
+    num_failed += !check("decimate again, concurrent", mesh.numFaces(), target);
+  }
+
+  {
+    Mesh mesh;
+    original.copyTo(mesh);
+    mesh.decimateComponents(target, 2);
+    num_failed += !check("multi-component components", mesh.numFaces(), target);
+  }
+
+  {
+    Mesh mesh;
+    original.copyTo(mesh);
+    mesh.decimateQuadricEdgeCollapse(2 * target);
+    mesh.decimateComponents(target, 2);
+    num_failed += !check("decimate again, components", mesh.numFaces(), target);
+  }
+
+  {
+    Mesh mesh;
+    original.copyTo(mesh);
+    DecimationWorker worker;
+    worker.start(&mesh, target, 0);
+    worker.wait();
+    num_failed += !check("multi-component background worker", mesh.numFaces(), target);
+  }
+
+  {
+    Mesh mesh;
+    original.copyTo(mesh);
+    ProgressiveMesh pm;
+    pm.build(mesh, target);
+    num_failed += !check("multi-component progressive mesh", pm.numFacesAtLevel(pm.numLevels() - 1), target);
+  }
+
+  Mesh degenerate;
+  if (!buildDegenerate(degenerate))
+  {
+    DGP_ERROR << "Could not build the test mesh";
+    return -1;
+  }
+
+  long degenerate_target = degenerate.numFaces() / 4;
+
+  // Edges of the degenerate face leave the pool of candidates without leaving the mesh, so they must survive the final cleanup
+  for (uint32 seed = 1; seed <= 8; ++seed)
+  {
+    Mesh mesh;
+    degenerate.copyTo(mesh);
+    mesh.decimateMultipleChoice(degenerate_target, 8, seed);
+    mesh.decimateQuadricEdgeCollapse(degenerate_target / 2);
+
+    std::string name = "degenerate face, multiple choice, seed " + std::to_string(seed);
+    num_failed += !check(name.c_str(), mesh.numFaces(), degenerate_target / 2);
+  }
+
+  // Collapses of the degenerate face are skipped by the workers, and the edges they leave behind must be decimated afterwards
+  {
+    Mesh mesh;
+    degenerate.copyTo(mesh);
+    mesh.decimateConcurrent(degenerate_target, 2);
+    mesh.decimateQuadricEdgeCollapse(degenerate_target / 2);
+    num_failed += !check("degenerate face, concurrent", mesh.numFaces(), degenerate_target / 2);
+  }
+
+  for (long num_partitions = 1; num_partitions <= 2; ++num_partitions)
+  {
+    Mesh mesh;
+    degenerate.copyTo(mesh);
+    mesh.decimatePartitioned(degenerate_target, num_partitions);
+    mesh.decimateQuadricEdgeCollapse(degenerate_target / 2);
+
+    std::string name = "degenerate face, " + std::to_string(num_partitions) + " partition(s)";
+    num_failed += !check(name.c_str(), mesh.numFaces(), degenerate_target / 2);
+  }
+
+  {
+    Mesh mesh;
+    degenerate.copyTo(mesh);
+    mesh.decimateComponents(degenerate_target, 2);
+    mesh.decimateQuadricEdgeCollapse(degenerate_target / 2);
+    num_failed += !check("degenerate face, components", mesh.numFaces(), degenerate_target / 2);
+  }
+
+  // Share one budget between both test meshes, then decimate each of them again on its own
+  {
+    Mesh first, second;
+    original.copyTo(first);
+    degenerate.copyTo(second);
+
+    std::vector<Mesh *> scene;
+    scene.push_back(&first);
+    scene.push_back(&second);
+
+    long scene_target = (first.numFaces() + second.numFaces()) / 4;
+    Mesh::decimateScene(scene, scene_target, 2);
+    num_failed += !check("scene", first.numFaces() + second.numFaces(), scene_target);
+
+    long first_target = first.numFaces() / 2, second_target = second.numFaces() / 2;
+    first.decimateQuadricEdgeCollapse(first_target);
+    second.decimateQuadricEdgeCollapse(second_target);
+    num_failed += !check("decimate again, scene, first mesh", first.numFaces(), first_target);
+    num_failed += !check("decimate again, scene, second mesh", second.numFaces(), second_target);
+  }
+
+  // Save a checkpoint after an edge has been skipped, resume from it and check that both runs end the same
+  {
+    Mesh mesh;
+    degenerate.copyTo(mesh);
+
+    Mesh::CollapseStatus status = Mesh::EDGE_COLLAPSED;
+    long num_skipped = 0;
+    while (num_skipped == 0 && status != Mesh::NO_EDGES_LEFT && mesh.numFaces() > degenerate_target)
+    {
+      mesh.decimateQuadricEdgeCollapse(NULL, &status);
+      num_skipped += (status == Mesh::EDGE_SKIPPED);
+    }
+
+    std::string const checkpoint_path = "verify_checkpoint.tmp";
+    Mesh resumed;
+    bool resumed_ok = (num_skipped > 0 && mesh.saveCheckpoint(checkpoint_path) && resumed.loadCheckpoint(checkpoint_path));
+    std::remove(checkpoint_path.c_str());
+
+    mesh.decimateQuadricEdgeCollapse(degenerate_target);
+    if (resumed_ok)
+    {
+      resumed.decimateQuadricEdgeCollapse(degenerate_target);
+      resumed_ok = (resumed.numFaces() == mesh.numFaces());
+    }
+
+    num_failed += !check("checkpoint after a skipped edge", resumed_ok ? resumed.numFaces() : -1, degenerate_target);
+  }
+
+  return (num_failed > 0 ? -1 : 0);
+}